@@ -0,0 +1,472 @@
+/**
+ * @file judge_bench.cpp
+ * @brief 评测核心端到端开环压测工具
+ *
+ * 按泊松到达以固定速率向评测核心提交任务(不等待前一个任务完成)，任务按配置的
+ * 比例从四类负载中抽取：
+ *          - tiny：读入两个数输出和
+ *          - cpu：约2亿次整数运算
+ *          - mem：申请并写入128MB
+ *          - out：输出8MB
+ *
+ * 评测核心以report_phases=1运行，并为每类负载提供标准答案，结果中的
+ * load/compile/run/check各阶段耗时与端到端延迟一起统计分位数和直方图，
+ * 写入结果文件供回归对比
+ *
+ * 编译：g++ -std=c++20 -O2 -Wall -Wextra -pthread judge_bench.cpp -o judge_bench
+ * 用法：sudo ./judge_bench [--judge PATH] [--rate R] [--duration S] [--mix tiny:4,cpu:2,mem:1,out:1]
+ *                          [--compile-cache] [--seed N] [--max-inflight N] [--out FILE] [--baseline FILE]
+ */
+
+#include <iostream>       // 标准输入输出流
+#include <fstream>        // 文件流操作
+#include <sstream>        // 读取基线文件
+#include <string>         // 字符串处理
+#include <string_view>    // 字符串视图
+#include <vector>         // 动态数组容器
+#include <chrono>         // 高精度时间测量
+#include <thread>         // 任务线程
+#include <atomic>         // 原子计数
+#include <algorithm>      // 排序
+#include <random>         // 到达间隔和负载抽样
+#include <map>            // 判定统计
+#include <cmath>          // 直方图分桶
+#include <unistd.h>       // POSIX系统调用
+#include <sys/wait.h>     // 进程等待相关
+#include <sys/stat.h>     // 文件状态
+#include <fcntl.h>        // 文件控制
+
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * @struct Workload
+ * @brief 一类负载
+ */
+struct Workload
+{
+    string name;   ///< 负载名
+    string source; ///< 程序源码
+    double weight; ///< 抽样权重
+    string answer; ///< 标准答案(对输入"1 2")
+};
+
+/**
+ * @struct JobSample
+ * @brief 一个任务的测量结果
+ */
+struct JobSample
+{
+    size_t workload = 0;       ///< 负载下标
+    bool completed = false;    ///< 是否已完成
+    long long latency_us = 0;  ///< 从计划到达到完成的延迟(微秒)
+    long long load_us = -1;    ///< 各阶段耗时(微秒)，来自评测结果
+    long long compile_us = -1;
+    long long run_us = -1;
+    long long check_us = -1;
+    string status;             ///< 判定
+};
+
+/**
+ * @brief 从JSON文本中读取数值字段(取第一次出现)
+ * @return long long 字段值，不存在时返回-1
+ */
+long long jsonNumber(string_view text, string_view key)
+{
+    string pattern = "\"" + string(key) + "\": ";
+    size_t pos = text.find(pattern);
+    if (pos == string_view::npos)
+        return -1;
+    return atoll(string(text.substr(pos + pattern.size(), 24)).c_str());
+}
+
+/**
+ * @brief 从JSON文本中读取字符串字段(取第一次出现)
+ */
+string jsonString(string_view text, string_view key)
+{
+    string pattern = "\"" + string(key) + "\": \"";
+    size_t pos = text.find(pattern);
+    if (pos == string_view::npos)
+        return "";
+    size_t begin = pos + pattern.size();
+    size_t end = text.find('"', begin);
+    return string(text.substr(begin, end == string_view::npos ? string_view::npos : end - begin));
+}
+
+/**
+ * @brief 四类内置负载及其标准答案
+ *
+ * 每个任务都带标准答案，评测核心的check阶段(记号比较)在压测中同样被计时
+ */
+vector<Workload> builtinWorkloads()
+{
+    // cpu负载的结果与程序中的线性同余迭代相同
+    unsigned long long x = 1;
+    for (long i = 0; i < 200000000; i++)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return {
+        {"tiny", "#include <cstdio>\nint main(){long long a,b;if(scanf(\"%lld %lld\",&a,&b)!=2)return 1;printf(\"%lld\\n\",a+b);}\n", 0, "3\n"},
+        {"cpu", "#include <cstdio>\nint main(){unsigned long long x=1;for(long i=0;i<200000000;i++)x=x*6364136223846793005ULL+1442695040888963407ULL;printf(\"%llu\\n\",x);}\n", 0,
+         to_string(x) + "\n"},
+        {"mem", "#include <cstdio>\n#include <cstdlib>\nint main(){const long n=128L<<20;char*p=(char*)malloc(n);for(long i=0;i<n;i+=4096)p[i]=(char)i;printf(\"%d\\n\",p[n-4096]);}\n", 0, "0\n"},
+        {"out", "#include <cstdio>\n#include <cstring>\nint main(){static char b[65536];memset(b,'x',sizeof b);for(int i=0;i<128;i++)fwrite(b,1,sizeof b,stdout);}\n", 0,
+         string(128 * 65536, 'x')},
+    };
+}
+
+/**
+ * @brief 解析负载比例，如"tiny:4,cpu:2,mem:1,out:1"
+ * @return bool 格式正确且至少一个权重为正时返回true
+ */
+bool parseMix(const string &mix, vector<Workload> &workloads)
+{
+    stringstream stream(mix);
+    string item;
+    double total = 0;
+    while (getline(stream, item, ','))
+    {
+        size_t colon = item.find(':');
+        string name = item.substr(0, colon);
+        double weight = colon == string::npos ? 1 : atof(item.c_str() + colon + 1);
+        auto it = find_if(workloads.begin(), workloads.end(), [&](const Workload &w)
+                          { return w.name == name; });
+        if (it == workloads.end() || weight < 0)
+            return false;
+        it->weight = weight;
+        total += weight;
+    }
+    return total > 0;
+}
+
+/**
+ * @brief 写入文件
+ */
+bool writeFile(const string &path, const string &content)
+{
+    ofstream file(path, ios::binary | ios::trunc);
+    file << content;
+    return static_cast<bool>(file);
+}
+
+/**
+ * @brief 运行一次评测核心并返回其标准输出
+ */
+string runJudge(const string &judge, const string &limits_file, const string &source_file, const string &input_file,
+                const string &answer_file)
+{
+    int output_pipe[2];
+    if (pipe2(output_pipe, O_CLOEXEC) == -1)
+        return "";
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        return "";
+    }
+    if (pid == 0)
+    {
+        dup2(output_pipe[1], STDOUT_FILENO);
+        execl(judge.c_str(), judge.c_str(), limits_file.c_str(), source_file.c_str(), input_file.c_str(),
+              answer_file.c_str(), (char *)nullptr);
+        _exit(127);
+    }
+
+    close(output_pipe[1]);
+    // 只需要结果头部的状态和阶段耗时，stdout字段很长时丢弃多余部分
+    string output;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(output_pipe[0], buffer, sizeof(buffer))) > 0)
+    {
+        output.append(buffer, static_cast<size_t>(n));
+        if (output.size() > (1 << 20))
+            output.erase(512, output.size() - 4096);
+    }
+    close(output_pipe[0]);
+    waitpid(pid, nullptr, 0);
+    return output;
+}
+
+/**
+ * @brief 取已排序数组的分位数
+ */
+long long percentile(const vector<long long> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[min(index, sorted.size() - 1)];
+}
+
+/**
+ * @brief 把一组微秒样本格式化为分位数JSON对象(单位毫秒，保留3位小数)
+ */
+string percentileJson(vector<long long> samples)
+{
+    sort(samples.begin(), samples.end());
+    auto ms = [](long long us)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.3f", static_cast<double>(us) / 1000.0);
+        return string(text);
+    };
+    return "{\"count\": " + to_string(samples.size()) +
+           ", \"p50\": " + ms(percentile(samples, 0.50)) +
+           ", \"p90\": " + ms(percentile(samples, 0.90)) +
+           ", \"p99\": " + ms(percentile(samples, 0.99)) +
+           ", \"max\": " + ms(samples.empty() ? 0 : samples.back()) + "}";
+}
+
+/**
+ * @brief 端到端延迟直方图：按2的幂分桶(毫秒)
+ */
+string histogramJson(const vector<long long> &latencies_us)
+{
+    map<long long, long long> buckets;
+    for (long long us : latencies_us)
+    {
+        long long upper = 1;
+        while (upper * 1000 < us)
+            upper *= 2;
+        buckets[upper]++;
+    }
+    string out = "[";
+    bool first = true;
+    for (const auto &[upper, count] : buckets)
+    {
+        out += (first ? "" : ", ") + string("{\"le_ms\": ") + to_string(upper) + ", \"count\": " + to_string(count) + "}";
+        first = false;
+    }
+    return out + "]";
+}
+
+/**
+ * @brief 与基线结果对比关键指标
+ */
+void compareWithBaseline(const string &baseline_file, const string &report)
+{
+    ifstream file(baseline_file);
+    stringstream buffer;
+    buffer << file.rdbuf();
+    string baseline = buffer.str();
+    if (baseline.empty())
+    {
+        cerr << "Failed to read baseline " << baseline_file << endl;
+        return;
+    }
+
+    for (const char *key : {"e2e_p50_us", "e2e_p99_us", "run_p50_us", "throughput_milli"})
+    {
+        long long before = jsonNumber(baseline, key);
+        long long after = jsonNumber(report, key);
+        double change = before > 0 ? (static_cast<double>(after) - static_cast<double>(before)) * 100.0 / static_cast<double>(before) : 0;
+        fprintf(stderr, "%-18s baseline %10lld  current %10lld  %+7.1f%%\n", key, before, after, change);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    string judge = "./judge_core_cgroup";
+    double rate = 2.0;
+    double duration = 10.0;
+    string mix = "tiny:4,cpu:2,mem:1,out:1";
+    bool compile_cache = false;
+    unsigned long long seed = 1;
+    long long max_inflight = 64;
+    string out_file = "bench_results.json";
+    string baseline_file;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string_view option = argv[i];
+        bool has_value = i + 1 < argc;
+        if (option == "--compile-cache")
+            compile_cache = true;
+        else if (option == "--judge" && has_value)
+            judge = argv[++i];
+        else if (option == "--rate" && has_value)
+            rate = atof(argv[++i]);
+        else if (option == "--duration" && has_value)
+            duration = atof(argv[++i]);
+        else if (option == "--mix" && has_value)
+            mix = argv[++i];
+        else if (option == "--seed" && has_value)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if (option == "--max-inflight" && has_value)
+            max_inflight = atoll(argv[++i]);
+        else if (option == "--out" && has_value)
+            out_file = argv[++i];
+        else if (option == "--baseline" && has_value)
+            baseline_file = argv[++i];
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--judge PATH] [--rate R] [--duration S] [--mix tiny:4,cpu:2,mem:1,out:1]" << endl;
+            cerr << "       [--compile-cache] [--seed N] [--max-inflight N] [--out FILE] [--baseline FILE]" << endl;
+            return 1;
+        }
+    }
+
+    vector<Workload> workloads = builtinWorkloads();
+    if (rate <= 0 || duration <= 0 || !parseMix(mix, workloads))
+    {
+        cerr << "Invalid --rate, --duration or --mix" << endl;
+        return 1;
+    }
+
+    // 工作目录：限制配置、输入和每个任务各自的源码副本
+    char workdir_template[] = "/tmp/judge_bench_XXXXXX";
+    if (mkdtemp(workdir_template) == nullptr)
+    {
+        cerr << "Failed to create work directory" << endl;
+        return 1;
+    }
+    string workdir = workdir_template;
+    string limits_file = workdir + "/limits.json";
+    string input_file = workdir + "/input.txt";
+    // memory_limit和stack_limit以KB为单位：256MB、8MB
+    string limits = string("{\n  \"time_limit\": 2000,\n  \"memory_limit\": 262144,\n  \"output_limit\": 16777216,\n") +
+                    "  \"compile_timeout\": 30000,\n  \"stack_limit\": 8192,\n  \"report_phases\": 1,\n" +
+                    "  \"compile_cache\": " + (compile_cache ? "1" : "0") + "\n}\n";
+    bool written = writeFile(limits_file, limits) && writeFile(input_file, "1 2\n");
+    for (const Workload &workload : workloads)
+        written = written && writeFile(workdir + "/" + workload.name + ".ans", workload.answer);
+    if (!written)
+    {
+        cerr << "Failed to write benchmark files" << endl;
+        return 1;
+    }
+
+    // 预先抽样全部到达时刻和负载类型，同一种子得到相同的任务序列
+    mt19937_64 generator(seed);
+    exponential_distribution<double> interarrival(rate);
+    vector<double> weights;
+    for (const Workload &workload : workloads)
+        weights.push_back(workload.weight);
+    discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+    vector<double> arrivals;
+    vector<JobSample> samples;
+    for (double t = interarrival(generator); t < duration; t += interarrival(generator))
+    {
+        arrivals.push_back(t);
+        JobSample sample;
+        sample.workload = pick(generator);
+        samples.push_back(sample);
+    }
+
+    vector<thread> threads;
+    atomic<long long> inflight{0};
+    long long dropped = 0;
+    auto bench_start = steady_clock::now();
+    for (size_t i = 0; i < arrivals.size(); i++)
+    {
+        auto scheduled = bench_start + microseconds(static_cast<long long>(arrivals[i] * 1e6));
+        this_thread::sleep_until(scheduled);
+        if (inflight >= max_inflight)
+        {
+            dropped++;
+            continue;
+        }
+
+        string source_file = workdir + "/job" + to_string(i) + ".cpp";
+        if (!writeFile(source_file, workloads[samples[i].workload].source))
+        {
+            dropped++;
+            continue;
+        }
+
+        inflight++;
+        string answer_file = workdir + "/" + workloads[samples[i].workload].name + ".ans";
+        threads.emplace_back([&, i, scheduled, source_file, answer_file]()
+                             {
+            string output = runJudge(judge, limits_file, source_file, input_file, answer_file);
+            JobSample &sample = samples[i];
+            sample.latency_us = duration_cast<microseconds>(steady_clock::now() - scheduled).count();
+            sample.status = jsonString(output, "status");
+            if (sample.status.empty())
+                sample.status = "SE";
+            sample.load_us = jsonNumber(output, "load_us");
+            sample.compile_us = jsonNumber(output, "compile_us");
+            sample.run_us = jsonNumber(output, "run_us");
+            sample.check_us = jsonNumber(output, "check_us");
+            sample.completed = true;
+            unlink(source_file.c_str());
+            inflight--; });
+    }
+    for (thread &t : threads)
+        t.join();
+    long long elapsed_us = duration_cast<microseconds>(steady_clock::now() - bench_start).count();
+
+    // 汇总端到端、分阶段和分负载的延迟
+    vector<long long> latencies, load, compile, run, check;
+    vector<vector<long long>> by_workload(workloads.size());
+    map<string, long long> verdicts;
+    long long completed = 0;
+    for (const JobSample &sample : samples)
+    {
+        if (!sample.completed)
+            continue;
+        completed++;
+        latencies.push_back(sample.latency_us);
+        by_workload[sample.workload].push_back(sample.latency_us);
+        verdicts[string(workloads[sample.workload].name) + ":" + sample.status]++;
+        if (sample.load_us >= 0)
+            load.push_back(sample.load_us);
+        if (sample.compile_us >= 0)
+            compile.push_back(sample.compile_us);
+        if (sample.run_us >= 0)
+            run.push_back(sample.run_us);
+        if (sample.check_us >= 0)
+            check.push_back(sample.check_us);
+    }
+    vector<long long> sorted_latencies = latencies, sorted_run = run;
+    sort(sorted_latencies.begin(), sorted_latencies.end());
+    sort(sorted_run.begin(), sorted_run.end());
+    long long throughput_milli = elapsed_us > 0 ? completed * 1000000000LL / elapsed_us : 0;
+
+    string report = "{\n";
+    report += "  \"config\": {\"rate\": " + to_string(rate) + ", \"duration\": " + to_string(duration) +
+              ", \"mix\": \"" + mix + "\", \"compile_cache\": " + (compile_cache ? "true" : "false") +
+              ", \"seed\": " + to_string(seed) + ", \"cpus\": " + to_string(thread::hardware_concurrency()) + "},\n";
+    report += "  \"issued\": " + to_string(samples.size()) + ",\n";
+    report += "  \"completed\": " + to_string(completed) + ",\n";
+    report += "  \"dropped\": " + to_string(dropped) + ",\n";
+    report += "  \"elapsed_us\": " + to_string(elapsed_us) + ",\n";
+    report += "  \"throughput_milli\": " + to_string(throughput_milli) + ",\n";
+    report += "  \"e2e_p50_us\": " + to_string(percentile(sorted_latencies, 0.50)) + ",\n";
+    report += "  \"e2e_p99_us\": " + to_string(percentile(sorted_latencies, 0.99)) + ",\n";
+    report += "  \"run_p50_us\": " + to_string(percentile(sorted_run, 0.50)) + ",\n";
+    report += "  \"end_to_end\": " + percentileJson(latencies) + ",\n";
+    report += "  \"phases\": {\"load\": " + percentileJson(load) + ",\n             \"compile\": " + percentileJson(compile) +
+              ",\n             \"run\": " + percentileJson(run) + ",\n             \"check\": " + percentileJson(check) + "},\n";
+    report += "  \"by_workload\": {";
+    for (size_t i = 0; i < workloads.size(); i++)
+        report += (i == 0 ? "\n    \"" : ",\n    \"") + workloads[i].name + "\": " + percentileJson(by_workload[i]);
+    report += "\n  },\n";
+    report += "  \"histogram\": " + histogramJson(latencies) + ",\n";
+    report += "  \"verdicts\": {";
+    bool first = true;
+    for (const auto &[verdict, count] : verdicts)
+    {
+        report += (first ? "\"" : ", \"") + verdict + "\": " + to_string(count);
+        first = false;
+    }
+    report += "}\n}\n";
+
+    cout << report;
+    if (!writeFile(out_file, report))
+        cerr << "Failed to write " << out_file << endl;
+    if (!baseline_file.empty())
+        compareWithBaseline(baseline_file, report);
+
+    unlink(limits_file.c_str());
+    unlink(input_file.c_str());
+    for (const Workload &workload : workloads)
+        unlink((workdir + "/" + workload.name + ".ans").c_str());
+    rmdir(workdir.c_str());
+    return 0;
+}
@@ -3,8 +3,8 @@
 # OJ评测核心一键启动脚本 (使用cgroup v2)
 
 # 检查参数
-if [ $# -ne 3 ]; then
-    echo "用法: $0 <limits_file> <source_file> <input_file>"
+if [ $# -lt 3 ] || [ $# -gt 5 ]; then
+    echo "用法: $0 <limits_file> <source_file> <input_file> [answer_file [checker]]"
     echo "示例: $0 limits.json test.cpp test.in"
     exit 1
 fi
@@ -12,6 +12,7 @@ fi
 LIMITS_FILE="$1"
 SOURCE_FILE="$2"
 INPUT_FILE="$3"
+CHECK_ARGS=("${@:4}")
 
 # 检查是否有root权限
 if [ "$EUID" -ne 0 ]; then
@@ -55,11 +56,11 @@ fi
 echo "开始评测..."
 
 # 运行评测
-./judge_core_cgroup "$LIMITS_FILE" "$SOURCE_FILE" "$INPUT_FILE"
+./judge_core_cgroup "$LIMITS_FILE" "$SOURCE_FILE" "$INPUT_FILE" "${CHECK_ARGS[@]}"
 
 # 保存评测结果到文件
 RESULT_FILE="result_cgroup_$(date +%Y%m%d_%H%M%S).json"
-./judge_core_cgroup "$LIMITS_FILE" "$SOURCE_FILE" "$INPUT_FILE" > "$RESULT_FILE"
+./judge_core_cgroup "$LIMITS_FILE" "$SOURCE_FILE" "$INPUT_FILE" "${CHECK_ARGS[@]}" > "$RESULT_FILE"
 
 echo ""
 echo "评测完成，结果已保存到: $RESULT_FILE"
@@ -0,0 +1,65 @@
+/**
+ * @file judge_checker.h
+ * @brief 进程内checker插件的C ABI
+ *
+ * 受信任的出题人checker可以编译为共享库，由评测核心通过dlopen加载一次，
+ * 每个测试点在fork出的辅助进程中调用(超时可杀死)，省去exec和动态链接的开销
+ *
+ * 编译方式：
+ *   g++ -O2 -shared -fPIC checker.cpp -o checker.so
+ *
+ * @warning 插件在评测核心的地址空间副本中运行，没有沙箱隔离，只能加载受信任的代码
+ *          不受信任的checker请以可执行文件形式提供，评测核心会在cgroup中运行它
+ */
+
+#ifndef JUDGE_CHECKER_H
+#define JUDGE_CHECKER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** 当前ABI版本，插件导出的judge_checker_abi_version必须返回该值 */
+#define JUDGE_CHECKER_ABI_VERSION 1
+
+/** checker返回值 */
+enum
+{
+    JUDGE_CHECKER_AC = 0, ///< 答案正确
+    JUDGE_CHECKER_WA = 1, ///< 答案错误
+    JUDGE_CHECKER_PE = 2  ///< 格式错误
+};
+
+/**
+ * @brief 插件导出的ABI版本函数
+ * @return int 必须返回JUDGE_CHECKER_ABI_VERSION
+ */
+typedef int (*judge_checker_abi_version_fn)(void);
+
+/**
+ * @brief 插件导出的检查函数，符号名为judge_checker_check
+ * @param input 测试输入(只读映射，不保证以'\0'结尾)
+ * @param input_size 测试输入长度
+ * @param output 选手输出
+ * @param output_size 选手输出长度
+ * @param answer 标准答案
+ * @param answer_size 标准答案长度
+ * @param message 反馈信息输出缓冲区
+ * @param message_size 反馈信息缓冲区容量(含结尾'\0')
+ * @return int JUDGE_CHECKER_AC/WA/PE，其他值视为checker故障(SE)
+ *
+ * @note 函数必须是可重入的：并行评测时可能在多个线程中同时调用
+ */
+typedef int (*judge_checker_check_fn)(const char *input, size_t input_size,
+                                      const char *output, size_t output_size,
+                                      const char *answer, size_t answer_size,
+                                      char *message, size_t message_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JUDGE_CHECKER_H
@@ -40,10 +40,93 @@
 #include <sched.h>        // CPU调度和亲和性
 #include <sstream>        // 字符串流
 #include <random>         // 随机数生成
+#include <array>          // 定长数组
+#include <mutex>          // 互斥锁
+#include <cstring>        // 内存拷贝
+#include <sys/mman.h>     // 内存映射
+#include <climits>        // 整数上限
+#include <memory_resource> // 多态内存资源(arena)
+#include <string_view>    // 字符串视图
+#include <charconv>       // 数字与字符转换
+#include <atomic>         // 原子计数
+#include <memory>         // 智能指针
+#include <span>           // 连续序列视图
+#include <algorithm>      // 排序
+#include <thread>         // 工作线程
+#include <cmath>          // 统计计算
+#include <sys/file.h>     // flock文件锁
+#include <sys/ioctl.h>    // perf事件控制
+#include <sys/syscall.h>  // perf_event_open系统调用
+#include <linux/perf_event.h> // perf采样接口
+#include <linux/bpf.h>        // eBPF系统调用采集
+#include <sys/mount.h>        // 挂载tracefs
+#include <sys/personality.h>  // 关闭地址随机化
+#include <elf.h>          // ELF程序头解析
+#include <unordered_map>  // 哈希表
+#include <unordered_set>  // 内存密集程序记录
+#include <poll.h>         // 等待pidfd
+#include <dlfcn.h>        // 加载checker插件
+#include <condition_variable> // checker看门狗
+#include <deque>          // 后处理任务队列
+#include <optional>       // 可选的自有cgroup
+#include <future>         // 预备下一个测试点
+#include <sys/sendfile.h> // 输入复制到memfd
+#include <spawn.h>        // 不经shell启动addr2line
+#include "judge_checker.h" // checker插件C ABI
 
 using namespace std;
 using namespace std::chrono;
 
+/**
+ * @struct RunSample
+ * @brief 单次运行的采样记录
+ *
+ * 边界时间重测时记录每一次运行的结果，随最终结果一起返回
+ */
+struct RunSample
+{
+    long long time_used;       ///< 本次运行时间(毫秒)
+    string_view status;        ///< 本次运行的评测状态
+    string_view allocated_cpu; ///< 本次运行分配的CPU核心编号
+    bool interfered;           ///< 本次运行是否受到干扰
+};
+
+/**
+ * @struct PhaseTimes
+ * @brief 一次评测各阶段的耗时(微秒)，-1表示该阶段未执行
+ */
+struct PhaseTimes
+{
+    long long load_us = -1;    ///< 加载配置和启动检查
+    long long compile_us = -1; ///< 编译(命中编译缓存时只有查找开销)
+    long long run_us = -1;     ///< 运行(含cgroup创建/清理和边界重测)
+    long long check_us = -1;   ///< 答案检查
+};
+
+/**
+ * @struct SyscallCount
+ * @brief 系统调用直方图的一项
+ */
+struct SyscallCount
+{
+    int nr;          ///< 系统调用号
+    long long count; ///< 调用次数
+};
+
+/**
+ * @struct SyscallProfile
+ * @brief 一次运行的系统调用与离核时间统计
+ */
+struct SyscallProfile
+{
+    span<const SyscallCount> histogram; ///< 按次数降序的非零项(位于任务arena)
+    long long total = 0;                ///< 系统调用总次数
+    long long blocked_us = 0;           ///< 睡眠/阻塞在I/O上的离核时间(微秒)
+    long long blocked_count = 0;        ///< 阻塞次数
+    long long runnable_us = 0;          ///< 被抢占后等待重新上核的时间(微秒)
+    long long runnable_count = 0;       ///< 被抢占次数
+};
+
 /**
  * @struct JudgeResult
  * @brief 评测结果数据结构
@@ -52,14 +135,47 @@ using namespace std::chrono;
  */
 struct JudgeResult
 {
-    string status;         ///< 评测状态：OK/TLE/MLE/RE/CE/OLE/SE
-    long long time_used;   ///< 实际执行时间(毫秒)
-    long long mem_used;    ///< 峰值内存使用量(字节，来自memory.peak)
-    int exit_code;         ///< 程序退出代码
-    string error_message;  ///< 详细错误信息
-    string stdout_content; ///< 程序标准输出内容
-    int output_len;        ///< 输出内容长度(字节)
-    string allocated_cpu;  ///< 分配的CPU核心编号
+    string_view status;         ///< 评测状态：OK/WA/PE/PC/TLE/MLE/ILE/RE/CE/OLE/SE(字符串常量)
+    long long time_used;        ///< 实际执行时间(毫秒)
+    long long mem_used;         ///< 峰值内存使用量(字节，来自memory.peak)
+    int exit_code;              ///< 程序退出代码
+    string_view error_message;  ///< 详细错误信息(位于任务arena)
+    string_view stdout_content; ///< 程序标准输出内容(位于任务arena)
+    int output_len;             ///< 输出内容长度(字节)
+    string_view allocated_cpu;  ///< 分配的CPU核心编号(位于任务arena)
+    span<const RunSample> samples; ///< 边界时间重测的全部采样(位于任务arena)，未重测时为空
+    long long time_used_raw = 0;        ///< 归一化前的原始运行时间(毫秒)
+    long long time_used_normalized = 0; ///< 折算到参考机器的运行时间(毫秒)
+    double host_speed_factor = 0;       ///< 主机速度系数(本机耗时/参考机耗时)，0表示未启用
+    bool cpufreq_checked = false;       ///< 是否记录了核心频率状态(cpufreq_guard开启时)
+    string_view cpu_governor;           ///< 运行核心的调频策略(位于任务arena)
+    int cpu_boost = -1;                 ///< 睿频状态：1开启，0关闭，-1未知
+    long long cpu_freq_min_khz = -1;    ///< 运行期间程序占用CPU时采样到的最低频率(kHz)
+    long long cpu_freq_max_khz = -1;    ///< 运行期间程序占用CPU时采样到的最高频率(kHz)
+    bool cpu_throttled = false;         ///< 运行核心是否处于降频状态
+    bool profiled = false;              ///< 是否附带了性能剖析结果
+    string_view profile;                ///< 热点函数/代码行的JSON片段(位于任务arena)
+    string_view checker;                ///< 使用的checker：builtin/plugin/sandbox，未检查答案时为空
+    string_view checker_message;        ///< checker反馈信息(位于任务arena)
+    long long checker_time_us = -1;     ///< 答案检查耗时(微秒)
+    double score = -1;                  ///< checker给出的得分：AC为1，WA/PE为0，PC为部分分，-1表示未检查
+    PhaseTimes phases;                  ///< 各阶段耗时，report_phases开启时输出
+    long long cpu_time_used = -1;       ///< 从exec成功起计的CPU时间(毫秒)，未执行到exec时为-1
+    bool interference_checked = false;  ///< 是否采集了干扰指标(程序执行到exec时采集)
+    bool interfered = false;            ///< 干扰指标超过阈值，本次计时不可信
+    long long runqueue_wait_us = -1;    ///< 可运行但未拿到CPU的累计时间(微秒)，来自schedstat
+    long long involuntary_switches = -1; ///< 被动上下文切换次数(ru_nivcsw)
+    long long throttled_usec = -1;      ///< 运行期间cgroup被CPU带宽节流的时间(微秒)，-1表示不可用
+    string_view interference_reason;    ///< 超过阈值的指标名，逗号分隔(位于任务arena)
+    bool contention_checked = false;    ///< 是否记录了访存争用信息
+    bool memory_heavy = false;          ///< 本次运行是否按内存密集租用核心
+    bool heavy_neighbor = false;        ///< 租用时同一LLC域中是否已有其他内存密集的运行
+    int llc_domain = -1;                ///< 运行核心所在的LLC域(域内编号最小的核心)，-1表示未知
+    long long llc_misses = -1;          ///< 末级缓存未命中次数，-1表示没有硬件计数器
+    long long miss_bandwidth_mbps = -1; ///< 按未命中估算的访存带宽(MB/s)
+    bool syscalls_traced = false;       ///< 是否附带了eBPF系统调用统计(syscall_trace开启时)
+    SyscallProfile syscalls;            ///< 系统调用直方图和离核时间
+    string_view syscall_trace_error;    ///< 开启syscall_trace但无法采集的原因
 };
 
 /**
@@ -75,956 +191,7447 @@ struct Limits
     int output_limit;       ///< 输出大小限制(字节)
     int compile_timeout;    ///< 编译超时时间(毫秒)
     long long stack_limit;  ///< 栈大小限制(字节)
+
+    // 以下为可选配置，配置文件中缺省时使用成员默认值
+    int rerun_band = 0;     ///< 边界重测区间(time_limit的百分比)，0表示关闭
+    int rerun_max = 3;      ///< 边界重测的最大额外运行次数
+    int rerun_policy = 0;   ///< 重测取值策略：0取最小值，1取中位数
+    int calibrate_runs = 5;       ///< 校准模式下每个测试点的运行次数
+    int calibrate_factor = 200;   ///< 校准建议时限 = 最慢运行时间 × calibrate_factor%
+    int calibrate_time_limit = 30000; ///< 校准运行使用的时限(毫秒)，与题目时限无关
+    int speed_reference = 0;      ///< 参考机器的基准测试得分(微秒)，0表示不做速度归一化
+    int normalize_time = 0;       ///< 1表示用归一化后的时间判定TLE
+    int speed_refresh = 3600;     ///< 基准测试结果的有效期(秒)
+    int cpufreq_guard = 0;        ///< 调频检查：0关闭，1记录并标记降频核心，2拒绝降频核心
+    int cpufreq_pin = 0;          ///< 1表示租用核心前把调频策略固定为performance
+    int cpufreq_min_percent = 90; ///< 负载下的频率低于标称频率的该百分比视为降频
+    int profile = 0;              ///< 1表示额外运行一次并用perf采样热点
+    int profile_freq = 999;       ///< 采样频率(Hz)，上限4999
+    int profile_top = 10;         ///< 报告的热点条目数
+    int checker_time_limit = 5000; ///< checker时间限制(毫秒)，插件和沙箱checker相同
+    int report_phases = 0;        ///< 1表示在结果中输出各阶段耗时
+    int compile_cache = 0;        ///< 1表示选手程序也经过编译缓存(仅用于压测/回放，缓存不淘汰)
+    int prefetch_binary = 1;      ///< 计时前预读可执行文件和共享库：0关闭，1读入页缓存，2另外mlock
+    int idle_limit = 1000;        ///< CPU几乎不前进的连续墙钟时间上限(毫秒)，超过判ILE，0关闭
+    int lookahead = 1;            ///< 多测试点运行时提前准备下一个测试点：1开启，0关闭
+    int interference_wait_us = 20000; ///< 运行队列等待超过该值(微秒)视为受干扰，0表示不检查
+    int interference_nivcsw = 200;    ///< 被动上下文切换超过该次数视为受干扰，0表示不检查
+    int interference_rerun = 0;       ///< 1表示受干扰的OK/TLE结果自动重测(与边界重测共用rerun_max)
+    int memory_class = 0;             ///< 访存提示：0按观测的缓存未命中分类，1内存密集，2非内存密集
+    int memory_heavy_mbps = 1000;     ///< 估算访存带宽达到该值(MB/s)的程序记为内存密集
+    int syscall_trace = 0;            ///< 1表示用eBPF按cgroup统计系统调用次数和离核时间
+    int deterministic_env = 0;        ///< 1表示以固定的环境变量、argv和工作目录执行选手程序
+    int disable_aslr = 0;             ///< 1表示以ADDR_NO_RANDOMIZE关闭选手程序的地址随机化
+    int generator_time_limit = 10000; ///< 子任务清单中生成器和标准程序生成测试数据的时限(毫秒)
+    int process_limit = 64;           ///< cgroup的pids.max(进程和线程总数)，root下RLIMIT_NPROC不生效，以此限制fork
+
+    double host_speed_factor = 1.0; ///< 运行时测得的主机速度系数(非配置项)
 };
 
+#ifdef JUDGE_ALLOC_STATS
+// 统计全局堆分配次数，用于对比arena启用前后的malloc压力
+// 编译：g++ -DJUDGE_ALLOC_STATS ... judge_core_cgroup.cpp
+static atomic<unsigned long long> g_heap_allocations{0};
+
+// new/delete成对替换且不内联：否则GCC会看到默认operator new与free配对，
+// 报-Wmismatched-new-delete
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    g_heap_allocations.fetch_add(1, memory_order_relaxed);
+    if (void *ptr = malloc(size ? size : 1))
+        return ptr;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) { return operator new(size); }
+__attribute__((noinline)) void operator delete(void *ptr) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete[](void *ptr) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+#endif
+
 /**
- * @class CgroupManager
- * @brief cgroup v2管理器类
+ * @class JobArena
+ * @brief 单个评测任务的内存arena
  *
- * 封装cgroup v2的创建、配置、监控和清理操作
- * 提供面向对象的cgroup管理接口，确保资源正确释放
+ * 基于pmr::monotonic_buffer_resource，为一次评测中产生的短生命周期字符串
+ * (cgroup路径、编译命令、错误信息、JSON片段等)提供内存
+ * 任务内只分配不释放，任务结束时通过reset()一次性回收
  *
- * 主要功能：
- * - 创建和删除cgroup
- * - 设置内存限制
- * - 添加进程到cgroup
- * - 监控内存使用情况
- * - 自动资源清理
+ * @details 内存来源：
+ *          - 初始块在构造时申请一次，reset()后复用，常规任务不再触发malloc
+ *          - 初始块用尽后由upstream(new/delete)按几何级数申请新块
+ *          - 分配操作加锁，同一任务的多个工作线程可以共享一个arena
+ *          - 通过Scope将arena设为当前线程的"当前任务arena"
+ *
+ * @warning JudgeResult中的string_view字段指向arena，必须在reset()之前使用完毕
  */
-class CgroupManager
+class JobArena : public pmr::memory_resource
 {
-private:
-    string cgroup_path; ///< cgroup在文件系统中的完整路径
-    string cgroup_name; ///< cgroup名称（唯一标识符）
-    bool created;       ///< cgroup是否已成功创建
-
 public:
+    static constexpr size_t INITIAL_SIZE = 256UL << 10; ///< 初始块大小(字节)
+
+    JobArena() : initial_block(new char[INITIAL_SIZE]),
+                 monotonic(initial_block.get(), INITIAL_SIZE) {}
+
+    JobArena(const JobArena &) = delete;
+    JobArena &operator=(const JobArena &) = delete;
+
     /**
-     * @brief 构造函数
-     *
-     * 生成随机的cgroup名称，避免多个评测进程之间的冲突
-     * cgroup路径格式：/sys/fs/cgroup/judge_XXXXXX
+     * @class Scope
+     * @brief 在作用域内把arena设为当前线程的当前任务arena
      */
-    CgroupManager() : created(false)
+    class Scope
     {
-        // 生成随机的cgroup名称，确保唯一性
-        random_device rd;
-        mt19937 gen(rd());
-        uniform_int_distribution<> dis(100000, 999999);
-        cgroup_name = "judge_" + to_string(dis(gen));
-        cgroup_path = "/sys/fs/cgroup/" + cgroup_name;
+    private:
+        JobArena *previous; ///< 进入作用域前的当前arena
+
+    public:
+        explicit Scope(JobArena &arena) : previous(current_arena)
+        {
+            current_arena = &arena;
+        }
+
+        ~Scope()
+        {
+            current_arena = previous;
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    /**
+     * @brief 获取当前线程的任务arena
+     * @return JobArena& 未设置Scope时返回进程级的后备arena(从不reset)
+     */
+    static JobArena &current()
+    {
+        if (current_arena != nullptr)
+            return *current_arena;
+        static JobArena fallback;
+        return fallback;
     }
 
     /**
-     * @brief 析构函数
+     * @brief 任务结束时一次性释放全部分配
      *
-     * 自动清理cgroup资源，防止资源泄漏
-     * 使用RAII模式确保异常安全
+     * 释放upstream申请的额外块，并回到初始块起点
      */
-    ~CgroupManager()
+    void reset()
     {
-        cleanup();
+        lock_guard<mutex> lock(arena_mutex);
+        monotonic.release();
     }
 
     /**
-     * @brief 创建cgroup
-     * @return bool 创建成功返回true，失败返回false
-     *
-     * 在/sys/fs/cgroup下创建新的cgroup目录
-     * 需要root权限才能成功执行
-     *
-     * @note 创建失败通常是由于权限不足或cgroup v2未启用
+     * @brief 把文本复制到arena
+     * @return string_view 指向arena的视图，其后紧跟'\0'，可直接作为C字符串使用
      */
-    bool create()
+    string_view store(string_view text)
     {
-        // 创建cgroup目录，权限设置为755
-        if (mkdir(cgroup_path.c_str(), 0755) != 0)
-        {
-            return false;
-        }
-        created = true;
-        return true;
+        return concat({text});
     }
 
     /**
-     * @brief 设置内存限制
-     * @param limit_bytes 内存限制值(字节)
-     * @return bool 设置成功返回true，失败返回false
-     *
-     * 向memory.max文件写入内存限制值
-     * 超过此限制的进程将被内核杀死(SIGKILL)
-     *
-     * @warning limit_bytes必须是正数，过小的值可能导致进程无法启动
+     * @brief 把多段文本拼接到arena
+     * @return string_view 指向arena的视图，其后紧跟'\0'
      */
-    bool setMemoryLimit(long long limit_bytes)
+    string_view concat(initializer_list<string_view> parts)
     {
-        if (!created)
-            return false;
+        size_t length = 0;
+        for (string_view part : parts)
+            length += part.size();
 
-        ofstream memory_max(cgroup_path + "/memory.max");
-        if (!memory_max)
-            return false;
+        char *out = static_cast<char *>(allocate(length + 1, 1));
+        size_t offset = 0;
+        for (string_view part : parts)
+        {
+            if (!part.empty())
+                memcpy(out + offset, part.data(), part.size());
+            offset += part.size();
+        }
+        out[length] = '\0';
+        return string_view(out, length);
+    }
 
-        memory_max << limit_bytes << endl;
-        return memory_max.good();
+    /**
+     * @brief 把浮点数按固定小数位格式化后存入arena
+     */
+    string_view decimal(double value, int precision)
+    {
+        char digits[64];
+        auto [end, ec] = to_chars(digits, digits + sizeof(digits), value, chars_format::fixed, precision);
+        (void)ec;
+        return store(string_view(digits, end - digits));
     }
 
     /**
-     * @brief 设置CPU限制 - 严格固定在单个CPU核心
-     * @return bool 设置成功返回true，失败返回false
-     *
-     * 为待测程序分配一个固定的CPU核心，确保整个运行期间严格在该核心上执行
-     * 禁止进程在不同CPU核心之间迁移，提供完全一致的执行环境
-     *
-     * @details cpuset.cpus控制进程可以使用的CPU核心
-     *          - 选择一个可用的CPU核心并严格固定
-     *          - 设置CPU亲和性确保不会迁移
-     *          - 保证所有程序获得相同的单核心执行条件
-     *
-     * @note 严格单核心执行确保评测的绝对公平性
+     * @brief 把整数格式化为十进制文本存入arena
      */
-    bool setCpuLimit()
+    string_view number(long long value)
     {
-        if (!created)
-            return false;
+        char digits[24];
+        auto [end, ec] = to_chars(digits, digits + sizeof(digits), value);
+        (void)ec;
+        return store(string_view(digits, end - digits));
+    }
 
-        // 首先确保在根cgroup中启用cpuset控制器
-        ofstream root_subtree("/sys/fs/cgroup/cgroup.subtree_control");
-        if (root_subtree)
-        {
-            root_subtree << "+cpuset" << endl;
-            root_subtree.close();
-        }
+private:
+    static inline thread_local JobArena *current_arena = nullptr; ///< 当前线程的任务arena
 
-        // 选择一个CPU核心进行严格绑定
-        string selected_cpu = selectCpuForBinding();
-        if (selected_cpu.empty())
-        {
-            return false;
-        }
+    unique_ptr<char[]> initial_block;       ///< 初始块，跨任务复用
+    pmr::monotonic_buffer_resource monotonic; ///< 单调分配器
+    mutex arena_mutex;                      ///< 保护monotonic
 
-        // 设置cpuset.cpus - 严格限制在选定的单个CPU核心
-        ofstream cpuset_cpus(cgroup_path + "/cpuset.cpus");
-        if (!cpuset_cpus)
-            return false;
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        lock_guard<mutex> lock(arena_mutex);
+        return monotonic.allocate(bytes, alignment);
+    }
 
-        cpuset_cpus << selected_cpu << endl;
+    void do_deallocate(void *, size_t, size_t) override
+    {
+        // 单调分配：单个对象不回收，统一在reset()时释放
+    }
 
-        if (!cpuset_cpus.good())
-        {
-            return false;
-        }
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
 
-        // 设置cpuset.mems - 继承内存节点设置
-        ifstream parent_mems("/sys/fs/cgroup/cpuset.mems.effective");
-        string available_mems;
-        if (parent_mems)
-        {
-            getline(parent_mems, available_mems);
-            parent_mems.close();
-        }
+/**
+ * @brief 把整个小文件写入指定路径
+ * @param path 文件路径
+ * @param value 写入内容，末尾自动追加换行
+ * @return bool 写入成功返回true
+ *
+ * 用于cgroupfs控制文件，直接使用open/write避免fstream的缓冲区分配
+ */
+bool writeSmallFile(const char *path, string_view value)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return false;
 
-        if (available_mems.empty())
-        {
-            available_mems = "0";
-        }
+    char line[256];
+    if (value.size() + 1 > sizeof(line))
+    {
+        close(fd);
+        return false;
+    }
+    memcpy(line, value.data(), value.size());
+    line[value.size()] = '\n';
 
-        ofstream cpuset_mems(cgroup_path + "/cpuset.mems");
-        if (!cpuset_mems)
-            return false;
+    bool ok = write(fd, line, value.size() + 1) == static_cast<ssize_t>(value.size() + 1);
+    close(fd);
+    return ok;
+}
+
+/**
+ * @brief 读取小文件内容到调用者提供的缓冲区
+ * @param path 文件路径
+ * @param buffer 输出缓冲区
+ * @param capacity 缓冲区容量(含结尾'\0')
+ * @return string_view 去掉末尾换行后的内容，失败返回空视图且data()为nullptr
+ */
+string_view readSmallFile(const char *path, char *buffer, size_t capacity)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return string_view();
+
+    ssize_t bytes_read = read(fd, buffer, capacity - 1);
+    close(fd);
+    if (bytes_read < 0)
+        return string_view();
+
+    size_t length = static_cast<size_t>(bytes_read);
+    while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == ' '))
+        length--;
+    buffer[length] = '\0';
+    return string_view(buffer, length);
+}
+
+/**
+ * @brief 解析文本开头的十进制整数
+ * @return long long 解析结果，文本不以数字开头时返回-1
+ */
+long long parseLeadingNumber(string_view text)
+{
+    long long value = -1;
+    from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+/**
+ * @brief 计算FNV-1a 64位哈希
+ * @param data 数据
+ * @param hash 初始值，可传入上一段的结果以连续哈希多段数据
+ */
+uint64_t fnv1a64(string_view data, uint64_t hash = 14695981039346656037ULL)
+{
+    for (char c : data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief 按内容计算文件的FNV-1a哈希
+ * @return uint64_t 哈希值，文件无法读取时返回0
+ *
+ * 以64KB为单位流式读取，不把整个文件读入内存
+ */
+uint64_t hashFile(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
 
-        cpuset_mems << available_mems << endl;
-        return cpuset_mems.good();
+    char buffer[64 << 10];
+    uint64_t hash = fnv1a64({});
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        hash = fnv1a64(string_view(buffer, static_cast<size_t>(n)), hash);
     }
+    close(fd);
+    return n == 0 ? hash : 0;
+}
+
+/**
+ * @brief 把64位哈希格式化为16位十六进制文本存入arena
+ */
+string_view hashToHex(uint64_t hash)
+{
+    char digits[17];
+    snprintf(digits, sizeof(digits), "%016llx", static_cast<unsigned long long>(hash));
+    return JobArena::current().store(digits);
+}
+
+/**
+ * @class CpuLease
+ * @brief CPU核心租约
+ *
+ * 通过对每个核心对应的锁文件加flock排他锁，保证同一时刻一个核心只分配给
+ * 一次运行，对同一主机上的多个评测进程以及同一进程内的多个工作线程同样有效
+ *
+ * @details 租约规则：
+ *          - 锁文件位于LEASE_DIR/cpuN.lock，进程退出时内核自动释放flock
+ *          - 候选核心为评测进程自身的CPU亲和性集合(容器/cpuset限制会被遵守)
+ *          - 从提示位置开始依次尝试非阻塞加锁，全部被占用时阻塞等待提示核心
+ *          - 锁目录不可用时退化为不加锁，仅按提示位置选择核心
+ *          - 内存密集的运行另外对核心所在LLC域的LEASE_DIR/llcN.lock加OFD写锁，
+ *            优先选择没有其他内存密集运行的LLC域，全部被占用时才与之共处
+ *          - 域锁用OFD锁而不用flock，是为了能用F_OFD_GETLK只查询不加锁：
+ *            探测邻居时若临时取得共享锁，会让并发的内存密集运行加锁失败而错选域
+ */
+class CpuLease
+{
+public:
+    static constexpr const char *LEASE_DIR = "/run/judge_core"; ///< 锁文件目录
+
+private:
+    int cpu_id = -1;  ///< 已租用的核心编号
+    int lock_fd = -1; ///< 锁文件描述符，-1表示未加锁
+    int heavy_fd = -1; ///< LLC域内存密集锁的描述符，-1表示未持有
+    bool heavy_neighbor = false; ///< 租用时同一LLC域中是否已有内存密集的运行
 
     /**
-     * @brief 强制CPU绑定到指定核心
-     * @param pid 进程ID
-     * @param cpu_id CPU核心ID
-     * @return bool 绑定成功返回true，失败返回false
-     *
-     * 使用sched_setaffinity直接设置进程的CPU亲和性
-     * 这是对cgroup cpuset的补充，确保更严格的CPU绑定
+     * @brief 打开核心或LLC域对应的锁文件
+     * @param kind 锁的种类：cpu或llc
+     * @return int 文件描述符，失败返回-1
      */
-    bool forceCpuBinding(pid_t pid, int cpu_id)
+    static int openLockFile(const char *kind, int index)
     {
-        cpu_set_t cpu_set;
-        CPU_ZERO(&cpu_set);
-        CPU_SET(cpu_id, &cpu_set);
-
-        if (sched_setaffinity(pid, sizeof(cpu_set), &cpu_set) == 0)
-        {
-            return true;
-        }
-        return false;
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%s%d.lock", LEASE_DIR, kind, index);
+        return open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
     }
 
-private:
     /**
-     * @brief 选择CPU核心进行严格绑定
-     * @return string 选定的CPU核心编号，失败返回空字符串
-     *
-     * 基于轮询策略选择一个CPU核心，确保多个评测进程分散到不同核心
-     * 但每个进程都严格固定在其分配的核心上
+     * @brief 读取核心共享的最末级缓存所覆盖的核心列表中的第一个核心
+     * @return int 失败返回-1
      *
-     * @details 选择策略：
-     *          1. 获取系统可用CPU核心数量
-     *          2. 使用时间戳进行轮询分配
-     *          3. 确保选择的核心有效且可用
-     *          4. 返回单个核心编号用于严格绑定
+     * 取cache/indexN中级别最高的数据/统一缓存，没有缓存信息时退回同一插槽(package)
      */
-    string selectCpuForBinding()
+    static int readLlcDomain(int cpu)
     {
-        // 获取系统CPU核心数量
-        int cpu_count = getCpuCount();
-        if (cpu_count <= 0)
+        char path[128];
+        char buffer[256];
+        int best_level = 0;
+        int domain = -1;
+        for (int index = 0; index < 8; index++)
         {
-            return "0"; // 默认使用CPU 0
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, index);
+            string_view type = readSmallFile(path, buffer, sizeof(buffer));
+            if (type.empty())
+                break;
+            if (type == "Instruction")
+                continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+            int level = static_cast<int>(parseLeadingNumber(readSmallFile(path, buffer, sizeof(buffer))));
+            if (level <= best_level)
+                continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+            long long first = parseLeadingNumber(readSmallFile(path, buffer, sizeof(buffer)));
+            if (first >= 0)
+            {
+                best_level = level;
+                domain = static_cast<int>(first);
+            }
         }
+        if (domain < 0)
+        {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/package_cpus_list", cpu);
+            domain = static_cast<int>(parseLeadingNumber(readSmallFile(path, buffer, sizeof(buffer))));
+        }
+        return domain;
+    }
 
-        // 使用时间戳进行轮询，确保不同时间启动的进程分散到不同核心
-        auto now = chrono::high_resolution_clock::now();
-        auto timestamp = now.time_since_epoch().count();
-
-        // 基于cgroup名称和时间戳计算，增加随机性
-        size_t hash_value = std::hash<string>{}(cgroup_name) ^ timestamp;
-        int selected_cpu = hash_value % cpu_count;
-
-        return to_string(selected_cpu);
+    /**
+     * @brief 对LLC域锁文件加非阻塞的OFD写锁(随描述符关闭释放)
+     */
+    static bool lockDomain(int fd)
+    {
+        struct flock lock;
+        memset(&lock, 0, sizeof(lock));
+        lock.l_type = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        return fcntl(fd, F_OFD_SETLK, &lock) == 0;
     }
 
     /**
-     * @brief 获取系统CPU核心数量
-     * @return int CPU核心数量，失败返回-1
+     * @brief 检查LLC域中是否有内存密集的运行(持有该域的写锁)
      *
-     * 通过读取/proc/cpuinfo获取系统的CPU核心数量
-     * 用于CPU分配时的轮询计算
+     * 只用F_OFD_GETLK查询冲突的锁，自身不加锁，不会干扰并发的lockDomain
      */
-    int getCpuCount()
+    static bool domainHasHeavy(int domain)
     {
-        ifstream cpuinfo("/proc/cpuinfo");
-        if (!cpuinfo)
-        {
-            return -1;
-        }
+        int fd = openLockFile("llc", domain);
+        if (fd == -1)
+            return false;
+        struct flock lock;
+        memset(&lock, 0, sizeof(lock));
+        lock.l_type = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        bool held = fcntl(fd, F_OFD_GETLK, &lock) == 0 && lock.l_type != F_UNLCK;
+        close(fd);
+        return held;
+    }
 
-        int cpu_count = 0;
-        string line;
-        while (getline(cpuinfo, line))
+    /**
+     * @brief 为内存密集的运行租用一个所在LLC域空闲的核心
+     * @return bool 所有LLC域都已有内存密集运行(或核心都被占用)时返回false
+     */
+    bool acquireInQuietDomain(size_t start, const function<bool(int)> &acceptable)
+    {
+        const vector<int> &cpus = allowedCpus();
+        for (size_t i = 0; i < cpus.size(); i++)
         {
-            if (line.find("processor") == 0)
+            int cpu = cpus[(start + i) % cpus.size()];
+            int domain = llcDomain(cpu);
+            if (domain < 0 || (acceptable && !acceptable(cpu)))
+                continue;
+            int domain_fd = openLockFile("llc", domain);
+            if (domain_fd == -1)
+                continue;
+            if (!lockDomain(domain_fd))
+            {
+                close(domain_fd);
+                continue;
+            }
+            int fd = openLockFile("cpu", cpu);
+            if (fd != -1 && flock(fd, LOCK_EX | LOCK_NB) == 0)
             {
-                cpu_count++;
+                cpu_id = cpu;
+                lock_fd = fd;
+                heavy_fd = domain_fd;
+                return true;
             }
+            if (fd != -1)
+                close(fd);
+            close(domain_fd);
         }
-        cpuinfo.close();
-
-        return cpu_count > 0 ? cpu_count : 1;
+        return false;
     }
 
 public:
+    CpuLease() = default;
+    ~CpuLease() { release(); }
+
+    CpuLease(const CpuLease &) = delete;
+    CpuLease &operator=(const CpuLease &) = delete;
+
     /**
-     * @brief 将进程添加到cgroup
-     * @param pid 要添加的进程ID
-     * @return bool 添加成功返回true，失败返回false
-     *
-     * 向cgroup.procs文件写入进程ID，使该进程受cgroup限制
-     * 进程的所有子进程也会自动受到相同限制
-     *
-     * @note 进程必须存在且调用者有权限操作该进程
+     * @brief 获取评测进程可用的CPU核心列表
+     * @return const vector<int>& 核心编号列表(首次调用时读取亲和性并缓存)
      */
-    bool addProcess(pid_t pid)
+    static const vector<int> &allowedCpus()
     {
-        if (!created)
-            return false;
-
-        ofstream cgroup_procs(cgroup_path + "/cgroup.procs");
-        if (!cgroup_procs)
-            return false;
-
-        cgroup_procs << pid << endl;
-        return cgroup_procs.good();
+        static const vector<int> cpus = []
+        {
+            vector<int> list;
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+            {
+                for (int i = 0; i < CPU_SETSIZE; i++)
+                    if (CPU_ISSET(i, &cpu_set))
+                        list.push_back(i);
+            }
+            if (list.empty())
+                list.push_back(0);
+            return list;
+        }();
+        return cpus;
     }
 
     /**
-     * @brief 获取峰值内存使用量
-     * @return long long 峰值内存使用量(字节)，失败返回-1
-     *
-     * 从memory.peak文件读取进程运行期间的峰值内存使用量
-     * 这是cgroup v2提供的高精度内存监控特性
-     *
-     * @details memory.peak记录cgroup中所有进程的峰值物理内存使用
-     *          包括程序本身、动态分配的内存、共享库等
-     *          比传统的rusage.ru_maxrss更准确、更完整
-     *
-     * @note 只有在进程执行完毕后读取才有意义
+     * @brief 获取核心所在的LLC域
+     * @return int 域内编号最小的核心，拓扑未知时返回-1
      */
-    long long getMemoryPeak()
+    static int llcDomain(int cpu)
     {
-        if (!created)
-            return -1;
-
-        ifstream memory_peak(cgroup_path + "/memory.peak");
-        if (!memory_peak)
-            return -1;
-
-        long long peak;
-        memory_peak >> peak;
-        return memory_peak.good() ? peak : -1;
+        static const vector<int> domains = []
+        {
+            const vector<int> &cpus = allowedCpus();
+            vector<int> list(static_cast<size_t>(cpus.back()) + 1, -1);
+            for (int cpu : cpus)
+                list[cpu] = readLlcDomain(cpu);
+            return list;
+        }();
+        return cpu >= 0 && static_cast<size_t>(cpu) < domains.size() ? domains[cpu] : -1;
     }
 
     /**
-     * @brief 获取当前内存使用量
-     * @return long long 当前内存使用量(字节)，失败返回-1
-     *
-     * 从memory.current文件读取当前实时内存使用量
-     * 主要用于调试和实时监控
+     * @brief 租用一个CPU核心
+     * @param hint 起始提示位置，用于把并发的评测分散到不同核心
+     * @param acceptable 可选的核心过滤条件，返回false的核心不会被租用
+     * @param memory_heavy 本次运行是否内存密集，是则优先避开已有内存密集运行的LLC域
+     * @return bool 成功返回true，没有满足过滤条件的核心时返回false
      *
-     * @note 此值会实时变化，通常用于监控而非最终统计
+     * @note 所有可用核心都被占用时会阻塞，直到提示位置之后第一个可用核心被释放
      */
-    long long getCurrentMemory()
+    bool acquire(size_t hint, const function<bool(int)> &acceptable = nullptr, bool memory_heavy = false)
     {
-        if (!created)
-            return -1;
-
-        ifstream memory_current(cgroup_path + "/memory.current");
-        if (!memory_current)
-            return -1;
-
-        long long current;
-        memory_current >> current;
-        return memory_current.good() ? current : -1;
+        bool acquired = acquireCpu(hint, acceptable, memory_heavy, true);
+        if (acquired && heavy_fd == -1 && lock_fd != -1)
+        {
+            int domain = llcDomain(cpu_id);
+            heavy_neighbor = domain >= 0 && domainHasHeavy(domain);
+        }
+        return acquired;
     }
 
     /**
-     * @brief 清理cgroup资源
-     *
-     * 删除cgroup目录，释放内核资源
-     * 在析构函数中自动调用，也可手动调用
-     *
-     * @note 只有在cgroup中没有进程时才能成功删除
-     *       进程结束后内核会自动清理，但显式删除是好习惯
+     * @brief 尝试租用一个空闲核心，不阻塞
+     * @return bool 所有核心都被占用时返回false
      */
-    void cleanup()
+    bool tryAcquire(size_t hint)
     {
-        if (created)
+        return acquireCpu(hint, nullptr, false, false);
+    }
+
+private:
+    bool acquireCpu(size_t hint, const function<bool(int)> &acceptable, bool memory_heavy, bool wait)
+    {
+        release();
+
+        const vector<int> &cpus = allowedCpus();
+        size_t start = hint % cpus.size();
+
+        // 应用过滤条件，把提示位置移到第一个满足条件的核心
+        if (acceptable)
         {
-            // 删除cgroup目录，释放内核资源
-            rmdir(cgroup_path.c_str());
-            created = false;
+            size_t i = 0;
+            while (i < cpus.size() && !acceptable(cpus[(start + i) % cpus.size()]))
+                i++;
+            if (i == cpus.size())
+                return false;
+            start = (start + i) % cpus.size();
+        }
+
+        static const bool lease_dir_ready = mkdir(LEASE_DIR, 0755) == 0 || errno == EEXIST;
+        if (!lease_dir_ready)
+        {
+            cpu_id = cpus[start];
+            return true;
+        }
+
+        if (memory_heavy && acquireInQuietDomain(start, acceptable))
+            return true;
+
+        // 从提示位置开始寻找空闲核心
+        for (size_t i = 0; i < cpus.size(); i++)
+        {
+            int cpu = cpus[(start + i) % cpus.size()];
+            if (acceptable && !acceptable(cpu))
+                continue;
+            int fd = openLockFile("cpu", cpu);
+            if (fd == -1)
+                continue;
+            if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+            {
+                cpu_id = cpu;
+                lock_fd = fd;
+                return true;
+            }
+            close(fd);
+        }
+
+        // 全部核心都被占用，阻塞等待提示位置的核心
+        if (!wait)
+            return false;
+        int fd = openLockFile("cpu", cpus[start]);
+        if (fd == -1)
+            return false;
+        if (flock(fd, LOCK_EX) != 0)
+        {
+            close(fd);
+            return false;
         }
+        cpu_id = cpus[start];
+        lock_fd = fd;
+        return true;
     }
 
+public:
     /**
-     * @brief 获取cgroup名称
-     * @return const string& cgroup名称的常量引用
-     *
-     * 返回此cgroup的唯一名称，用于调试和日志记录
+     * @brief 释放租约
      */
-    const string &getName() const
+    void release()
     {
-        return cgroup_name;
+        if (lock_fd != -1)
+        {
+            close(lock_fd); // 关闭文件即释放flock
+            lock_fd = -1;
+        }
+        if (heavy_fd != -1)
+        {
+            close(heavy_fd);
+            heavy_fd = -1;
+        }
+        cpu_id = -1;
+        heavy_neighbor = false;
     }
 
     /**
-     * @brief 获取分配的CPU核心编号
-     * @return string 当前分配的CPU核心编号，失败返回空字符串
-     *
-     * 读取当前cgroup分配的CPU核心信息
-     * 用于调试和验证CPU分配是否正确
+     * @brief 获取已租用的核心编号
+     * @return int 核心编号，未租用返回-1
      */
-    string getAllocatedCpu() const
-    {
-        if (!created)
-            return "";
+    int cpu() const { return cpu_id; }
 
-        ifstream cpuset_cpus(cgroup_path + "/cpuset.cpus");
-        if (!cpuset_cpus)
-            return "";
+    /**
+     * @brief 是否持有所在LLC域的内存密集锁
+     */
+    bool holdsHeavyDomain() const { return heavy_fd != -1; }
 
-        string allocated_cpu;
-        getline(cpuset_cpus, allocated_cpu);
-        return allocated_cpu;
-    }
+    /**
+     * @brief 租用时同一LLC域中是否已有其他内存密集的运行
+     * @note 内存密集的运行只在所有LLC域都被占用时才会与之共处
+     */
+    bool hasHeavyNeighbor() const { return heavy_neighbor; }
 };
 
 /**
- * @brief 解析JSON数字值
- * @param json JSON字符串
- * @param key 要解析的键名
- * @return long long 解析得到的数值，失败返回-1
- *
- * 简单的JSON解析器，只支持数字类型
- * 避免引入外部JSON库依赖，减少系统复杂性
- *
- * @details 解析过程：
- *          1. 查找键名位置
- *          2. 查找冒号分隔符
- *          3. 跳过空白字符
- *          4. 解析数字字符
- *
- * @note 此实现仅支持正整数，不支持负数、浮点数或科学计数法
- * @warning 输入的JSON格式必须正确，否则可能返回错误结果
+ * @struct CpuFreqState
+ * @brief 单个CPU核心的调频状态快照
  */
-long long parseJsonNumber(const string &json, const string &key)
+struct CpuFreqState
 {
-    // 查找键名在JSON字符串中的位置
-    size_t pos = json.find("\"" + key + "\"");
-    if (pos == string::npos)
-        return -1;
-
-    // 查找冒号分隔符
-    pos = json.find(":", pos);
-    if (pos == string::npos)
-        return -1;
-
-    // 跳过冒号后的空白字符
-    pos++;
-    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t'))
-        pos++;
-
-    // 解析数字字符，累积计算数值
-    long long result = 0;
-    while (pos < json.length() && json[pos] >= '0' && json[pos] <= '9')
-    {
-        result = result * 10 + (json[pos] - '0');
-        pos++;
-    }
-
-    return result;
-}
+    char governor[32] = "";        ///< scaling_governor，无cpufreq时为空
+    long long cur_khz = -1;        ///< scaling_cur_freq
+    long long limit_khz = -1;      ///< scaling_max_freq(策略允许的最高频率)
+    long long base_khz = -1;       ///< base_frequency(标称频率，仅intel_pstate等驱动提供)
+    long long throttle_count = -1; ///< thermal_throttle/core_throttle_count
+    int boost = -1;                ///< 睿频：1开启，0关闭，-1未知
+};
 
 /**
- * @brief 加载资源限制配置
- * @param limits_file 配置文件路径
- * @return Limits 解析后的限制配置结构体
+ * @class CpuFreqGuard
+ * @brief CPU调频与睿频状态检查
  *
- * 从JSON配置文件加载各种资源限制参数
- * 支持默认值fallback，确保系统在配置文件缺失时仍能正常运行
+ * 评测核心所在CPU的调频策略切换、睿频和过热降频都会造成计时抖动
+ * 本类读取sysfs中的cpufreq信息，用于启动检查、租用前过滤和逐次记录
  *
- * @details 配置项说明：
- *          - time_limit: CPU时间限制(毫秒)
- *          - memory_limit: 内存限制(KB，内部转换为字节)
- *          - output_limit: 输出大小限制(字节)
- *          - compile_timeout: 编译超时时间(毫秒)
- *          - stack_limit: 栈大小限制(KB，内部转换为字节)
+ * @details 数据来源：
+ *          - /sys/devices/system/cpu/cpuN/cpufreq/{scaling_governor,scaling_cur_freq,scaling_max_freq,base_frequency}
+ *          - /sys/devices/system/cpu/cpuN/thermal_throttle/core_throttle_count
+ *          - /sys/devices/system/cpu/cpufreq/boost 或 intel_pstate/no_turbo
  *
- * @note 所有KB单位的配置项会自动转换为字节存储
- * @warning 如果配置文件格式错误，将使用默认值并继续执行
+ * @details 降频判定：
+ *          - 空闲核心在schedutil/powersave下本来就运行在低频，睿频核心的cpuinfo_max_freq
+ *            也高于持续频率，因此不用空闲时的点读数和硬件最高频率判定
+ *          - 参考频率取base_frequency，没有时取scaling_max_freq
+ *          - 租用前只检查策略上限是否被压低(isCapped)
+ *          - 运行期间在程序占用CPU的节拍上采样频率(isSlow)，并比较过热降频计数
+ *
+ * @note 虚拟机和容器中通常没有cpufreq，此时各字段保持未知值，不视为降频
  */
-Limits loadLimits(const string &limits_file)
+class CpuFreqGuard
 {
-    Limits limits;
-    ifstream file(limits_file);
-
-    // 如果文件打开失败，使用默认配置
-    if (!file.is_open())
+public:
+    /**
+     * @brief 读取核心当前的调频状态
+     */
+    static CpuFreqState read(int cpu)
     {
-        // 默认配置值（适合大多数竞赛题目）
-        limits.time_limit = 1000;       // 1秒
-        limits.memory_limit = 67108864; // 64MB
-        limits.output_limit = 64000000; // 64MB
-        limits.compile_timeout = 30000; // 30秒
-        limits.stack_limit = 8388608;   // 8MB
-        return limits;
-    }
-
-    // 读取整个文件内容到字符串
-    stringstream buffer;
-    buffer << file.rdbuf();
-    string json = buffer.str();
-
-    // 解析各个配置项
-    long long time_limit = parseJsonNumber(json, "time_limit");
-    long long memory_limit = parseJsonNumber(json, "memory_limit");
-    long long output_limit = parseJsonNumber(json, "output_limit");
-    long long compile_timeout = parseJsonNumber(json, "compile_timeout");
-    long long stack_limit = parseJsonNumber(json, "stack_limit");
+        CpuFreqState state;
+        char path[128];
+        char buffer[64];
 
-    // 设置配置值，解析失败时使用默认值
-    limits.time_limit = (time_limit > 0) ? time_limit : 1000;
-    limits.memory_limit = (memory_limit > 0) ? memory_limit * 1024 : 67108864; // KB转字节
-    limits.output_limit = (output_limit > 0) ? output_limit : 64000000;
-    limits.compile_timeout = (compile_timeout > 0) ? compile_timeout : 30000;
-    limits.stack_limit = (stack_limit > 0) ? stack_limit * 1024 : 8388608; // KB转字节
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+        string_view governor = readSmallFile(path, buffer, sizeof(buffer));
+        snprintf(state.governor, sizeof(state.governor), "%.*s", static_cast<int>(governor.size()), governor.data());
 
-    return limits;
-}
+        state.cur_khz = currentKhz(cpu);
 
-JudgeResult compileProgram(const string &source_file, const string &output_file, const Limits &limits)
-{
-    JudgeResult result;
-    result.status = "CE";
-    result.time_used = 0;
-    result.mem_used = 0;
-    result.exit_code = 0;
-    result.output_len = 0;
-    result.allocated_cpu = "";
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_max_freq", cpu);
+        state.limit_khz = parseLeadingNumber(readSmallFile(path, buffer, sizeof(buffer)));
 
-    // 创建编译命令
-    string compile_cmd = "g++ -g -std=c++20 -O2 -Wall -Wextra -Wshadow -Wconversion -Wfloat-equal " + source_file + " -o " + output_file + " 2>&1";
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/base_frequency", cpu);
+        state.base_khz = parseLeadingNumber(readSmallFile(path, buffer, sizeof(buffer)));
 
-    auto start_time = high_resolution_clock::now();
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/thermal_throttle/core_throttle_count", cpu);
+        state.throttle_count = parseLeadingNumber(readSmallFile(path, buffer, sizeof(buffer)));
 
-    FILE *pipe = popen(compile_cmd.c_str(), "r");
-    if (!pipe)
-    {
-        result.error_message = "Failed to create compilation process";
-        return result;
+        state.boost = readBoost();
+        return state;
     }
 
-    char buffer[128];
-    string compile_output;
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+    /**
+     * @brief 把核心的调频策略固定为performance
+     * @return bool 写入成功、已经是performance或核心没有cpufreq时返回true
+     */
+    static bool pinPerformance(int cpu)
     {
-        compile_output += buffer;
-    }
-
-    int compile_result = pclose(pipe);
-    auto end_time = high_resolution_clock::now();
+        char path[128];
+        char buffer[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+        string_view governor = readSmallFile(path, buffer, sizeof(buffer));
+        if (governor.data() == nullptr || governor == "performance")
+            return true;
 
-    result.time_used = duration_cast<milliseconds>(end_time - start_time).count();
+        int fd = open(path, O_WRONLY | O_CLOEXEC);
+        if (fd == -1)
+            return false;
+        bool ok = write(fd, "performance", 11) == 11;
+        close(fd);
+        return ok;
+    }
 
-    if (compile_result != 0)
+    /**
+     * @brief 只读取核心的当前频率，供运行期间逐节拍采样
+     * @return long long scaling_cur_freq(kHz)，没有cpufreq时返回-1
+     */
+    static long long currentKhz(int cpu)
     {
-        result.error_message = compile_output;
-        result.status = "CE";
-        return result;
+        char path[128];
+        char buffer[32];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+        return parseLeadingNumber(readSmallFile(path, buffer, sizeof(buffer)));
     }
 
-    // 检查编译是否超时
-    if (result.time_used > limits.compile_timeout)
+    /**
+     * @brief 判定用的参考频率：base_frequency，没有时取scaling_max_freq
+     */
+    static long long referenceKhz(const CpuFreqState &state)
     {
-        result.status = "CE";
-        result.error_message = "Compilation timeout";
-        return result;
+        return state.base_khz > 0 ? state.base_khz : state.limit_khz;
     }
 
-    result.status = "OK";
-    return result;
-}
-
-JudgeResult runProgram(const string &executable, const string &input_file, const Limits &limits)
-{
-    JudgeResult result;
-    result.status = "RE";
-    result.time_used = 0;
-    result.mem_used = 0;
-    result.exit_code = -1;
-    result.output_len = 0;
-    result.allocated_cpu = "";
-
-    // 创建cgroup
-    CgroupManager cgroup;
-    if (!cgroup.create())
+    /**
+     * @brief 判断核心的策略上限是否被压低到标称频率以下(温控守护进程、功耗封顶等)
+     * @param state 调频状态快照
+     * @param min_percent scaling_max_freq低于base_frequency的该百分比视为降频
+     * @note 与当前频率无关，空闲核心不会因此被拒绝；没有base_frequency时无法判定
+     */
+    static bool isCapped(const CpuFreqState &state, int min_percent)
     {
-        result.error_message = "Failed to create cgroup (需要root权限)";
-        return result;
+        if (state.limit_khz <= 0 || state.base_khz <= 0)
+            return false;
+        return state.limit_khz * 100 < state.base_khz * min_percent;
     }
 
-    // 设置内存限制
-    if (!cgroup.setMemoryLimit(limits.memory_limit))
+    /**
+     * @brief 判断负载下采样到的频率是否低于参考频率
+     * @param loaded_khz 程序占用CPU期间采样到的最低频率
+     * @param state 运行前的调频状态快照(提供参考频率)
+     * @param min_percent 低于参考频率的该百分比视为降频
+     */
+    static bool isSlow(long long loaded_khz, const CpuFreqState &state, int min_percent)
     {
-        result.error_message = "Failed to set memory limit in cgroup";
-        return result;
+        long long reference = referenceKhz(state);
+        if (loaded_khz <= 0 || reference <= 0)
+            return false;
+        return loaded_khz * 100 < reference * min_percent;
     }
 
-    // 设置CPU限制为单核心
-    if (!cgroup.setCpuLimit())
+    /**
+     * @brief 启动检查：按配置固定全部评测核心的调频策略，并报告异常核心
+     *
+     * 检查结果输出到stderr，不影响stdout中的JSON结果
+     */
+    static void checkAtStartup(const Limits &limits)
     {
-        result.error_message = "Failed to set CPU limit in cgroup";
-        return result;
-    }
+        if (limits.cpufreq_guard == 0 && limits.cpufreq_pin == 0)
+            return;
 
-    // 获取分配的CPU核心信息
-    result.allocated_cpu = cgroup.getAllocatedCpu();
+        for (int cpu : CpuLease::allowedCpus())
+        {
+            if (limits.cpufreq_pin == 1 && !pinPerformance(cpu))
+                cerr << "cpufreq: failed to pin governor of cpu " << cpu << " to performance" << endl;
+            if (limits.cpufreq_guard == 0)
+                continue;
 
-    // 创建管道用于获取输出
-    int stdout_pipe[2];
-    int stderr_pipe[2];
+            CpuFreqState state = read(cpu);
+            if (state.governor[0] != '\0' && strcmp(state.governor, "performance") != 0)
+                cerr << "cpufreq: cpu " << cpu << " uses governor " << state.governor << endl;
+            if (isCapped(state, limits.cpufreq_min_percent))
+                cerr << "cpufreq: cpu " << cpu << " is capped (" << state.limit_khz << "/" << state.base_khz << " kHz)" << endl;
+        }
+    }
 
-    if (pipe(stdout_pipe) == -1 || pipe(stderr_pipe) == -1)
+private:
+    static int readBoost()
     {
-        result.error_message = "Failed to create pipes";
-        return result;
+        char buffer[16];
+        long long boost = parseLeadingNumber(readSmallFile("/sys/devices/system/cpu/cpufreq/boost", buffer, sizeof(buffer)));
+        if (boost >= 0)
+            return boost != 0 ? 1 : 0;
+
+        long long no_turbo = parseLeadingNumber(readSmallFile("/sys/devices/system/cpu/intel_pstate/no_turbo", buffer, sizeof(buffer)));
+        if (no_turbo >= 0)
+            return no_turbo != 0 ? 0 : 1;
+        return -1;
     }
+};
 
-    auto start_time = high_resolution_clock::now();
+/**
+ * @class CgroupManager
+ * @brief cgroup v2管理器类
+ *
+ * 封装cgroup v2的创建、配置、监控和清理操作
+ * 提供面向对象的cgroup管理接口，确保资源正确释放
+ *
+ * 主要功能：
+ * - 创建和删除cgroup
+ * - 设置内存限制
+ * - 添加进程到cgroup
+ * - 监控内存使用情况
+ * - 自动资源清理
+ */
+class CgroupManager
+{
+private:
+    pmr::string cgroup_path; ///< cgroup在文件系统中的完整路径(位于任务arena)
+    pmr::string cgroup_name; ///< cgroup名称（唯一标识符）
+    bool created;            ///< cgroup是否已成功创建
+    CpuLease cpu_lease;      ///< 当前cgroup独占的CPU核心租约
+
+    /**
+     * @brief 拼接cgroup内控制文件的完整路径
+     * @param path 输出缓冲区
+     * @param file 控制文件名
+     */
+    template <size_t N>
+    const char *controlPath(char (&path)[N], const char *file) const
+    {
+        snprintf(path, N, "%s/%s", cgroup_path.c_str(), file);
+        return path;
+    }
+
+    /**
+     * @brief 读取cgroup控制文件中的整数值
+     * @return long long 读取到的值，失败返回-1
+     */
+    long long readControlNumber(const char *file) const
+    {
+        if (!created)
+            return -1;
+
+        char path[PATH_MAX];
+        char buffer[64];
+        string_view text = readSmallFile(controlPath(path, file), buffer, sizeof(buffer));
+        return parseLeadingNumber(text);
+    }
+
+public:
+    /**
+     * @brief 构造函数
+     *
+     * 生成随机的cgroup名称，避免多个评测进程之间的冲突
+     * cgroup路径格式：/sys/fs/cgroup/judge_XXXXXX
+     */
+    CgroupManager() : cgroup_path(&JobArena::current()), cgroup_name(&JobArena::current()), created(false)
+    {
+        // 生成随机的cgroup名称，确保唯一性
+        random_device rd;
+        mt19937 gen(rd());
+        uniform_int_distribution<> dis(100000, 999999);
+        cgroup_name.append("judge_").append(JobArena::current().number(dis(gen)));
+        cgroup_path.append("/sys/fs/cgroup/").append(cgroup_name);
+    }
+
+    /**
+     * @brief 析构函数
+     *
+     * 自动清理cgroup资源，防止资源泄漏
+     * 使用RAII模式确保异常安全
+     */
+    ~CgroupManager()
+    {
+        cleanup();
+    }
+
+    /**
+     * @brief 创建cgroup
+     * @return bool 创建成功返回true，失败返回false
+     *
+     * 在/sys/fs/cgroup下创建新的cgroup目录
+     * 需要root权限才能成功执行
+     *
+     * @note 创建失败通常是由于权限不足或cgroup v2未启用
+     */
+    bool create()
+    {
+        // 创建cgroup目录，权限设置为755
+        if (mkdir(cgroup_path.c_str(), 0755) != 0)
+        {
+            return false;
+        }
+        created = true;
+        return true;
+    }
+
+    /**
+     * @brief 设置内存限制
+     * @param limit_bytes 内存限制值(字节)
+     * @return bool 设置成功返回true，失败返回false
+     *
+     * 向memory.max文件写入内存限制值
+     * 超过此限制的进程将被内核杀死(SIGKILL)
+     *
+     * @warning limit_bytes必须是正数，过小的值可能导致进程无法启动
+     */
+    bool setMemoryLimit(long long limit_bytes)
+    {
+        if (!created)
+            return false;
+
+        char path[PATH_MAX];
+        return writeSmallFile(controlPath(path, "memory.max"), JobArena::current().number(limit_bytes));
+    }
+
+    /**
+     * @brief 设置cgroup内进程和线程的总数上限
+     * @param max_processes 写入pids.max的值
+     * @return bool 设置成功返回true，失败返回false
+     *
+     * 评测进程以root运行，子进程的RLIMIT_NPROC对root不生效，
+     * 只有pids控制器能真正限制选手程序和checker的fork
+     */
+    bool setProcessLimit(int max_processes)
+    {
+        if (!created)
+            return false;
+
+        writeSmallFile("/sys/fs/cgroup/cgroup.subtree_control", "+pids");
+        char path[PATH_MAX];
+        char value[16];
+        snprintf(value, sizeof(value), "%d", max_processes);
+        return writeSmallFile(controlPath(path, "pids.max"), value);
+    }
+
+    /**
+     * @brief 设置CPU限制 - 严格固定在单个CPU核心
+     * @return bool 设置成功返回true，失败返回false
+     *
+     * 为待测程序分配一个固定的CPU核心，确保整个运行期间严格在该核心上执行
+     * 禁止进程在不同CPU核心之间迁移，提供完全一致的执行环境
+     *
+     * @details cpuset.cpus控制进程可以使用的CPU核心
+     *          - 选择一个可用的CPU核心并严格固定
+     *          - 设置CPU亲和性确保不会迁移
+     *          - 保证所有程序获得相同的单核心执行条件
+     *
+     * @note 严格单核心执行确保评测的绝对公平性
+     */
+    bool setCpuLimit(const Limits &limits, bool memory_heavy = false)
+    {
+        if (!created)
+            return false;
+
+        // 首先确保在根cgroup中启用cpuset控制器
+        writeSmallFile("/sys/fs/cgroup/cgroup.subtree_control", "+cpuset");
+
+        // 选择一个CPU核心进行严格绑定
+        int selected_cpu = selectCpuForBinding(limits, memory_heavy);
+        if (selected_cpu < 0)
+        {
+            return false;
+        }
+
+        // 设置cpuset.cpus - 严格限制在选定的单个CPU核心
+        char path[PATH_MAX];
+        if (!writeSmallFile(controlPath(path, "cpuset.cpus"), JobArena::current().number(selected_cpu)))
+        {
+            return false;
+        }
+
+        // 设置cpuset.mems - 继承内存节点设置
+        char mems_buffer[128];
+        string_view available_mems = readSmallFile("/sys/fs/cgroup/cpuset.mems.effective", mems_buffer, sizeof(mems_buffer));
+        if (available_mems.empty())
+        {
+            available_mems = "0";
+        }
+
+        return writeSmallFile(controlPath(path, "cpuset.mems"), available_mems);
+    }
+
+    /**
+     * @brief 强制CPU绑定到指定核心
+     * @param pid 进程ID
+     * @param cpu_id CPU核心ID
+     * @return bool 绑定成功返回true，失败返回false
+     *
+     * 使用sched_setaffinity直接设置进程的CPU亲和性
+     * 这是对cgroup cpuset的补充，确保更严格的CPU绑定
+     */
+    bool forceCpuBinding(pid_t pid, int cpu_id)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu_id, &cpu_set);
+
+        if (sched_setaffinity(pid, sizeof(cpu_set), &cpu_set) == 0)
+        {
+            return true;
+        }
+        return false;
+    }
+
+private:
+    /**
+     * @brief 选择CPU核心进行严格绑定
+     * @return int 选定的CPU核心编号，失败返回-1
+     *
+     * 通过CpuLease租用一个空闲核心，确保多个评测(跨进程、跨线程)分散到不同核心
+     * 且每个核心同一时刻只被一次运行独占
+     *
+     * @details 选择策略：
+     *          1. 使用cgroup名称和时间戳的哈希作为起始位置
+     *          2. 从起始位置开始在可用核心中寻找未被租用的核心
+     *          3. 全部被占用时等待起始位置的核心释放
+     *          4. cpufreq_guard=2时跳过策略上限被压低的核心
+     *          5. cpufreq_pin=1时把租到的核心固定为performance调频策略
+     *          6. 内存密集的运行优先选择没有其他内存密集运行的LLC域
+     *          7. 租约随cgroup清理一起释放
+     */
+    int selectCpuForBinding(const Limits &limits, bool memory_heavy)
+    {
+        // 使用时间戳进行轮询，确保不同时间启动的进程分散到不同核心
+        auto now = chrono::high_resolution_clock::now();
+        auto timestamp = now.time_since_epoch().count();
+
+        // 基于cgroup名称和时间戳计算，增加随机性
+        size_t hash_value = std::hash<string_view>{}(cgroup_name) ^ timestamp;
+
+        function<bool(int)> acceptable;
+        if (limits.cpufreq_guard == 2)
+        {
+            int min_percent = limits.cpufreq_min_percent;
+            acceptable = [min_percent](int cpu)
+            { return !CpuFreqGuard::isCapped(CpuFreqGuard::read(cpu), min_percent); };
+        }
+
+        if (!cpu_lease.acquire(hash_value, acceptable, memory_heavy))
+        {
+            return -1;
+        }
+
+        if (limits.cpufreq_pin == 1)
+        {
+            CpuFreqGuard::pinPerformance(cpu_lease.cpu());
+        }
+
+        return cpu_lease.cpu();
+    }
+
+public:
+    /**
+     * @brief 将进程添加到cgroup
+     * @param pid 要添加的进程ID
+     * @return bool 添加成功返回true，失败返回false
+     *
+     * 向cgroup.procs文件写入进程ID，使该进程受cgroup限制
+     * 进程的所有子进程也会自动受到相同限制
+     *
+     * @note 进程必须存在且调用者有权限操作该进程
+     */
+    bool addProcess(pid_t pid)
+    {
+        if (!created)
+            return false;
+
+        char path[PATH_MAX];
+        return writeSmallFile(controlPath(path, "cgroup.procs"), JobArena::current().number(pid));
+    }
+
+    /**
+     * @brief 获取cgroup.procs的完整路径
+     * @param path 输出缓冲区
+     *
+     * 子进程在fork之后、exec之前向该文件写入"0"即可把自己移入cgroup，
+     * 不需要父进程在子进程开始执行前完成addProcess
+     */
+    template <size_t N>
+    const char *procsPath(char (&path)[N]) const
+    {
+        return controlPath(path, "cgroup.procs");
+    }
+
+    /**
+     * @brief 获取峰值内存使用量
+     * @return long long 峰值内存使用量(字节)，失败返回-1
+     *
+     * 从memory.peak文件读取进程运行期间的峰值内存使用量
+     * 这是cgroup v2提供的高精度内存监控特性
+     *
+     * @details memory.peak记录cgroup中所有进程的峰值物理内存使用
+     *          包括程序本身、动态分配的内存、共享库等
+     *          比传统的rusage.ru_maxrss更准确、更完整
+     *
+     * @note 只有在进程执行完毕后读取才有意义
+     */
+    long long getMemoryPeak()
+    {
+        return readControlNumber("memory.peak");
+    }
+
+    /**
+     * @brief 获取当前内存使用量
+     * @return long long 当前内存使用量(字节)，失败返回-1
+     *
+     * 从memory.current文件读取当前实时内存使用量
+     * 主要用于调试和实时监控
+     *
+     * @note 此值会实时变化，通常用于监控而非最终统计
+     */
+    long long getCurrentMemory()
+    {
+        return readControlNumber("memory.current");
+    }
+
+    /**
+     * @brief 打开memory.peak并重置峰值统计
+     * @return int 描述符，失败(含内核不支持按描述符重置，6.12之前)返回-1
+     *
+     * 重置只对该描述符生效：之后经它读到的是重置以来的峰值，池化cgroup据此跨运行复用
+     */
+    int openMemoryPeak() const
+    {
+        if (!created)
+            return -1;
+
+        char path[PATH_MAX];
+        int fd = open(controlPath(path, "memory.peak"), O_RDWR | O_CLOEXEC);
+        if (fd != -1 && pwrite(fd, "reset\n", 6, 0) != 6)
+        {
+            close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    /**
+     * @brief 获取cgroup内全部进程累计的CPU时间
+     * @return long long cpu.stat中的usage_usec(微秒)，失败返回-1
+     *
+     * 运行期间由监督循环周期读取，用于判断程序是否在空等
+     */
+    long long getCpuUsageUs() const
+    {
+        return getCpuStat("usage_usec");
+    }
+
+    /**
+     * @brief 读取cpu.stat中的一项计数
+     * @param key 字段名，如usage_usec、nr_throttled、throttled_usec
+     * @return long long 字段值，cgroup未创建或字段不存在时返回-1
+     *
+     * 未启用cpu控制器时cpu.stat只有usage/user/system三项，节流相关字段读不到
+     */
+    long long getCpuStat(string_view key) const
+    {
+        if (!created)
+            return -1;
+
+        char path[PATH_MAX];
+        char buffer[512];
+        string_view text = readSmallFile(controlPath(path, "cpu.stat"), buffer, sizeof(buffer));
+        while (!text.empty())
+        {
+            size_t line_end = text.find('\n');
+            string_view line = text.substr(0, line_end);
+            if (line.size() > key.size() && line.starts_with(key) && line[key.size()] == ' ')
+                return parseLeadingNumber(line.substr(key.size() + 1));
+            if (line_end == string_view::npos)
+                break;
+            text.remove_prefix(line_end + 1);
+        }
+        return -1;
+    }
+
+    /**
+     * @brief 杀死cgroup中的全部进程并等待cgroup变空
+     * @param timeout_ms 等待cgroup.events变为"populated 0"的最长时间(毫秒)
+     * @return bool cgroup已空或无法判断(没有cgroup.events)返回true，超时返回false
+     *
+     * 回收主进程并不会清空cgroup：程序fork出的后代进程仍留在其中，会计入下一次
+     * 运行的memory.peak和cpu.stat，并继续占用租用的核心
+     * 优先写cgroup.kill(5.14+)；不支持时逐个SIGKILL cgroup.procs中列出的进程
+     */
+    bool killAll(int timeout_ms = 1000) const
+    {
+        if (!created)
+            return true;
+
+        char path[PATH_MAX];
+        int events_fd = open(controlPath(path, "cgroup.events"), O_RDONLY | O_CLOEXEC);
+        if (events_fd == -1)
+            return true;
+
+        bool kill_file = writeSmallFile(controlPath(path, "cgroup.kill"), "1");
+        auto deadline = high_resolution_clock::now() + milliseconds(timeout_ms);
+        bool empty = false;
+        while (true)
+        {
+            char events[256];
+            ssize_t n = pread(events_fd, events, sizeof(events) - 1, 0);
+            if (n < 0)
+                break;
+            events[n] = '\0';
+            const char *populated = strstr(events, "populated ");
+            if (populated == nullptr || populated[10] == '0')
+            {
+                empty = true;
+                break;
+            }
+
+            if (!kill_file)
+            {
+                char procs[4096];
+                string_view pids = readSmallFile(controlPath(path, "cgroup.procs"), procs, sizeof(procs));
+                while (!pids.empty())
+                {
+                    long long pid = parseLeadingNumber(pids);
+                    if (pid > 0)
+                        kill(static_cast<pid_t>(pid), SIGKILL);
+                    size_t line_end = pids.find('\n');
+                    pids = line_end == string_view::npos ? string_view() : pids.substr(line_end + 1);
+                }
+            }
+
+            // cgroup.events变化时内核以POLLPRI通知
+            long long remaining_ms = duration_cast<milliseconds>(deadline - high_resolution_clock::now()).count();
+            if (remaining_ms <= 0)
+                break;
+            struct pollfd waiter = {events_fd, POLLPRI, 0};
+            poll(&waiter, 1, static_cast<int>(min(remaining_ms, 20LL)));
+        }
+        close(events_fd);
+        return empty;
+    }
+
+    /**
+     * @brief 清理cgroup资源
+     *
+     * 杀死cgroup中残留的进程并等待其变空，再删除cgroup目录、归还核心租约
+     * 在析构函数中自动调用，也可手动调用
+     *
+     * @note 回收主进程不会清空cgroup：不先杀死后代进程时rmdir会因EBUSY失败，
+     *       后代进程还会继续在归还的核心上运行，与下一次计时运行共用该核心
+     *       无法清空或删除时输出到stderr
+     */
+    void cleanup()
+    {
+        if (created)
+        {
+            if (!killAll())
+                cerr << "Cgroup " << cgroup_name << " still populated after cgroup.kill" << endl;
+            if (rmdir(cgroup_path.c_str()) != 0)
+                cerr << "Failed to remove cgroup " << cgroup_path << ": " << strerror(errno) << endl;
+            created = false;
+        }
+        cpu_lease.release();
+    }
+
+    /**
+     * @brief 只释放CPU核心租约，保留cgroup目录
+     *
+     * 用于CgroupPool回收cgroup：空闲的cgroup不占用核心，下次签出时重新租用
+     */
+    void releaseCpu()
+    {
+        cpu_lease.release();
+    }
+
+    /**
+     * @brief 获取租用的CPU核心编号
+     * @return int 核心编号，未租用返回-1
+     */
+    int getLeasedCpu() const
+    {
+        return cpu_lease.cpu();
+    }
+
+    /**
+     * @brief 获取cgroup ID(cgroup v2目录的inode号，即bpf_get_current_cgroup_id的返回值)
+     * @return uint64_t 失败返回0
+     */
+    uint64_t getCgroupId() const
+    {
+        struct stat st;
+        if (!created || stat(cgroup_path.c_str(), &st) != 0)
+            return 0;
+        return static_cast<uint64_t>(st.st_ino);
+    }
+
+    /**
+     * @brief 租用核心时同一LLC域中是否已有其他内存密集的运行
+     */
+    bool hasHeavyNeighbor() const
+    {
+        return cpu_lease.hasHeavyNeighbor();
+    }
+
+    /**
+     * @brief 获取cgroup名称
+     * @return string_view cgroup名称
+     *
+     * 返回此cgroup的唯一名称，用于调试和日志记录
+     */
+    string_view getName() const
+    {
+        return cgroup_name;
+    }
+
+    /**
+     * @brief 获取分配的CPU核心编号
+     * @return string_view 当前分配的CPU核心编号(位于任务arena)，失败返回空视图
+     *
+     * 读取当前cgroup分配的CPU核心信息
+     * 用于调试和验证CPU分配是否正确
+     */
+    string_view getAllocatedCpu() const
+    {
+        if (!created)
+            return "";
+
+        char path[PATH_MAX];
+        char buffer[64];
+        string_view allocated_cpu = readSmallFile(controlPath(path, "cpuset.cpus"), buffer, sizeof(buffer));
+        return JobArena::current().store(allocated_cpu);
+    }
+};
+
+/**
+ * @class CgroupPool
+ * @brief 可复用的cgroup池
+ *
+ * checker等辅助程序每次运行都要mkdir/rmdir一个cgroup并写入控制文件，
+ * 一个评测进程中检查多个测试点时这部分开销会重复出现
+ * 池中保留最多MAX_IDLE个已创建的空闲cgroup，签出时重新设置内存、进程数限制并租用核心，
+ * 归还时杀死残留进程并释放核心租约，cgroup目录留待下次使用
+ *
+ * @details 生命周期：
+ *          - 池为进程级单例，cgroup路径分配在池自己的arena中，不受任务arena reset影响
+ *          - 进程退出时析构，删除全部空闲cgroup
+ *          - 超过MAX_IDLE的cgroup在归还时直接删除
+ */
+class CgroupPool
+{
+public:
+    static constexpr size_t MAX_IDLE = 8; ///< 最多保留的空闲cgroup数
+
+    /**
+     * @class Lease
+     * @brief 签出的cgroup，析构时自动归还
+     */
+    class Lease
+    {
+    private:
+        CgroupPool *pool = nullptr;        ///< 所属的池
+        unique_ptr<CgroupManager> cgroup;  ///< 签出的cgroup
+
+    public:
+        Lease() = default;
+        Lease(CgroupPool *owner, unique_ptr<CgroupManager> managed) : pool(owner), cgroup(std::move(managed)) {}
+        Lease(Lease &&) = default;
+        Lease &operator=(Lease &&) = delete;
+
+        ~Lease()
+        {
+            if (cgroup != nullptr)
+                pool->release(std::move(cgroup));
+        }
+
+        explicit operator bool() const { return cgroup != nullptr; }
+        CgroupManager &operator*() const { return *cgroup; }
+        CgroupManager *operator->() const { return cgroup.get(); }
+    };
+
+    /**
+     * @brief 获取进程级的池实例
+     */
+    static CgroupPool &instance()
+    {
+        static CgroupPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief 签出一个已设置好内存限制并租用了核心的cgroup
+     * @param limits 资源限制
+     * @param bind_cpu 为false时不租用核心，由使用者在运行前调用setCpuLimit
+     * @return Lease 失败时为空
+     */
+    Lease acquire(const Limits &limits, bool bind_cpu = true)
+    {
+        unique_ptr<CgroupManager> cgroup;
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            if (!idle.empty())
+            {
+                cgroup = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+
+        if (cgroup == nullptr)
+        {
+            JobArena::Scope scope(arena);
+            cgroup = make_unique<CgroupManager>();
+            if (!cgroup->create())
+                return Lease();
+        }
+
+        if (!cgroup->setMemoryLimit(limits.memory_limit) || !cgroup->setProcessLimit(limits.process_limit) ||
+            (bind_cpu && !cgroup->setCpuLimit(limits)))
+        {
+            cgroup->releaseCpu();
+            return Lease();
+        }
+        return Lease(this, std::move(cgroup));
+    }
+
+    CgroupPool(const CgroupPool &) = delete;
+    CgroupPool &operator=(const CgroupPool &) = delete;
+
+private:
+    CgroupPool() = default;
+
+    JobArena arena;                          ///< cgroup路径所在的arena，必须先于idle构造
+    mutex pool_mutex;                        ///< 保护idle
+    vector<unique_ptr<CgroupManager>> idle;  ///< 空闲的cgroup
+
+    void release(unique_ptr<CgroupManager> cgroup)
+    {
+        // 残留的后代进程会计入下一个使用者的统计，清空后才能复用
+        bool empty = cgroup->killAll();
+        cgroup->releaseCpu();
+        if (!empty)
+        {
+            cerr << "Cgroup " << cgroup->getName() << " still populated after cgroup.kill, not reused" << endl;
+            return;
+        }
+        lock_guard<mutex> lock(pool_mutex);
+        if (idle.size() < MAX_IDLE)
+            idle.push_back(std::move(cgroup));
+    }
+};
+
+/**
+ * @class CaptureBufferPool
+ * @brief 输出捕获缓冲区池
+ *
+ * 为stdout/stderr捕获提供可复用的大块缓冲区，避免每次运行都通过
+ * string追加反复扩容，减少并发评测时的堆碎片和缺页中断
+ *
+ * @details 缓冲区按固定的规格(slab size class)管理：
+ *          - 每个规格维护一个空闲链表，归还的缓冲区留在池中复用
+ *          - 缓冲区直接通过mmap申请，不经过malloc
+ *          - 不超过PREFAULT_MAX的缓冲区在创建时逐页预写入(pre-fault)
+ *          - 不小于2MB的缓冲区通过MADV_HUGEPAGE请求透明大页
+ *          - 每个规格最多保留MAX_RETAINED个缓冲区，保证驻留内存有上界
+ *          - 超过PREFAULT_MAX的规格归还时以MADV_DONTNEED交还物理页，只保留地址空间，
+ *            一次大输出不会让评测进程在之后的测试点中一直占着数百MB
+ *
+ * @note 稳态下(各规格均已有空闲缓冲区)签出和归还都不会分配内存
+ */
+class CaptureBufferPool
+{
+public:
+    static constexpr size_t CLASS_COUNT = 4;                  ///< 规格数量
+    static constexpr size_t CLASS_SIZES[CLASS_COUNT] = {
+        64UL << 10, 1UL << 20, 16UL << 20, 256UL << 20};     ///< 各规格大小(字节)
+    static constexpr size_t PREFAULT_MAX = 16UL << 20;        ///< 创建时预写入的最大规格
+    static constexpr size_t HUGEPAGE_MIN = 2UL << 20;         ///< 请求大页的最小规格
+    static constexpr size_t MAX_RETAINED = 4;                 ///< 每个规格最多保留的空闲缓冲区数
+
+    /**
+     * @brief 获取进程内唯一的缓冲区池
+     * @return CaptureBufferPool& 缓冲区池引用
+     */
+    static CaptureBufferPool &instance()
+    {
+        static CaptureBufferPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief 签出一个至少min_size字节的缓冲区
+     * @param min_size 需要的最小容量(字节)
+     * @param capacity 输出参数，实际容量(字节)
+     * @return char* 缓冲区地址，失败返回nullptr
+     *
+     * 超过最大规格的请求按页对齐单独映射，归还时直接释放不入池
+     */
+    char *acquire(size_t min_size, size_t &capacity)
+    {
+        size_t cls = classFor(min_size);
+        if (cls == CLASS_COUNT)
+        {
+            capacity = (min_size + 4095) & ~static_cast<size_t>(4095);
+            return mapSlab(capacity);
+        }
+
+        capacity = CLASS_SIZES[cls];
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            if (!free_slabs[cls].empty())
+            {
+                char *slab = free_slabs[cls].back();
+                free_slabs[cls].pop_back();
+                return slab;
+            }
+        }
+        return mapSlab(capacity);
+    }
+
+    /**
+     * @brief 归还缓冲区
+     * @param slab 缓冲区地址
+     * @param capacity 签出时得到的容量
+     *
+     * 空闲链表已满或非标准规格的缓冲区直接munmap；未预写入的大规格缓冲区入池前交还物理页
+     */
+    void release(char *slab, size_t capacity)
+    {
+        if (slab == nullptr)
+            return;
+
+        size_t cls = classFor(capacity);
+        if (cls != CLASS_COUNT && CLASS_SIZES[cls] == capacity)
+        {
+            if (capacity > PREFAULT_MAX)
+                madvise(slab, capacity, MADV_DONTNEED);
+            lock_guard<mutex> lock(pool_mutex);
+            if (free_slabs[cls].size() < MAX_RETAINED)
+            {
+                free_slabs[cls].push_back(slab);
+                return;
+            }
+        }
+        munmap(slab, capacity);
+    }
+
+    CaptureBufferPool(const CaptureBufferPool &) = delete;
+    CaptureBufferPool &operator=(const CaptureBufferPool &) = delete;
+
+private:
+    mutex pool_mutex;                              ///< 保护空闲链表
+    array<vector<char *>, CLASS_COUNT> free_slabs; ///< 各规格的空闲缓冲区
+
+    CaptureBufferPool()
+    {
+        // 预留空闲链表容量，保证归还时push_back不会触发分配
+        for (auto &list : free_slabs)
+            list.reserve(MAX_RETAINED);
+    }
+
+    ~CaptureBufferPool()
+    {
+        for (size_t cls = 0; cls < CLASS_COUNT; cls++)
+            for (char *slab : free_slabs[cls])
+                munmap(slab, CLASS_SIZES[cls]);
+    }
+
+    /**
+     * @brief 计算能容纳size字节的最小规格
+     * @return size_t 规格下标，超过最大规格时返回CLASS_COUNT
+     */
+    static size_t classFor(size_t size)
+    {
+        for (size_t cls = 0; cls < CLASS_COUNT; cls++)
+            if (size <= CLASS_SIZES[cls])
+                return cls;
+        return CLASS_COUNT;
+    }
+
+    /**
+     * @brief 映射一块新的缓冲区
+     *
+     * 大块缓冲区先请求透明大页再预写入，使缺页发生在签出时而非捕获输出时
+     */
+    static char *mapSlab(size_t size)
+    {
+        void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED)
+            return nullptr;
+
+        if (size >= HUGEPAGE_MIN)
+            madvise(addr, size, MADV_HUGEPAGE);
+
+        if (size <= PREFAULT_MAX)
+        {
+            volatile char *page = static_cast<char *>(addr);
+            for (size_t offset = 0; offset < size; offset += 4096)
+                page[offset] = 0;
+        }
+        return static_cast<char *>(addr);
+    }
+};
+
+/**
+ * @class CaptureBuffer
+ * @brief 单次运行的输出捕获缓冲区
+ *
+ * 从CaptureBufferPool签出缓冲区并直接从管道read到缓冲区尾部
+ * 容量不足时升级到下一规格，超过保留上限的输出只计数不保存
+ * 析构时自动归还缓冲区(RAII)
+ */
+class CaptureBuffer
+{
+private:
+    char *data_ptr = nullptr; ///< 当前缓冲区
+    size_t capacity = 0;      ///< 当前缓冲区容量
+    size_t length = 0;        ///< 已保存的字节数
+    size_t total = 0;         ///< 读到的总字节数(含丢弃部分)
+    size_t max_keep;          ///< 最多保存的字节数
+
+public:
+    /**
+     * @brief 构造函数
+     * @param keep_limit 最多保存的字节数，超出部分只计入总长度
+     */
+    explicit CaptureBuffer(size_t keep_limit) : max_keep(keep_limit) {}
+
+    ~CaptureBuffer()
+    {
+        CaptureBufferPool::instance().release(data_ptr, capacity);
+    }
+
+    CaptureBuffer(const CaptureBuffer &) = delete;
+    CaptureBuffer &operator=(const CaptureBuffer &) = delete;
+
+    /**
+     * @brief 从文件描述符读取一次数据
+     * @param fd 管道读端
+     * @return ssize_t read的返回值(0表示EOF，-1表示错误)
+     */
+    ssize_t readFrom(int fd)
+    {
+        if (length >= max_keep)
+        {
+            // 已达保留上限，读入丢弃区只统计长度
+            static thread_local char discard[4096];
+            ssize_t bytes_read = read(fd, discard, sizeof(discard));
+            if (bytes_read > 0)
+                total += bytes_read;
+            return bytes_read;
+        }
+
+        if (length == capacity && !grow())
+            return -1;
+
+        size_t room = min(capacity, max_keep) - length;
+        ssize_t bytes_read = read(fd, data_ptr + length, room);
+        if (bytes_read > 0)
+        {
+            length += bytes_read;
+            total += bytes_read;
+        }
+        return bytes_read;
+    }
+
+    const char *data() const { return data_ptr; }
+    size_t size() const { return length; }
+    size_t totalBytes() const { return total; }
+
+    /**
+     * @brief 已保存内容的视图，仅在缓冲区归还前有效
+     */
+    string_view view() const
+    {
+        return string_view(data_ptr, length);
+    }
+
+private:
+    /**
+     * @brief 升级到下一规格的缓冲区并迁移已有内容
+     */
+    bool grow()
+    {
+        size_t new_capacity;
+        char *new_data = CaptureBufferPool::instance().acquire(min(capacity + 1, max_keep), new_capacity);
+        if (new_data == nullptr)
+            return false;
+
+        if (length > 0)
+            memcpy(new_data, data_ptr, length);
+        CaptureBufferPool::instance().release(data_ptr, capacity);
+        data_ptr = new_data;
+        capacity = new_capacity;
+        return true;
+    }
+};
+
+/**
+ * @brief 解析JSON数字值
+ * @param json JSON字符串
+ * @param key 要解析的键名
+ * @return long long 解析得到的数值，失败返回-1
+ *
+ * 简单的JSON解析器，只支持数字类型
+ * 避免引入外部JSON库依赖，减少系统复杂性
+ *
+ * @details 解析过程：
+ *          1. 查找键名位置
+ *          2. 查找冒号分隔符
+ *          3. 跳过空白字符
+ *          4. 解析数字字符
+ *
+ * @note 此实现仅支持正整数，不支持负数、浮点数或科学计数法
+ * @warning 输入的JSON格式必须正确，否则可能返回错误结果
+ */
+long long parseJsonNumber(string_view json, string_view key)
+{
+    // 查找键名在JSON字符串中的位置(必须被引号包围)
+    size_t pos = json.find(key);
+    while (pos != string_view::npos &&
+           !(pos > 0 && json[pos - 1] == '"' && pos + key.size() < json.length() && json[pos + key.size()] == '"'))
+    {
+        pos = json.find(key, pos + 1);
+    }
+    if (pos == string_view::npos)
+        return -1;
+
+    // 查找冒号分隔符
+    pos = json.find(':', pos);
+    if (pos == string_view::npos)
+        return -1;
+
+    // 跳过冒号后的空白字符
+    pos++;
+    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t'))
+        pos++;
+
+    // 解析数字字符，累积计算数值
+    long long result = 0;
+    while (pos < json.length() && json[pos] >= '0' && json[pos] <= '9')
+    {
+        result = result * 10 + (json[pos] - '0');
+        pos++;
+    }
+
+    return result;
+}
+
+/**
+ * @brief 加载资源限制配置
+ * @param limits_file 配置文件路径
+ * @return Limits 解析后的限制配置结构体
+ *
+ * 从JSON配置文件加载各种资源限制参数
+ * 支持默认值fallback，确保系统在配置文件缺失时仍能正常运行
+ *
+ * @details 配置项说明：
+ *          - time_limit: CPU时间限制(毫秒)
+ *          - memory_limit: 内存限制(KB，内部转换为字节)
+ *          - output_limit: 输出大小限制(字节)
+ *          - compile_timeout: 编译超时时间(毫秒)
+ *          - stack_limit: 栈大小限制(KB，内部转换为字节)
+ *
+ * @note 所有KB单位的配置项会自动转换为字节存储
+ * @warning 如果配置文件格式错误，将使用默认值并继续执行
+ */
+Limits loadLimits(const string &limits_file)
+{
+    Limits limits;
+    int fd = open(limits_file.c_str(), O_RDONLY | O_CLOEXEC);
+
+    // 如果文件打开失败，使用默认配置
+    if (fd == -1)
+    {
+        // 默认配置值（适合大多数竞赛题目）
+        limits.time_limit = 1000;       // 1秒
+        limits.memory_limit = 67108864; // 64MB
+        limits.output_limit = 64000000; // 64MB
+        limits.compile_timeout = 30000; // 30秒
+        limits.stack_limit = 8388608;   // 8MB
+        return limits;
+    }
+
+    // 读取整个文件内容到任务arena
+    pmr::string json(&JobArena::current());
+    char buffer[4096];
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        json.append(buffer, bytes_read);
+    }
+    close(fd);
+
+    // 解析各个配置项
+    long long time_limit = parseJsonNumber(json, "time_limit");
+    long long memory_limit = parseJsonNumber(json, "memory_limit");
+    long long output_limit = parseJsonNumber(json, "output_limit");
+    long long compile_timeout = parseJsonNumber(json, "compile_timeout");
+    long long stack_limit = parseJsonNumber(json, "stack_limit");
+
+    // 设置配置值，解析失败时使用默认值
+    limits.time_limit = (time_limit > 0) ? time_limit : 1000;
+    limits.memory_limit = (memory_limit > 0) ? memory_limit * 1024 : 67108864; // KB转字节
+    limits.output_limit = (output_limit > 0) ? output_limit : 64000000;
+    limits.compile_timeout = (compile_timeout > 0) ? compile_timeout : 30000;
+    limits.stack_limit = (stack_limit > 0) ? stack_limit * 1024 : 8388608; // KB转字节
+
+    // 可选配置：出现时覆盖默认值
+    long long rerun_band = parseJsonNumber(json, "rerun_band");
+    long long rerun_max = parseJsonNumber(json, "rerun_max");
+    long long rerun_policy = parseJsonNumber(json, "rerun_policy");
+    if (rerun_band >= 0)
+        limits.rerun_band = static_cast<int>(min(rerun_band, 100LL));
+    if (rerun_max >= 0)
+        limits.rerun_max = static_cast<int>(min(rerun_max, 20LL));
+    if (rerun_policy >= 0)
+        limits.rerun_policy = rerun_policy == 1 ? 1 : 0;
+
+    long long calibrate_runs = parseJsonNumber(json, "calibrate_runs");
+    long long calibrate_factor = parseJsonNumber(json, "calibrate_factor");
+    if (calibrate_runs > 0)
+        limits.calibrate_runs = static_cast<int>(min(calibrate_runs, 100LL));
+    if (calibrate_factor > 0)
+        limits.calibrate_factor = static_cast<int>(calibrate_factor);
+    long long calibrate_time_limit = parseJsonNumber(json, "calibrate_time_limit");
+    if (calibrate_time_limit > 0)
+        limits.calibrate_time_limit = static_cast<int>(min(calibrate_time_limit, 600000LL));
+
+    long long speed_reference = parseJsonNumber(json, "speed_reference");
+    long long normalize_time = parseJsonNumber(json, "normalize_time");
+    long long speed_refresh = parseJsonNumber(json, "speed_refresh");
+    if (speed_reference >= 0)
+        limits.speed_reference = static_cast<int>(speed_reference);
+    if (normalize_time >= 0)
+        limits.normalize_time = normalize_time == 1 ? 1 : 0;
+    if (speed_refresh > 0)
+        limits.speed_refresh = static_cast<int>(speed_refresh);
+
+    long long cpufreq_guard = parseJsonNumber(json, "cpufreq_guard");
+    long long cpufreq_pin = parseJsonNumber(json, "cpufreq_pin");
+    long long cpufreq_min_percent = parseJsonNumber(json, "cpufreq_min_percent");
+    if (cpufreq_guard >= 0)
+        limits.cpufreq_guard = static_cast<int>(min(cpufreq_guard, 2LL));
+    if (cpufreq_pin >= 0)
+        limits.cpufreq_pin = cpufreq_pin == 1 ? 1 : 0;
+    if (cpufreq_min_percent >= 0)
+        limits.cpufreq_min_percent = static_cast<int>(min(cpufreq_min_percent, 100LL));
+
+    long long profile = parseJsonNumber(json, "profile");
+    long long profile_freq = parseJsonNumber(json, "profile_freq");
+    long long profile_top = parseJsonNumber(json, "profile_top");
+    if (profile >= 0)
+        limits.profile = profile == 1 ? 1 : 0;
+    if (profile_freq > 0)
+        limits.profile_freq = static_cast<int>(min(profile_freq, 4999LL));
+    if (profile_top > 0)
+        limits.profile_top = static_cast<int>(min(profile_top, 100LL));
+
+    long long checker_time_limit = parseJsonNumber(json, "checker_time_limit");
+    if (checker_time_limit > 0)
+        limits.checker_time_limit = static_cast<int>(min(checker_time_limit, 60000LL));
+
+    long long report_phases = parseJsonNumber(json, "report_phases");
+    long long compile_cache = parseJsonNumber(json, "compile_cache");
+    if (report_phases >= 0)
+        limits.report_phases = report_phases == 1 ? 1 : 0;
+    if (compile_cache >= 0)
+        limits.compile_cache = compile_cache == 1 ? 1 : 0;
+
+    long long idle_limit = parseJsonNumber(json, "idle_limit");
+    if (idle_limit >= 0)
+        limits.idle_limit = static_cast<int>(min(idle_limit, 600000LL));
+
+    long long lookahead = parseJsonNumber(json, "lookahead");
+    if (lookahead >= 0)
+        limits.lookahead = lookahead == 1 ? 1 : 0;
+
+    long long interference_wait_us = parseJsonNumber(json, "interference_wait_us");
+    long long interference_nivcsw = parseJsonNumber(json, "interference_nivcsw");
+    long long interference_rerun = parseJsonNumber(json, "interference_rerun");
+    if (interference_wait_us >= 0)
+        limits.interference_wait_us = static_cast<int>(min(interference_wait_us, 60000000LL));
+    if (interference_nivcsw >= 0)
+        limits.interference_nivcsw = static_cast<int>(min(interference_nivcsw, 1000000LL));
+    if (interference_rerun >= 0)
+        limits.interference_rerun = interference_rerun == 1 ? 1 : 0;
+
+    long long process_limit = parseJsonNumber(json, "process_limit");
+    if (process_limit > 0)
+        limits.process_limit = static_cast<int>(min(process_limit, 4096LL));
+
+    long long generator_time_limit = parseJsonNumber(json, "generator_time_limit");
+    if (generator_time_limit > 0)
+        limits.generator_time_limit = static_cast<int>(min(generator_time_limit, 600000LL));
+
+    long long deterministic_env = parseJsonNumber(json, "deterministic_env");
+    long long disable_aslr = parseJsonNumber(json, "disable_aslr");
+    if (deterministic_env >= 0)
+        limits.deterministic_env = deterministic_env == 1 ? 1 : 0;
+    if (disable_aslr >= 0)
+        limits.disable_aslr = disable_aslr == 1 ? 1 : 0;
+
+    long long syscall_trace = parseJsonNumber(json, "syscall_trace");
+    if (syscall_trace >= 0)
+        limits.syscall_trace = syscall_trace == 1 ? 1 : 0;
+
+    long long memory_class = parseJsonNumber(json, "memory_class");
+    long long memory_heavy_mbps = parseJsonNumber(json, "memory_heavy_mbps");
+    if (memory_class >= 0)
+        limits.memory_class = static_cast<int>(min(memory_class, 2LL));
+    if (memory_heavy_mbps > 0)
+        limits.memory_heavy_mbps = static_cast<int>(min(memory_heavy_mbps, 1000000LL));
+
+    long long prefetch_binary = parseJsonNumber(json, "prefetch_binary");
+    if (prefetch_binary >= 0)
+        limits.prefetch_binary = static_cast<int>(min(prefetch_binary, 2LL));
+
+    return limits;
+}
+
+/**
+ * @brief 编译命令(不含源文件和输出路径)，也参与编译缓存的键
+ */
+constexpr string_view COMPILE_COMMAND = "g++ -g -std=c++20 -O2 -Wall -Wextra -Wshadow -Wconversion -Wfloat-equal ";
+
+JudgeResult compileProgram(const string &source_file, const string &output_file, const Limits &limits)
+{
+    JudgeResult result;
+    result.status = "CE";
+    result.time_used = 0;
+    result.mem_used = 0;
+    result.exit_code = 0;
+    result.output_len = 0;
+    result.allocated_cpu = "";
+
+    JobArena &arena = JobArena::current();
+
+    // 创建编译命令
+    string_view compile_cmd = arena.concat({COMPILE_COMMAND, source_file, " -o ", output_file, " 2>&1"});
+
+    auto start_time = high_resolution_clock::now();
+
+    FILE *pipe = popen(compile_cmd.data(), "r");
+    if (!pipe)
+    {
+        result.error_message = "Failed to create compilation process";
+        return result;
+    }
+
+    char buffer[128];
+    pmr::string compile_output(&arena);
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+    {
+        compile_output += buffer;
+    }
+
+    int compile_result = pclose(pipe);
+    auto end_time = high_resolution_clock::now();
+
+    result.time_used = duration_cast<milliseconds>(end_time - start_time).count();
+
+    if (compile_result != 0)
+    {
+        result.error_message = arena.store(compile_output);
+        result.status = "CE";
+        return result;
+    }
+
+    // 检查编译是否超时
+    if (result.time_used > limits.compile_timeout)
+    {
+        result.status = "CE";
+        result.error_message = "Compilation timeout";
+        return result;
+    }
+
+    result.status = "OK";
+    return result;
+}
+
+/**
+ * @brief 按源码内容缓存编译结果
+ * @param source_file 源文件
+ * @param limits 资源限制(使用compile_timeout)
+ * @param executable 输出缓存中的可执行文件路径
+ * @return JudgeResult 编译结果，命中缓存时time_used为0
+ *
+ * 用于出题人提供、反复使用的程序(checker、校验器、生成器、标准程序)；
+ * 选手程序只在compile_cache为1时经过缓存(重测、压测和回放场景)
+ *
+ * @details 缓存规则：
+ *          - 键为源文件、同目录下testlib.h(若存在)和编译命令的FNV-1a哈希
+ *          - 可执行文件保存在.judge_cache/bin/<键>，没有容量上限，也不会自动删除
+ *          - 先编译到带进程号的临时文件再rename，并发编译同一源码也不会读到半成品
+ */
+JudgeResult compileCached(const string &source_file, const Limits &limits, string &executable)
+{
+    JobArena &arena = JobArena::current();
+
+    uint64_t hash = hashFile(source_file.c_str());
+    if (hash == 0)
+    {
+        JudgeResult result;
+        result.status = "CE";
+        result.time_used = 0;
+        result.mem_used = 0;
+        result.exit_code = 0;
+        result.output_len = 0;
+        result.error_message = "Failed to read source file";
+        return result;
+    }
+    size_t slash = source_file.rfind('/');
+    string testlib = (slash == string::npos ? string() : source_file.substr(0, slash + 1)) + "testlib.h";
+    if (access(testlib.c_str(), R_OK) == 0)
+        hash = fnv1a64(hashToHex(hashFile(testlib.c_str())), hash);
+    hash = fnv1a64(COMPILE_COMMAND, hash);
+
+    mkdir(".judge_cache", 0755);
+    mkdir(".judge_cache/bin", 0755);
+    executable = string(arena.concat({".judge_cache/bin/", hashToHex(hash)}));
+
+    if (access(executable.c_str(), X_OK) == 0)
+    {
+        JudgeResult result;
+        result.status = "OK";
+        result.time_used = 0;
+        result.mem_used = 0;
+        result.exit_code = 0;
+        result.output_len = 0;
+        return result;
+    }
+
+    string temporary = executable + ".tmp" + to_string(getpid()) + "_" + to_string(std::hash<thread::id>{}(this_thread::get_id()));
+    JudgeResult result = compileProgram(source_file, temporary, limits);
+    if (result.status != "OK")
+    {
+        unlink(temporary.c_str());
+    }
+    else if (rename(temporary.c_str(), executable.c_str()) != 0)
+    {
+        result.status = "SE";
+        result.error_message = arena.concat({"Failed to rename ", temporary, " to ", executable, ": ", strerror(errno)});
+        unlink(temporary.c_str());
+    }
+    return result;
+}
+
+/**
+ * @brief 把文本按JSON字符串规则转义后追加到out
+ */
+void appendJsonEscaped(pmr::string &out, string_view text)
+{
+    for (char c : text)
+    {
+        if (c == '"')
+            out += "\\\"";
+        else if (c == '\\')
+            out += "\\\\";
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\r')
+            out += "\\r";
+        else if (c == '\t')
+            out += "\\t";
+        else
+            out += c;
+    }
+}
+
+/**
+ * @class PerfProfiler
+ * @brief 基于perf_event_open的热点采样器
+ *
+ * 在子进程exec时开始按频率采样CPU周期(带用户态调用栈)，运行结束后
+ * 用addr2line对仍在磁盘上的可执行文件做符号化，给出热点函数和代码行
+ *
+ * @details 开销控制：
+ *          - 采样频率上限4999Hz，调用栈深度上限MAX_STACK
+ *          - 环形缓冲区固定为RING_PAGES页，写满一半时唤醒父进程读取
+ *          - 来不及读取而丢失的样本计入lost
+ *          - 只采样主线程(inherit=0)，不采样内核态
+ *
+ * @note 需要root权限或perf_event_paranoid允许；硬件周期事件不可用时退化为cpu-clock
+ */
+class PerfProfiler
+{
+public:
+    static constexpr size_t RING_PAGES = 256;  ///< 环形缓冲区数据页数(2的幂)
+    static constexpr uint16_t MAX_STACK = 32;  ///< 调用栈最大深度
+    static constexpr size_t MAX_SYMBOLS = 4096; ///< 参与符号化的最多地址数
+
+private:
+    int frequency;             ///< 采样频率(Hz)
+    int top_n;                 ///< 报告条目数
+    int perf_fd = -1;          ///< perf事件描述符
+    char *ring = nullptr;      ///< 映射的环形缓冲区
+    size_t ring_size = 0;      ///< 映射总大小(含元数据页)
+    string_view open_error;    ///< 打开失败原因
+
+    /**
+     * @struct Mapping
+     * @brief 可执行文件在子进程地址空间中的一段映射
+     */
+    struct Mapping
+    {
+        uint64_t addr;  ///< 起始地址
+        uint64_t len;   ///< 长度
+        uint64_t pgoff; ///< 对应的文件偏移
+    };
+
+    vector<Mapping> mappings;      ///< 可执行文件的代码段映射
+    vector<uint64_t> chain_data;   ///< 所有样本的调用栈(叶子在前)
+    vector<uint32_t> chain_starts; ///< 每个样本在chain_data中的起点
+    long long lost = 0;            ///< 丢失的样本数
+    string exe_path;               ///< 可执行文件的绝对路径
+
+public:
+    PerfProfiler(int sample_frequency, int report_top) : frequency(sample_frequency), top_n(report_top) {}
+
+    ~PerfProfiler()
+    {
+        if (ring != nullptr)
+            munmap(ring, ring_size);
+        if (perf_fd != -1)
+            close(perf_fd);
+    }
+
+    PerfProfiler(const PerfProfiler &) = delete;
+    PerfProfiler &operator=(const PerfProfiler &) = delete;
+
+    /**
+     * @brief 在子进程exec之前打开采样事件
+     * @param pid 已fork但尚未exec的子进程
+     * @param executable 即将执行的可执行文件
+     * @return bool 成功返回true，失败原因见report()
+     */
+    bool attach(pid_t pid, const string &executable)
+    {
+        char resolved[PATH_MAX];
+        exe_path = realpath(executable.c_str(), resolved) != nullptr ? resolved : executable;
+
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.freq = 1;
+        attr.sample_freq = frequency;
+        attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN;
+        attr.sample_max_stack = MAX_STACK;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.exclude_callchain_kernel = 1;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.mmap = 1;
+        attr.watermark = 1;
+        attr.wakeup_watermark = static_cast<uint32_t>(RING_PAGES * getpagesize() / 2);
+
+        perf_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        if (perf_fd == -1)
+        {
+            // 虚拟机中通常没有硬件计数器，退化为软件时钟事件
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_CPU_CLOCK;
+            perf_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        }
+        if (perf_fd == -1)
+        {
+            open_error = JobArena::current().concat({"perf_event_open failed: ", strerror(errno)});
+            return false;
+        }
+
+        ring_size = (RING_PAGES + 1) * getpagesize();
+        void *addr = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, perf_fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            open_error = "Failed to map perf ring buffer";
+            close(perf_fd);
+            perf_fd = -1;
+            return false;
+        }
+        ring = static_cast<char *>(addr);
+        return true;
+    }
+
+    /**
+     * @brief 获取perf事件描述符，缓冲区写满一半时可读
+     */
+    int fd() const { return perf_fd; }
+
+    /**
+     * @brief 读取并解析环形缓冲区中已有的全部记录
+     */
+    void drain()
+    {
+        if (ring == nullptr)
+            return;
+
+        auto *meta = reinterpret_cast<perf_event_mmap_page *>(ring);
+        char *data = ring + getpagesize();
+        uint64_t data_size = RING_PAGES * getpagesize();
+        uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = meta->data_tail;
+
+        alignas(8) char record[4096 + 64];
+        while (tail < head)
+        {
+            perf_event_header header;
+            copyOut(data, data_size, tail, &header, sizeof(header));
+            if (header.size < sizeof(header) || header.size > sizeof(record))
+                break;
+            copyOut(data, data_size, tail, record, header.size);
+            parseRecord(header, record);
+            tail += header.size;
+        }
+
+        __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief 符号化并生成热点报告
+     * @return string_view JSON对象片段(位于任务arena)
+     *
+     * 报告包括样本数、丢失数、按自身样本排序的热点代码行，
+     * 以及按自身/包含样本统计的热点函数
+     */
+    string_view report()
+    {
+        drain();
+
+        JobArena &arena = JobArena::current();
+        pmr::string out(&arena);
+        size_t samples = chain_starts.size();
+
+        out.append("{\"samples\": ").append(arena.number(static_cast<long long>(samples)));
+        out.append(", \"lost\": ").append(arena.number(lost));
+        out.append(", \"frequency\": ").append(arena.number(frequency));
+        if (!open_error.empty())
+        {
+            out += ", \"error\": \"";
+            appendJsonEscaped(out, open_error);
+            out += "\"}";
+            return string_view(out.data(), out.size());
+        }
+
+        // 统计每个地址出现的次数，取最频繁的地址做符号化
+        unordered_map<uint64_t, long long> address_hits;
+        for (uint64_t ip : chain_data)
+            address_hits[ip]++;
+        vector<pair<long long, uint64_t>> ranked;
+        ranked.reserve(address_hits.size());
+        for (auto &[ip, hits] : address_hits)
+            ranked.push_back({hits, ip});
+        sort(ranked.rbegin(), ranked.rend());
+        if (ranked.size() > MAX_SYMBOLS)
+            ranked.resize(MAX_SYMBOLS);
+
+        unordered_map<uint64_t, pair<string, string>> symbols = symbolize(ranked);
+
+        // 热点代码行：按叶子地址(自身样本)统计
+        unordered_map<string, long long> line_self;
+        // 热点函数：自身样本和包含样本(同一样本中同一函数只计一次)
+        unordered_map<string, pair<long long, long long>> function_counts;
+        for (size_t i = 0; i < samples; i++)
+        {
+            size_t begin = chain_starts[i];
+            size_t end = i + 1 < samples ? chain_starts[i + 1] : chain_data.size();
+            vector<const string *> seen;
+            for (size_t j = begin; j < end; j++)
+            {
+                auto it = symbols.find(chain_data[j]);
+                if (it == symbols.end())
+                    continue;
+                const string &function = it->second.first;
+                if (j == begin)
+                {
+                    line_self[it->second.second]++;
+                    function_counts[function].first++;
+                }
+                bool counted = false;
+                for (const string *name : seen)
+                    counted = counted || *name == function;
+                if (!counted)
+                {
+                    seen.push_back(&function);
+                    function_counts[function].second++;
+                }
+            }
+        }
+
+        vector<pair<long long, string>> lines;
+        for (auto &[location, hits] : line_self)
+            lines.push_back({hits, location});
+        sort(lines.rbegin(), lines.rend());
+
+        vector<pair<pair<long long, long long>, string>> functions;
+        for (auto &[name, counts] : function_counts)
+            functions.push_back({counts, name});
+        sort(functions.rbegin(), functions.rend());
+
+        out += ", \"functions\": [";
+        for (size_t i = 0; i < functions.size() && i < static_cast<size_t>(top_n); i++)
+        {
+            out += i == 0 ? "{\"name\": \"" : ", {\"name\": \"";
+            appendJsonEscaped(out, functions[i].second);
+            out.append("\", \"self\": ").append(arena.number(functions[i].first.first));
+            out.append(", \"total\": ").append(arena.number(functions[i].first.second)).append("}");
+        }
+        out += "], \"lines\": [";
+        for (size_t i = 0; i < lines.size() && i < static_cast<size_t>(top_n); i++)
+        {
+            out += i == 0 ? "{\"location\": \"" : ", {\"location\": \"";
+            appendJsonEscaped(out, lines[i].second);
+            out.append("\", \"self\": ").append(arena.number(lines[i].first)).append("}");
+        }
+        out += "]}";
+        return string_view(out.data(), out.size());
+    }
+
+private:
+    /**
+     * @brief 从环形缓冲区复制数据，处理回绕
+     */
+    static void copyOut(const char *data, uint64_t data_size, uint64_t offset, void *dest, size_t length)
+    {
+        size_t start = offset % data_size;
+        size_t first = min<size_t>(length, data_size - start);
+        memcpy(dest, data + start, first);
+        if (first < length)
+            memcpy(static_cast<char *>(dest) + first, data, length - first);
+    }
+
+    /**
+     * @brief 解析单条记录：样本、可执行映射和丢失计数
+     */
+    void parseRecord(const perf_event_header &header, const char *record)
+    {
+        const char *body = record + sizeof(perf_event_header);
+        if (header.type == PERF_RECORD_SAMPLE)
+        {
+            uint64_t ip, nr;
+            memcpy(&ip, body, 8);
+            memcpy(&nr, body + 8, 8);
+            chain_starts.push_back(static_cast<uint32_t>(chain_data.size()));
+            chain_data.push_back(ip);
+            for (uint64_t i = 0; i < nr && 16 + (i + 1) * 8 <= header.size - sizeof(header); i++)
+            {
+                uint64_t frame;
+                memcpy(&frame, body + 16 + i * 8, 8);
+                // 跳过上下文标记，以及与ip重复的第一帧
+                if (frame >= static_cast<uint64_t>(PERF_CONTEXT_MAX) || (i <= 1 && frame == ip))
+                    continue;
+                chain_data.push_back(frame);
+            }
+        }
+        else if (header.type == PERF_RECORD_MMAP)
+        {
+            // struct { u32 pid, tid; u64 addr, len, pgoff; char filename[]; }
+            Mapping mapping;
+            memcpy(&mapping.addr, body + 8, 8);
+            memcpy(&mapping.len, body + 16, 8);
+            memcpy(&mapping.pgoff, body + 24, 8);
+            const char *filename = body + 32;
+            size_t max_len = header.size - sizeof(header) - 32;
+            if (string_view(filename, strnlen(filename, max_len)) == exe_path)
+                mappings.push_back(mapping);
+        }
+        else if (header.type == PERF_RECORD_LOST)
+        {
+            uint64_t lost_count;
+            memcpy(&lost_count, body + 8, 8);
+            lost += static_cast<long long>(lost_count);
+        }
+    }
+
+    /**
+     * @brief 把运行时地址换算为ELF虚拟地址
+     * @return uint64_t 虚拟地址，不属于可执行文件时返回0
+     */
+    uint64_t toElfAddress(uint64_t ip, const vector<Elf64_Phdr> &loads) const
+    {
+        for (const Mapping &mapping : mappings)
+        {
+            if (ip < mapping.addr || ip >= mapping.addr + mapping.len)
+                continue;
+            uint64_t file_offset = ip - mapping.addr + mapping.pgoff;
+            for (const Elf64_Phdr &phdr : loads)
+            {
+                if (file_offset >= phdr.p_offset && file_offset < phdr.p_offset + phdr.p_filesz)
+                    return file_offset - phdr.p_offset + phdr.p_vaddr;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief 读取可执行文件的PT_LOAD程序头
+     */
+    vector<Elf64_Phdr> readLoadSegments() const
+    {
+        vector<Elf64_Phdr> loads;
+        int fd = open(exe_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            return loads;
+
+        Elf64_Ehdr ehdr;
+        if (pread(fd, &ehdr, sizeof(ehdr), 0) == sizeof(ehdr) && memcmp(ehdr.e_ident, ELFMAG, SELFMAG) == 0 &&
+            ehdr.e_ident[EI_CLASS] == ELFCLASS64)
+        {
+            for (int i = 0; i < ehdr.e_phnum; i++)
+            {
+                Elf64_Phdr phdr;
+                if (pread(fd, &phdr, sizeof(phdr), ehdr.e_phoff + i * ehdr.e_phentsize) != sizeof(phdr))
+                    break;
+                if (phdr.p_type == PT_LOAD)
+                    loads.push_back(phdr);
+            }
+        }
+        close(fd);
+        return loads;
+    }
+
+    /**
+     * @brief 调用addr2line批量符号化
+     * @return 运行时地址 -> (函数名, 文件:行号)
+     *
+     * 地址写入临时文件后作为addr2line的标准输入，一次调用完成全部符号化
+     * addr2line以argv数组经posix_spawnp启动，不经过shell，可执行文件路径无需转义
+     */
+    unordered_map<uint64_t, pair<string, string>> symbolize(const vector<pair<long long, uint64_t>> &ranked) const
+    {
+        unordered_map<uint64_t, pair<string, string>> symbols;
+        vector<Elf64_Phdr> loads = readLoadSegments();
+
+        vector<uint64_t> runtime_addresses;
+        char address_file[] = "/tmp/judge_profile_XXXXXX";
+        int fd = mkstemp(address_file);
+        if (fd == -1)
+            return symbols;
+
+        string addresses;
+        for (const auto &entry : ranked)
+        {
+            uint64_t elf_address = toElfAddress(entry.second, loads);
+            if (elf_address == 0)
+                continue;
+            char line[32];
+            snprintf(line, sizeof(line), "%llx\n", static_cast<unsigned long long>(elf_address));
+            addresses += line;
+            runtime_addresses.push_back(entry.second);
+        }
+        bool written = write(fd, addresses.data(), addresses.size()) == static_cast<ssize_t>(addresses.size());
+        close(fd);
+
+        int output_pipe[2] = {-1, -1};
+        if (written && !runtime_addresses.empty() && pipe2(output_pipe, O_CLOEXEC) == 0)
+        {
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, address_file, O_RDONLY, 0);
+            posix_spawn_file_actions_adddup2(&actions, output_pipe[1], STDOUT_FILENO);
+
+            const char *argv[] = {"addr2line", "-f", "-C", "-e", exe_path.c_str(), nullptr};
+            pid_t pid = -1;
+            int spawn_error = posix_spawnp(&pid, "addr2line", &actions, nullptr, const_cast<char *const *>(argv), environ);
+            posix_spawn_file_actions_destroy(&actions);
+            close(output_pipe[1]);
+
+            FILE *pipe = spawn_error == 0 ? fdopen(output_pipe[0], "r") : nullptr;
+            if (pipe == nullptr)
+                close(output_pipe[0]);
+            if (pipe != nullptr)
+            {
+                char function[1024];
+                char location[1024];
+                for (uint64_t ip : runtime_addresses)
+                {
+                    if (fgets(function, sizeof(function), pipe) == nullptr || fgets(location, sizeof(location), pipe) == nullptr)
+                        break;
+                    function[strcspn(function, "\n")] = '\0';
+                    location[strcspn(location, "\n ")] = '\0';
+                    // 只保留文件名，去掉编译时的目录
+                    const char *slash = strrchr(location, '/');
+                    symbols[ip] = {function, slash != nullptr ? slash + 1 : location};
+                }
+                fclose(pipe);
+            }
+            if (spawn_error == 0)
+                waitpid(pid, nullptr, 0);
+        }
+        unlink(address_file);
+        return symbols;
+    }
+};
+
+/**
+ * @class MemoryTraffic
+ * @brief 统计一次运行的末级缓存未命中次数，并按程序记录是否内存密集
+ *
+ * 计数事件在exec时开始、随子进程继承，未命中次数×64字节÷墙钟时间估算访存带宽
+ * 估算带宽不低于memory_heavy_mbps的程序被记为内存密集，之后的运行(重测、其余测试点)
+ * 据此避开已有内存密集运行的LLC域
+ *
+ * 分类按可执行文件的内容哈希记录在LEASE_DIR/heavy/<哈希>，每个测试点单独启动评测进程时
+ * 同样生效；进程内另以(设备, inode, 大小, 修改时间)缓存哈希，同一程序只读一遍
+ *
+ * @note 虚拟机通常不提供硬件计数器，此时只能依靠memory_class提示
+ */
+class MemoryTraffic
+{
+private:
+    int counter_fd = -1; ///< 计数事件描述符，-1表示不可用
+
+    static mutex &historyMutex()
+    {
+        static mutex lock;
+        return lock;
+    }
+
+    static unordered_set<uint64_t> &history()
+    {
+        static unordered_set<uint64_t> heavy_programs;
+        return heavy_programs;
+    }
+
+    /**
+     * @brief 计算程序的内容哈希(调用方持有historyMutex)
+     * @return uint64_t 文件无法读取时返回0
+     */
+    static uint64_t contentKey(const string &executable)
+    {
+        struct Stamp
+        {
+            dev_t device;
+            ino_t inode;
+            off_t size;
+            long long mtime_ns;
+            uint64_t hash;
+        };
+        static unordered_map<string, Stamp> cache;
+
+        struct stat st;
+        if (stat(executable.c_str(), &st) != 0)
+            return 0;
+        long long mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        auto it = cache.find(executable);
+        if (it != cache.end() && it->second.device == st.st_dev && it->second.inode == st.st_ino &&
+            it->second.size == st.st_size && it->second.mtime_ns == mtime_ns)
+            return it->second.hash;
+
+        uint64_t hash = hashFile(executable.c_str());
+        if (hash != 0)
+            cache[executable] = {st.st_dev, st.st_ino, st.st_size, mtime_ns, hash};
+        return hash;
+    }
+
+    /**
+     * @brief 生成内容哈希对应的分类标记文件路径
+     */
+    static void markerPath(uint64_t key, char *path, size_t size)
+    {
+        snprintf(path, size, "%s/heavy/%016llx", CpuLease::LEASE_DIR, static_cast<unsigned long long>(key));
+    }
+
+public:
+    MemoryTraffic() = default;
+    ~MemoryTraffic()
+    {
+        if (counter_fd != -1)
+            close(counter_fd);
+    }
+
+    MemoryTraffic(const MemoryTraffic &) = delete;
+    MemoryTraffic &operator=(const MemoryTraffic &) = delete;
+
+    /**
+     * @brief 为已fork但尚未exec的子进程打开缓存未命中计数
+     * @return bool 硬件计数器不可用时返回false
+     */
+    bool attach(pid_t pid)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.inherit = 1;
+        attr.exclude_hv = 1;
+        counter_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        return counter_fd != -1;
+    }
+
+    /**
+     * @brief 读取累计的未命中次数(子进程回收后读取包含全部子孙进程)
+     * @return long long 计数不可用返回-1
+     */
+    long long misses() const
+    {
+        uint64_t count = 0;
+        if (counter_fd == -1 || ::read(counter_fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count)))
+            return -1;
+        return static_cast<long long>(count);
+    }
+
+    /**
+     * @brief 查询程序此前是否被观测为内存密集
+     */
+    static bool observedHeavy(const string &executable)
+    {
+        lock_guard<mutex> guard(historyMutex());
+        uint64_t key = contentKey(executable);
+        if (key == 0)
+            return false;
+        if (history().contains(key))
+            return true;
+
+        char path[128];
+        markerPath(key, path, sizeof(path));
+        if (access(path, F_OK) != 0)
+            return false;
+        history().insert(key);
+        return true;
+    }
+
+    /**
+     * @brief 把程序记为内存密集(小数据测试点的观测不会撤销这一标记)
+     *
+     * 标记文件写入失败(锁目录不可用)时只在本进程内生效
+     */
+    static void markHeavy(const string &executable)
+    {
+        lock_guard<mutex> guard(historyMutex());
+        uint64_t key = contentKey(executable);
+        if (key == 0)
+            return;
+        history().insert(key);
+
+        char path[128];
+        snprintf(path, sizeof(path), "%s/heavy", CpuLease::LEASE_DIR);
+        mkdir(CpuLease::LEASE_DIR, 0755);
+        mkdir(path, 0755);
+        markerPath(key, path, sizeof(path));
+        int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd != -1)
+            close(fd);
+    }
+};
+
+/**
+ * @class SyscallTracer
+ * @brief 按cgroup统计系统调用次数和离核时间的eBPF采集器
+ *
+ * 进程内只加载一次，两个手工汇编的tracepoint程序挂在评测可用核心上：
+ *          - raw_syscalls/sys_enter：当前任务的cgroup在watched表中时，按调用号累加计数
+ *          - sched/sched_switch：被监视的任务离核时记下时间和离核原因，
+ *            再次上核时把离核时长累加到所属槽位(阻塞/被抢占分开统计)
+ *
+ * 每次运行占用一个槽位(cgroup ID → 槽位号)，计数数组以BPF_F_MMAPABLE映射到用户态，
+ * 读取和清零都不需要系统调用。不依赖libbpf和BTF，只使用bpf(2)与perf_event_open(2)
+ *
+ * @note 需要root、tracefs(未挂载时临时挂载到/sys/kernel/tracing，初始化后卸载)和cgroup v2
+ */
+class SyscallTracer
+{
+public:
+    static constexpr int MAX_SLOTS = 64;      ///< 同时监视的运行数
+    static constexpr int SYSCALL_SLOTS = 512; ///< 每个槽位统计的调用号范围[0, 512)
+
+private:
+    /**
+     * @struct OffCpuStart
+     * @brief 离核记录(与BPF程序中的栈布局一致)
+     */
+    struct OffCpuStart
+    {
+        uint64_t timestamp_ns;
+        uint32_t slot;
+        uint32_t runnable;
+    };
+
+    /**
+     * @struct OffCpuTotal
+     * @brief 每个槽位每种离核原因的累计值
+     */
+    struct OffCpuTotal
+    {
+        uint64_t ns;
+        uint64_t count;
+    };
+
+    int watched_fd = -1;   ///< cgroup ID → 槽位号
+    int counts_fd = -1;    ///< 调用计数数组
+    int start_fd = -1;     ///< 线程号 → 离核记录
+    int offcpu_fd = -1;    ///< 离核时间数组
+    vector<int> program_fds;
+    vector<int> event_fds;
+    uint64_t *counts = nullptr;      ///< 映射的调用计数数组
+    OffCpuTotal *offcpu = nullptr;   ///< 映射的离核时间数组
+    size_t counts_size = 0, offcpu_size = 0;
+    string error;                    ///< 初始化失败原因
+    mutex slot_mutex;
+    vector<int> free_slots;
+
+    static long bpf(int command, bpf_attr &attr)
+    {
+        return syscall(SYS_bpf, command, &attr, sizeof(attr));
+    }
+
+    static bpf_insn instruction(uint8_t code, uint8_t dst, uint8_t src, int16_t offset, int32_t imm)
+    {
+        bpf_insn insn;
+        memset(&insn, 0, sizeof(insn));
+        insn.code = code;
+        insn.dst_reg = dst & 0xf;
+        insn.src_reg = src & 0xf;
+        insn.off = offset;
+        insn.imm = imm;
+        return insn;
+    }
+
+    /**
+     * @class Assembler
+     * @brief 极简的BPF汇编器，只提供两个程序用到的指令
+     */
+    class Assembler
+    {
+    public:
+        vector<bpf_insn> code;
+
+        void mov(int dst, int src) { code.push_back(instruction(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0)); }
+        void movImm(int dst, int32_t imm) { code.push_back(instruction(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm)); }
+        void addImm(int dst, int32_t imm) { code.push_back(instruction(BPF_ALU64 | BPF_ADD | BPF_K, dst, 0, 0, imm)); }
+        void add(int dst, int src) { code.push_back(instruction(BPF_ALU64 | BPF_ADD | BPF_X, dst, src, 0, 0)); }
+        void sub(int dst, int src) { code.push_back(instruction(BPF_ALU64 | BPF_SUB | BPF_X, dst, src, 0, 0)); }
+        void mulImm(int dst, int32_t imm) { code.push_back(instruction(BPF_ALU64 | BPF_MUL | BPF_K, dst, 0, 0, imm)); }
+        void andImm(int dst, int32_t imm) { code.push_back(instruction(BPF_ALU64 | BPF_AND | BPF_K, dst, 0, 0, imm)); }
+        void load(int size, int dst, int src, int16_t offset) { code.push_back(instruction(BPF_LDX | size | BPF_MEM, dst, src, offset, 0)); }
+        void store(int size, int dst, int16_t offset, int src) { code.push_back(instruction(BPF_STX | size | BPF_MEM, dst, src, offset, 0)); }
+        void atomicAdd(int dst, int16_t offset, int src) { code.push_back(instruction(BPF_STX | BPF_DW | BPF_ATOMIC, dst, src, offset, BPF_ADD)); }
+        void call(int helper) { code.push_back(instruction(BPF_JMP | BPF_CALL, 0, 0, 0, helper)); }
+        void exit() { code.push_back(instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)); }
+
+        /// 加载map描述符(双槽指令)
+        void loadMap(int dst, int map_fd)
+        {
+            code.push_back(instruction(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, map_fd));
+            code.push_back(instruction(0, 0, 0, 0, 0));
+        }
+
+        /// 条件跳转到尚未确定的位置，返回待回填的指令下标
+        size_t jumpImm(int op, int dst, int32_t imm)
+        {
+            code.push_back(instruction(BPF_JMP | op | BPF_K, dst, 0, 0, imm));
+            return code.size() - 1;
+        }
+
+        /// 把跳转目标回填为下一条将要生成的指令
+        void land(size_t jump) { code[jump].off = static_cast<int16_t>(code.size() - jump - 1); }
+
+        /// r0 = map_lookup_elem(map, r10 + key_offset)
+        void lookup(int map_fd, int16_t key_offset)
+        {
+            loadMap(BPF_REG_1, map_fd);
+            mov(BPF_REG_2, BPF_REG_10);
+            addImm(BPF_REG_2, key_offset);
+            call(BPF_FUNC_map_lookup_elem);
+        }
+    };
+
+    /**
+     * @brief 从tracepoint的format文件读取字段偏移
+     * @return int 失败返回-1
+     */
+    static int fieldOffset(const string &format, string_view field)
+    {
+        string needle = string(field) + ";\toffset:";
+        size_t pos = format.find(needle);
+        if (pos == string::npos)
+            return -1;
+        return static_cast<int>(parseLeadingNumber(string_view(format).substr(pos + needle.size())));
+    }
+
+    /**
+     * @brief 查找tracefs挂载点，未挂载时临时挂载到/sys/kernel/tracing
+     * @param mounted 输出是否由本函数挂载(调用方用完后需卸载)
+     */
+    static string tracefsRoot(bool &mounted)
+    {
+        mounted = false;
+        for (const char *root : {"/sys/kernel/tracing", "/sys/kernel/debug/tracing"})
+        {
+            if (access((string(root) + "/events").c_str(), F_OK) == 0)
+                return root;
+        }
+        if (mount("nodev", "/sys/kernel/tracing", "tracefs", 0, nullptr) == 0)
+        {
+            mounted = true;
+            return "/sys/kernel/tracing";
+        }
+        return string();
+    }
+
+    int createMap(bpf_map_type type, uint32_t key_size, uint32_t value_size, uint32_t entries, uint32_t flags = 0)
+    {
+        bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_type = type;
+        attr.key_size = key_size;
+        attr.value_size = value_size;
+        attr.max_entries = entries;
+        attr.map_flags = flags;
+        int fd = static_cast<int>(bpf(BPF_MAP_CREATE, attr));
+        if (fd == -1 && error.empty())
+            error = string("BPF_MAP_CREATE failed: ") + strerror(errno);
+        return fd;
+    }
+
+    int loadProgram(const vector<bpf_insn> &code)
+    {
+        static char log[16384];
+        bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.prog_type = BPF_PROG_TYPE_TRACEPOINT;
+        attr.insns = reinterpret_cast<uintptr_t>(code.data());
+        attr.insn_cnt = static_cast<uint32_t>(code.size());
+        attr.license = reinterpret_cast<uintptr_t>("GPL");
+        attr.log_buf = reinterpret_cast<uintptr_t>(log);
+        attr.log_size = sizeof(log);
+        attr.log_level = 1;
+        log[0] = '\0';
+        int fd = static_cast<int>(bpf(BPF_PROG_LOAD, attr));
+        if (fd == -1 && error.empty())
+            error = string("BPF_PROG_LOAD failed: ") + strerror(errno) + ": " + log;
+        return fd;
+    }
+
+    /**
+     * @brief 在每个评测核心上打开tracepoint事件并挂上程序
+     */
+    bool attach(const string &event_dir, int program_fd)
+    {
+        long long id = parseLeadingNumber(readText(event_dir + "/id"));
+        if (id < 0)
+        {
+            error = "tracepoint not found: " + event_dir;
+            return false;
+        }
+        for (int cpu : CpuLease::allowedCpus())
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_TRACEPOINT;
+            attr.config = static_cast<uint64_t>(id);
+            attr.sample_period = 1;
+            attr.wakeup_events = 1;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, -1, cpu, -1, PERF_FLAG_FD_CLOEXEC));
+            if (fd == -1 || ioctl(fd, PERF_EVENT_IOC_SET_BPF, program_fd) != 0 || ioctl(fd, PERF_EVENT_IOC_ENABLE, 0) != 0)
+            {
+                error = "Failed to attach " + event_dir + ": " + strerror(errno);
+                if (fd != -1)
+                    close(fd);
+                return false;
+            }
+            event_fds.push_back(fd);
+        }
+        return true;
+    }
+
+    static string readText(const string &path)
+    {
+        ifstream in(path);
+        return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    /**
+     * @brief sys_enter：r6=ctx，栈上[-8]为cgroup ID，[-12]为计数下标
+     */
+    vector<bpf_insn> assembleSysEnter(int id_offset) const
+    {
+        Assembler a;
+        a.mov(BPF_REG_6, BPF_REG_1);
+        a.call(BPF_FUNC_get_current_cgroup_id);
+        a.store(BPF_DW, BPF_REG_10, -8, BPF_REG_0);
+        a.lookup(watched_fd, -8);
+        size_t not_watched = a.jumpImm(BPF_JEQ, BPF_REG_0, 0);
+        a.load(BPF_W, BPF_REG_7, BPF_REG_0, 0);
+        a.load(BPF_DW, BPF_REG_8, BPF_REG_6, static_cast<int16_t>(id_offset));
+        size_t out_of_range = a.jumpImm(BPF_JGE, BPF_REG_8, SYSCALL_SLOTS); // 无符号比较，-1等负数同样排除
+        a.mulImm(BPF_REG_7, SYSCALL_SLOTS);
+        a.add(BPF_REG_7, BPF_REG_8);
+        a.store(BPF_W, BPF_REG_10, -12, BPF_REG_7);
+        a.lookup(counts_fd, -12);
+        size_t missing = a.jumpImm(BPF_JEQ, BPF_REG_0, 0);
+        a.movImm(BPF_REG_1, 1);
+        a.atomicAdd(BPF_REG_0, 0, BPF_REG_1);
+        a.land(not_watched);
+        a.land(out_of_range);
+        a.land(missing);
+        a.movImm(BPF_REG_0, 0);
+        a.exit();
+        return a.code;
+    }
+
+    /**
+     * @brief sched_switch：r6=ctx，r9=当前时间
+     *
+     * 栈布局：[-4]线程号，[-8..-16)cgroup ID，[-24]离核时长，[-28]离核数组下标，[-48..-32)离核记录
+     * 先结算上核线程(next)的离核记录，再为离核线程(prev，即当前任务)写入新记录
+     */
+    vector<bpf_insn> assembleSchedSwitch(int prev_pid_offset, int prev_state_offset, int next_pid_offset) const
+    {
+        Assembler a;
+        a.mov(BPF_REG_6, BPF_REG_1);
+        a.call(BPF_FUNC_ktime_get_ns);
+        a.mov(BPF_REG_9, BPF_REG_0);
+
+        // 上核：结算离核时长
+        a.load(BPF_W, BPF_REG_1, BPF_REG_6, static_cast<int16_t>(next_pid_offset));
+        a.store(BPF_W, BPF_REG_10, -4, BPF_REG_1);
+        a.lookup(start_fd, -4);
+        size_t no_start = a.jumpImm(BPF_JEQ, BPF_REG_0, 0);
+        a.mov(BPF_REG_1, BPF_REG_9);
+        a.load(BPF_DW, BPF_REG_2, BPF_REG_0, 0);
+        a.sub(BPF_REG_1, BPF_REG_2);
+        a.store(BPF_DW, BPF_REG_10, -24, BPF_REG_1);
+        a.load(BPF_W, BPF_REG_7, BPF_REG_0, 8);
+        a.load(BPF_W, BPF_REG_8, BPF_REG_0, 12);
+        a.mulImm(BPF_REG_7, 2);
+        a.add(BPF_REG_7, BPF_REG_8);
+        a.store(BPF_W, BPF_REG_10, -28, BPF_REG_7);
+        a.lookup(offcpu_fd, -28);
+        size_t no_total = a.jumpImm(BPF_JEQ, BPF_REG_0, 0);
+        a.load(BPF_DW, BPF_REG_1, BPF_REG_10, -24);
+        a.atomicAdd(BPF_REG_0, 0, BPF_REG_1);
+        a.movImm(BPF_REG_1, 1);
+        a.atomicAdd(BPF_REG_0, 8, BPF_REG_1);
+        a.land(no_total);
+        a.loadMap(BPF_REG_1, start_fd);
+        a.mov(BPF_REG_2, BPF_REG_10);
+        a.addImm(BPF_REG_2, -4);
+        a.call(BPF_FUNC_map_delete_elem);
+        a.land(no_start);
+
+        // 离核：当前任务属于被监视的cgroup时记录
+        a.call(BPF_FUNC_get_current_cgroup_id);
+        a.store(BPF_DW, BPF_REG_10, -16, BPF_REG_0);
+        a.lookup(watched_fd, -16);
+        size_t not_watched = a.jumpImm(BPF_JEQ, BPF_REG_0, 0);
+        a.load(BPF_W, BPF_REG_7, BPF_REG_0, 0);
+        a.store(BPF_DW, BPF_REG_10, -48, BPF_REG_9);
+        a.store(BPF_W, BPF_REG_10, -40, BPF_REG_7);
+        // prev_state低8位为0表示仍可运行(被抢占时内核另置TASK_REPORT_MAX位)
+        a.load(BPF_DW, BPF_REG_1, BPF_REG_6, static_cast<int16_t>(prev_state_offset));
+        a.andImm(BPF_REG_1, 0xff);
+        a.movImm(BPF_REG_2, 0);
+        size_t blocked = a.jumpImm(BPF_JNE, BPF_REG_1, 0);
+        a.movImm(BPF_REG_2, 1);
+        a.land(blocked);
+        a.store(BPF_W, BPF_REG_10, -36, BPF_REG_2);
+        a.load(BPF_W, BPF_REG_1, BPF_REG_6, static_cast<int16_t>(prev_pid_offset));
+        a.store(BPF_W, BPF_REG_10, -4, BPF_REG_1);
+        a.loadMap(BPF_REG_1, start_fd);
+        a.mov(BPF_REG_2, BPF_REG_10);
+        a.addImm(BPF_REG_2, -4);
+        a.mov(BPF_REG_3, BPF_REG_10);
+        a.addImm(BPF_REG_3, -48);
+        a.movImm(BPF_REG_4, BPF_ANY);
+        a.call(BPF_FUNC_map_update_elem);
+        a.land(not_watched);
+        a.movImm(BPF_REG_0, 0);
+        a.exit();
+        return a.code;
+    }
+
+    SyscallTracer()
+    {
+        bool mounted = false;
+        string root = tracefsRoot(mounted);
+        if (root.empty())
+        {
+            error = "tracefs not available";
+            return;
+        }
+        // 只在读取format和打开tracepoint时需要tracefs，已挂上的事件不依赖挂载点
+        // 由本进程临时挂载的在构造结束时卸载，不在主机上留下挂载
+        struct TracefsMount
+        {
+            const string &root;
+            bool mounted;
+            ~TracefsMount()
+            {
+                if (mounted)
+                    umount2(root.c_str(), MNT_DETACH);
+            }
+        } tracefs_mount{root, mounted};
+        string enter_dir = root + "/events/raw_syscalls/sys_enter";
+        string switch_dir = root + "/events/sched/sched_switch";
+        string enter_format = readText(enter_dir + "/format");
+        string switch_format = readText(switch_dir + "/format");
+        int id_offset = fieldOffset(enter_format, "long id");
+        int prev_pid_offset = fieldOffset(switch_format, "pid_t prev_pid");
+        int prev_state_offset = fieldOffset(switch_format, "long prev_state");
+        int next_pid_offset = fieldOffset(switch_format, "pid_t next_pid");
+        if (id_offset < 0 || prev_pid_offset < 0 || prev_state_offset < 0 || next_pid_offset < 0)
+        {
+            error = "Unexpected tracepoint format";
+            return;
+        }
+
+        watched_fd = createMap(BPF_MAP_TYPE_HASH, sizeof(uint64_t), sizeof(uint32_t), MAX_SLOTS);
+        counts_fd = createMap(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t), sizeof(uint64_t), MAX_SLOTS * SYSCALL_SLOTS, BPF_F_MMAPABLE);
+        start_fd = createMap(BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(OffCpuStart), 4096);
+        offcpu_fd = createMap(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t), sizeof(OffCpuTotal), MAX_SLOTS * 2, BPF_F_MMAPABLE);
+        if (watched_fd == -1 || counts_fd == -1 || start_fd == -1 || offcpu_fd == -1)
+            return;
+
+        size_t page = static_cast<size_t>(getpagesize());
+        counts_size = (sizeof(uint64_t) * MAX_SLOTS * SYSCALL_SLOTS + page - 1) / page * page;
+        offcpu_size = (sizeof(OffCpuTotal) * MAX_SLOTS * 2 + page - 1) / page * page;
+        void *counts_map = mmap(nullptr, counts_size, PROT_READ | PROT_WRITE, MAP_SHARED, counts_fd, 0);
+        void *offcpu_map = mmap(nullptr, offcpu_size, PROT_READ | PROT_WRITE, MAP_SHARED, offcpu_fd, 0);
+        if (counts_map == MAP_FAILED || offcpu_map == MAP_FAILED)
+        {
+            error = string("Failed to map BPF arrays: ") + strerror(errno);
+            if (counts_map != MAP_FAILED)
+                munmap(counts_map, counts_size);
+            if (offcpu_map != MAP_FAILED)
+                munmap(offcpu_map, offcpu_size);
+            return;
+        }
+        counts = static_cast<uint64_t *>(counts_map);
+        offcpu = static_cast<OffCpuTotal *>(offcpu_map);
+
+        int enter_fd = loadProgram(assembleSysEnter(id_offset));
+        int switch_fd = loadProgram(assembleSchedSwitch(prev_pid_offset, prev_state_offset, next_pid_offset));
+        for (int fd : {enter_fd, switch_fd})
+            if (fd != -1)
+                program_fds.push_back(fd);
+        if (enter_fd == -1 || switch_fd == -1 || !attach(enter_dir, enter_fd) || !attach(switch_dir, switch_fd))
+            return;
+
+        for (int slot = MAX_SLOTS - 1; slot >= 0; slot--)
+            free_slots.push_back(slot);
+    }
+
+public:
+    ~SyscallTracer()
+    {
+        for (int fd : event_fds)
+            close(fd);
+        for (int fd : program_fds)
+            close(fd);
+        if (counts != nullptr)
+            munmap(counts, counts_size);
+        if (offcpu != nullptr)
+            munmap(offcpu, offcpu_size);
+        for (int fd : {watched_fd, counts_fd, start_fd, offcpu_fd})
+            if (fd != -1)
+                close(fd);
+    }
+
+    SyscallTracer(const SyscallTracer &) = delete;
+    SyscallTracer &operator=(const SyscallTracer &) = delete;
+
+    /**
+     * @brief 获取进程内唯一的采集器(首次调用时加载并挂载程序)
+     */
+    static SyscallTracer &instance()
+    {
+        static SyscallTracer tracer;
+        return tracer;
+    }
+
+    /**
+     * @brief 初始化失败原因，为空表示可用
+     */
+    const string &initError() const { return error; }
+
+    /**
+     * @brief 开始监视一个cgroup
+     * @param cgroup_id cgroup v2目录的inode号
+     * @return int 槽位号，采集器不可用或槽位用尽时返回-1
+     */
+    int watch(uint64_t cgroup_id)
+    {
+        int slot;
+        {
+            lock_guard<mutex> guard(slot_mutex);
+            if (!error.empty() || free_slots.empty() || cgroup_id == 0)
+                return -1;
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+
+        uint32_t value = static_cast<uint32_t>(slot);
+        bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = static_cast<uint32_t>(watched_fd);
+        attr.key = reinterpret_cast<uintptr_t>(&cgroup_id);
+        attr.value = reinterpret_cast<uintptr_t>(&value);
+        attr.flags = BPF_ANY;
+        if (bpf(BPF_MAP_UPDATE_ELEM, attr) != 0)
+        {
+            lock_guard<mutex> guard(slot_mutex);
+            free_slots.push_back(slot);
+            return -1;
+        }
+        return slot;
+    }
+
+    /**
+     * @brief 停止监视并取出统计结果，槽位清零后归还
+     * @param slot watch()返回的槽位号
+     */
+    SyscallProfile collect(int slot, uint64_t cgroup_id)
+    {
+        bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = static_cast<uint32_t>(watched_fd);
+        attr.key = reinterpret_cast<uintptr_t>(&cgroup_id);
+        bpf(BPF_MAP_DELETE_ELEM, attr);
+
+        // 删除本槽位遗留的离核记录(线程退出时的最后一次离核不会被结算)
+        uint32_t key = 0, next_key = 0;
+        OffCpuStart start;
+        bool first = true;
+        vector<uint32_t> stale;
+        while (true)
+        {
+            memset(&attr, 0, sizeof(attr));
+            attr.map_fd = static_cast<uint32_t>(start_fd);
+            attr.key = first ? 0 : reinterpret_cast<uintptr_t>(&key);
+            attr.next_key = reinterpret_cast<uintptr_t>(&next_key);
+            if (bpf(BPF_MAP_GET_NEXT_KEY, attr) != 0)
+                break;
+            first = false;
+            key = next_key;
+            memset(&attr, 0, sizeof(attr));
+            attr.map_fd = static_cast<uint32_t>(start_fd);
+            attr.key = reinterpret_cast<uintptr_t>(&key);
+            attr.value = reinterpret_cast<uintptr_t>(&start);
+            if (bpf(BPF_MAP_LOOKUP_ELEM, attr) == 0 && start.slot == static_cast<uint32_t>(slot))
+                stale.push_back(key);
+        }
+        for (uint32_t tid : stale)
+        {
+            memset(&attr, 0, sizeof(attr));
+            attr.map_fd = static_cast<uint32_t>(start_fd);
+            attr.key = reinterpret_cast<uintptr_t>(&tid);
+            bpf(BPF_MAP_DELETE_ELEM, attr);
+        }
+
+        SyscallProfile profile;
+        JobArena &arena = JobArena::current();
+        uint64_t *slot_counts = counts + static_cast<size_t>(slot) * SYSCALL_SLOTS;
+        long long values[SYSCALL_SLOTS];
+        size_t nonzero = 0;
+        for (int nr = 0; nr < SYSCALL_SLOTS; nr++)
+        {
+            values[nr] = static_cast<long long>(__atomic_exchange_n(&slot_counts[nr], 0, __ATOMIC_RELAXED));
+            nonzero += values[nr] != 0;
+        }
+        SyscallCount *histogram = static_cast<SyscallCount *>(arena.allocate(sizeof(SyscallCount) * max<size_t>(nonzero, 1), alignof(SyscallCount)));
+        size_t filled = 0;
+        for (int nr = 0; nr < SYSCALL_SLOTS; nr++)
+        {
+            if (values[nr] == 0)
+                continue;
+            histogram[filled++] = SyscallCount{nr, values[nr]};
+            profile.total += values[nr];
+        }
+        sort(histogram, histogram + filled, [](const SyscallCount &a, const SyscallCount &b)
+             { return a.count != b.count ? a.count > b.count : a.nr < b.nr; });
+        profile.histogram = span<const SyscallCount>(histogram, filled);
+
+        OffCpuTotal blocked = offcpu[slot * 2], runnable = offcpu[slot * 2 + 1];
+        offcpu[slot * 2] = OffCpuTotal{0, 0};
+        offcpu[slot * 2 + 1] = OffCpuTotal{0, 0};
+        profile.blocked_us = static_cast<long long>(blocked.ns / 1000);
+        profile.blocked_count = static_cast<long long>(blocked.count);
+        profile.runnable_us = static_cast<long long>(runnable.ns / 1000);
+        profile.runnable_count = static_cast<long long>(runnable.count);
+
+        lock_guard<mutex> guard(slot_mutex);
+        free_slots.push_back(slot);
+        return profile;
+    }
+};
+
+/**
+ * @struct ExecFailure
+ * @brief 子进程exec之前失败时通过状态管道上报的记录
+ */
+struct ExecFailure
+{
+    int stage; ///< 失败的步骤(ExecStage)
+    int error; ///< errno
+};
+
+/**
+ * @brief exec之前的步骤
+ */
+enum ExecStage
+{
+    EXEC_STAGE_INPUT = 1, ///< 打开输入文件
+    EXEC_STAGE_CGROUP,    ///< 加入cgroup
+    EXEC_STAGE_GATE,      ///< 等待父进程放行
+    EXEC_STAGE_EXEC,      ///< execv本身
+    EXEC_STAGE_ENV        ///< 准备确定性执行环境
+};
+
+/**
+ * @brief 子进程上报exec之前的失败并退出
+ * @param status_fd 状态管道写端
+ * @param stage 失败的步骤
+ *
+ * 只使用async-signal-safe的调用，可在多线程进程fork出的子进程中使用
+ */
+[[noreturn]] void reportExecFailure(int status_fd, int stage)
+{
+    ExecFailure failure = {stage, errno};
+    ssize_t written = write(status_fd, &failure, sizeof(failure));
+    (void)written;
+    _exit(127);
+}
+
+/**
+ * @brief 父进程等待子进程exec成功
+ * @param status_fd 状态管道读端(父进程已关闭写端)
+ * @param failure exec之前失败时填写失败记录
+ * @return bool exec成功返回true
+ *
+ * 状态管道带O_CLOEXEC：exec成功时内核关闭写端，read返回EOF的时刻即为
+ * 选手程序开始运行的时刻；exec之前任何一步失败时子进程写入ExecFailure
+ */
+bool waitForExec(int status_fd, ExecFailure &failure)
+{
+    ssize_t n;
+    do
+    {
+        n = read(status_fd, &failure, sizeof(failure));
+    } while (n == -1 && errno == EINTR);
+
+    if (n == 0)
+        return true;
+    if (n != static_cast<ssize_t>(sizeof(failure)))
+        failure = {0, n == -1 ? errno : EPROTO};
+    return false;
+}
+
+/**
+ * @brief 把exec失败记录格式化为错误信息(位于任务arena)
+ */
+string_view execFailureMessage(const ExecFailure &failure)
+{
+    string_view step;
+    switch (failure.stage)
+    {
+    case EXEC_STAGE_INPUT:
+        step = "Failed to open input file: ";
+        break;
+    case EXEC_STAGE_CGROUP:
+        step = "Failed to join cgroup: ";
+        break;
+    case EXEC_STAGE_GATE:
+        step = "Failed to wait for parent: ";
+        break;
+    case EXEC_STAGE_EXEC:
+        step = "Failed to exec program: ";
+        break;
+    case EXEC_STAGE_ENV:
+        step = "Failed to set up deterministic environment: ";
+        break;
+    default:
+        step = "Failed to read exec status: ";
+        break;
+    }
+    return JobArena::current().concat({step, strerror(failure.error)});
+}
+
+/**
+ * @brief 读取进程已消耗的CPU时间(纳秒)
+ * @return long long 失败返回-1
+ *
+ * 通过进程CPU时钟读取，进程必须尚未被回收
+ */
+long long processCpuTimeNs(pid_t pid)
+{
+    clockid_t clock;
+    struct timespec ts;
+    if (clock_getcpuclockid(pid, &clock) != 0 || clock_gettime(clock, &ts) != 0)
+        return -1;
+    return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief 读取进程主线程在运行队列中等待的累计时间(纳秒)
+ * @return long long /proc/<pid>/schedstat的第二项，失败返回-1
+ *
+ * 该值只在进程可运行却没有拿到CPU时增长，睡眠和阻塞不计入
+ * 僵尸状态下仍可读取，应在wait4回收之前读取
+ *
+ * @note 只覆盖主线程：已退出线程的schedstat不会并入进程，回收前task/下也只剩主线程，
+ *       多线程程序的等待可能被低估，此时被动切换次数(rusage含全部线程)仍然有效
+ */
+long long processRunqueueWaitNs(pid_t pid)
+{
+    char path[64];
+    char buffer[128];
+    snprintf(path, sizeof(path), "/proc/%d/schedstat", static_cast<int>(pid));
+    string_view text = readSmallFile(path, buffer, sizeof(buffer));
+    size_t space = text.find(' ');
+    if (space == string_view::npos)
+        return -1;
+    return parseLeadingNumber(text.substr(space + 1));
+}
+
+/**
+ * @brief 记录一次运行的干扰指标并按阈值标记
+ * @param wait_start_ns exec时的运行队列等待基线，-1表示未取到
+ * @param throttled_start_us exec时cgroup的throttled_usec基线，-1表示cpu控制器未启用
+ *
+ * 三项指标都说明程序在可以运行的时候没有拿到CPU，墙钟时间因此偏大：
+ *          - 运行队列等待：同核心上有其他任务(或宿主机抢占了vCPU)
+ *          - 被动上下文切换：时间片用完或被更高优先级任务抢占
+ *          - 带宽节流：cgroup的cpu.max配额耗尽
+ */
+void recordInterference(JudgeResult &result, const Limits &limits, long long wait_start_ns, long long wait_end_ns,
+                        long nivcsw, long long throttled_start_us, long long throttled_end_us)
+{
+    result.interference_checked = true;
+    if (wait_start_ns >= 0 && wait_end_ns >= wait_start_ns)
+        result.runqueue_wait_us = (wait_end_ns - wait_start_ns) / 1000;
+    result.involuntary_switches = nivcsw;
+    if (throttled_start_us >= 0 && throttled_end_us >= throttled_start_us)
+        result.throttled_usec = throttled_end_us - throttled_start_us;
+
+    JobArena &arena = JobArena::current();
+    auto flag = [&](string_view reason)
+    {
+        result.interfered = true;
+        result.interference_reason = result.interference_reason.empty()
+                                         ? reason
+                                         : arena.concat({result.interference_reason, ",", reason});
+    };
+    if (limits.interference_wait_us > 0 && result.runqueue_wait_us > limits.interference_wait_us)
+        flag("runqueue_wait");
+    if (limits.interference_nivcsw > 0 && result.involuntary_switches > limits.interference_nivcsw)
+        flag("nivcsw");
+    if (result.throttled_usec > 0)
+        flag("throttled");
+}
+
+/**
+ * @brief 确定性环境下选手程序的环境变量，与评测进程自身的环境无关
+ */
+const char *const DETERMINISTIC_ENV[] = {"PATH=/usr/bin:/bin", "LANG=C", "LC_ALL=C", "HOME=/", "PWD=/", nullptr};
+const char *const DETERMINISTIC_ARGV[] = {"./main", nullptr}; ///< 固定的argv，与可执行文件路径无关
+constexpr const char *DETERMINISTIC_CWD = "/";                ///< 固定的工作目录
+constexpr int DETERMINISTIC_EXEC_FD = 255;                   ///< execveat使用的描述符编号，AT_EXECFN固定为/dev/fd/255
+
+/**
+ * @struct PreparedRun
+ * @brief 提前准备好的运行资源，由StagedCase持有
+ */
+struct PreparedRun
+{
+    int input_fd = -1;               ///< 输入内容(memfd)，-1表示子进程按路径打开
+    CgroupManager *cgroup = nullptr; ///< 已设置内存限制、未租用核心的池化cgroup，为空时自行创建
+    int peak_fd = -1;                ///< 该cgroup的memory.peak，写入后经同一描述符只读到之后的峰值
+};
+
+/**
+ * @brief 在cgroup中运行一次程序并判定结果
+ * @param executable 可执行文件路径
+ * @param input_file 标准输入文件
+ * @param limits 资源限制
+ * @param profiler 可选的采样器；提供时在放行子进程前打开采样事件
+ * @param prepared 可选的预备资源；提供时使用其中的输入memfd和池化cgroup
+ * @return JudgeResult 运行结果
+ *
+ * @details 计时从exec成功开始：子进程完成重定向和资源限制后阻塞在gate管道上，
+ *          父进程把它加入cgroup后放行，并通过状态管道等到exec成功的时刻，
+ *          在此记录墙钟和CPU时间基线；fork、dup2、setrlimit和exec本身不计入
+ *          exec之前的任何失败都判为SE
+ */
+JudgeResult runProgram(const string &executable, const string &input_file, const Limits &limits,
+                       PerfProfiler *profiler = nullptr, const PreparedRun *prepared = nullptr)
+{
+    JudgeResult result;
+    result.status = "RE";
+    result.time_used = 0;
+    result.mem_used = 0;
+    result.exit_code = -1;
+    result.output_len = 0;
+    result.allocated_cpu = "";
+
+    JobArena &arena = JobArena::current();
+
+    // 创建cgroup(已预备池化cgroup时直接使用，只需租用核心)
+    bool pooled = prepared != nullptr && prepared->cgroup != nullptr;
+    optional<CgroupManager> own_cgroup;
+    CgroupManager &cgroup = pooled ? *prepared->cgroup : own_cgroup.emplace();
+    if (!pooled && !cgroup.create())
+    {
+        result.error_message = "Failed to create cgroup (需要root权限)";
+        return result;
+    }
+
+    // 设置内存限制
+    if (!pooled && !cgroup.setMemoryLimit(limits.memory_limit))
+    {
+        result.error_message = "Failed to set memory limit in cgroup";
+        return result;
+    }
+
+    // 进程数限制：RLIMIT_NPROC对root不生效，由pids.max限制fork
+    if (!pooled && !cgroup.setProcessLimit(limits.process_limit))
+    {
+        result.error_message = "Failed to set process limit in cgroup";
+        return result;
+    }
+
+    // 设置CPU限制为单核心，内存密集的程序避开已有内存密集运行的LLC域
+    bool memory_heavy = limits.memory_class == 1 ||
+                        (limits.memory_class == 0 && MemoryTraffic::observedHeavy(executable));
+    if (!cgroup.setCpuLimit(limits, memory_heavy))
+    {
+        result.error_message = limits.cpufreq_guard == 2 ? "Failed to set CPU limit in cgroup (all judge cores throttled?)"
+                                                          : "Failed to set CPU limit in cgroup";
+        return result;
+    }
+
+    // 获取分配的CPU核心信息
+    result.allocated_cpu = cgroup.getAllocatedCpu();
+    result.contention_checked = true;
+    result.memory_heavy = memory_heavy;
+    result.heavy_neighbor = cgroup.hasHeavyNeighbor();
+    result.llc_domain = CpuLease::llcDomain(cgroup.getLeasedCpu());
+
+    // 记录运行开始前核心的调频状态
+    CpuFreqState freq_before;
+    if (limits.cpufreq_guard > 0)
+    {
+        freq_before = CpuFreqGuard::read(cgroup.getLeasedCpu());
+    }
+
+    // 创建管道用于获取输出
+    int stdout_pipe[2];
+    int stderr_pipe[2];
+
+    // 管道带O_CLOEXEC：并行运行时不会泄漏给其他线程fork出的子进程
+    if (pipe2(stdout_pipe, O_CLOEXEC) == -1 || pipe2(stderr_pipe, O_CLOEXEC) == -1)
+    {
+        result.error_message = "Failed to create pipes";
+        return result;
+    }
+
+    // 子进程在exec前阻塞在gate管道上，等父进程把它加入cgroup(以及打开perf事件)
+    // exec状态管道带O_CLOEXEC，exec成功时自动关闭
+    int gate_pipe[2] = {-1, -1};
+    int exec_pipe[2] = {-1, -1};
+    if (pipe2(gate_pipe, O_CLOEXEC) == -1 || pipe2(exec_pipe, O_CLOEXEC) == -1)
+    {
+        result.error_message = "Failed to create pipes";
+        for (int fd : {stdout_pipe[0], stdout_pipe[1], stderr_pipe[0], stderr_pipe[1], gate_pipe[0], gate_pipe[1]})
+        {
+            if (fd != -1)
+                close(fd);
+        }
+        return result;
+    }
+
+    // 预备的输入从头读起；池化cgroup的峰值内存从本次运行开始统计
+    int staged_input = prepared != nullptr ? prepared->input_fd : -1;
+    if (staged_input != -1)
+        lseek(staged_input, 0, SEEK_SET);
+    if (pooled && pwrite(prepared->peak_fd, "reset\n", 6, 0) != 6)
+    {
+        result.error_message = "Failed to reset memory.peak of pooled cgroup";
+        for (int fd : {stdout_pipe[0], stdout_pipe[1], stderr_pipe[0], stderr_pipe[1], gate_pipe[0], gate_pipe[1], exec_pipe[0], exec_pipe[1]})
+        {
+            close(fd);
+        }
+        return result;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        result.error_message = "Failed to fork process";
+        for (int fd : {stdout_pipe[0], stdout_pipe[1], stderr_pipe[0], stderr_pipe[1], gate_pipe[0], gate_pipe[1], exec_pipe[0], exec_pipe[1]})
+        {
+            close(fd);
+        }
+        return result;
+    }
+
+    if (pid == 0)
+    {
+        // 子进程
+
+        // 重定向标准输入
+        close(exec_pipe[0]);
+        int input_fd = staged_input != -1 ? staged_input : open(input_file.c_str(), O_RDONLY);
+        if (input_fd == -1)
+        {
+            reportExecFailure(exec_pipe[1], EXEC_STAGE_INPUT);
+        }
+        dup2(input_fd, STDIN_FILENO);
+        if (input_fd != staged_input)
+            close(input_fd);
+
+        // 重定向标准输出和错误输出
+        dup2(stdout_pipe[1], STDOUT_FILENO);
+        dup2(stderr_pipe[1], STDERR_FILENO);
+        close(stdout_pipe[0]);
+        close(stdout_pipe[1]);
+        close(stderr_pipe[0]);
+        close(stderr_pipe[1]);
+
+        // 设置资源限制
+        struct rlimit rl;
+
+        // 时间限制 (CPU时间)
+        rl.rlim_cur = (limits.time_limit + 999) / 1000; // 向上取整到秒
+        rl.rlim_max = rl.rlim_cur + 1;
+        setrlimit(RLIMIT_CPU, &rl);
+
+        // 栈限制
+        rl.rlim_cur = limits.stack_limit;
+        rl.rlim_max = limits.stack_limit;
+        setrlimit(RLIMIT_STACK, &rl);
+
+        // 输出限制
+        rl.rlim_cur = limits.output_limit;
+        rl.rlim_max = limits.output_limit;
+        setrlimit(RLIMIT_FSIZE, &rl);
+
+        // 进程数限制(只对非root生效，root下由cgroup的pids.max限制)
+        rl.rlim_cur = 1;
+        rl.rlim_max = 1;
+        setrlimit(RLIMIT_NPROC, &rl);
+
+        // gate写端子进程用不到，先关闭，避免它恰好占用固定编号时被dup3替换后误关
+        close(gate_pipe[1]);
+
+        // 确定性环境：固定工作目录，按固定编号打开可执行文件，关闭地址随机化
+        if (limits.deterministic_env == 1)
+        {
+            // 仍要使用的gate读端和状态管道写端若恰好占用固定编号，先移到别处，不能被dup3静默替换
+            for (int *fd : {&gate_pipe[0], &exec_pipe[1]})
+            {
+                if (*fd != DETERMINISTIC_EXEC_FD)
+                    continue;
+                int moved = fcntl(*fd, F_DUPFD_CLOEXEC, 3);
+                if (moved == -1)
+                    reportExecFailure(exec_pipe[1], EXEC_STAGE_ENV);
+                close(*fd);
+                *fd = moved;
+            }
+            int exe_fd = open(executable.c_str(), O_RDONLY | O_CLOEXEC);
+            if (exe_fd == -1 || chdir(DETERMINISTIC_CWD) != 0 ||
+                (exe_fd != DETERMINISTIC_EXEC_FD && dup3(exe_fd, DETERMINISTIC_EXEC_FD, O_CLOEXEC) == -1))
+            {
+                reportExecFailure(exec_pipe[1], EXEC_STAGE_ENV);
+            }
+            if (exe_fd != DETERMINISTIC_EXEC_FD)
+                close(exe_fd);
+        }
+        if (limits.disable_aslr == 1)
+        {
+            int persona = personality(0xffffffff);
+            if (persona == -1 || personality(static_cast<unsigned long>(persona) | ADDR_NO_RANDOMIZE) == -1)
+                reportExecFailure(exec_pipe[1], EXEC_STAGE_ENV);
+        }
+
+        // 等待父进程完成cgroup和采样器设置
+        char go;
+        if (read(gate_pipe[0], &go, 1) != 1)
+        {
+            reportExecFailure(exec_pipe[1], EXEC_STAGE_GATE);
+        }
+
+        // 执行程序(失败时并行运行的父进程有多个线程，不能执行atexit清理)
+        // 确定性环境下环境变量、argv和AT_EXECFN都是固定的，初始栈布局与评测进程的环境和路径无关
+        if (limits.deterministic_env == 1)
+            syscall(SYS_execveat, DETERMINISTIC_EXEC_FD, "", DETERMINISTIC_ARGV, DETERMINISTIC_ENV, AT_EMPTY_PATH);
+        else
+            execl(executable.c_str(), executable.c_str(), (char *)nullptr);
+        reportExecFailure(exec_pipe[1], EXEC_STAGE_EXEC);
+    }
+    else
+    {
+        // 父进程
+
+        // 将子进程添加到cgroup
+        if (!cgroup.addProcess(pid))
+        {
+            result.error_message = "Failed to add process to cgroup";
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            for (int fd : {stdout_pipe[0], stdout_pipe[1], stderr_pipe[0], stderr_pipe[1], gate_pipe[0], gate_pipe[1], exec_pipe[0], exec_pipe[1]})
+            {
+                close(fd);
+            }
+            return result;
+        }
+
+        // 强制CPU绑定到分配的核心
+        string_view allocated_cpu_str = result.allocated_cpu;
+        if (!allocated_cpu_str.empty())
+        {
+            int allocated_cpu_id = static_cast<int>(parseLeadingNumber(allocated_cpu_str));
+            if (!cgroup.forceCpuBinding(pid, allocated_cpu_id))
+            {
+                // CPU绑定失败不中止评测，但记录警告
+                result.error_message = arena.concat({result.error_message, "Warning: Failed to set CPU affinity; "});
+            }
+        }
+
+        // 放行前登记系统调用统计槽位，动态链接器在exec之后的启动调用也计入
+        int trace_slot = -1;
+        uint64_t cgroup_id = 0;
+        if (limits.syscall_trace == 1)
+        {
+            SyscallTracer &tracer = SyscallTracer::instance();
+            cgroup_id = cgroup.getCgroupId();
+            trace_slot = tracer.watch(cgroup_id);
+            if (trace_slot < 0)
+                result.syscall_trace_error = !tracer.initError().empty() ? arena.store(tracer.initError())
+                                                                         : string_view("No free trace slot");
+        }
+
+        // 打开采样和计数事件后放行子进程
+        if (profiler != nullptr)
+        {
+            profiler->attach(pid, executable);
+        }
+        MemoryTraffic traffic;
+        traffic.attach(pid);
+        close(gate_pipe[0]);
+        ssize_t released = write(gate_pipe[1], "g", 1);
+        (void)released; // 写入失败时子进程读到EOF，经状态管道上报
+        close(gate_pipe[1]);
+
+        close(stdout_pipe[1]);
+        close(stderr_pipe[1]);
+        close(exec_pipe[1]);
+
+        // exec成功的时刻作为墙钟和CPU时间的基线
+        ExecFailure failure;
+        bool exec_ok = waitForExec(exec_pipe[0], failure);
+        close(exec_pipe[0]);
+        auto start_time = high_resolution_clock::now();
+        long long cpu_start_ns = exec_ok ? processCpuTimeNs(pid) : -1;
+        long long wait_start_ns = exec_ok ? processRunqueueWaitNs(pid) : -1;
+        long long throttled_start_us = exec_ok ? cgroup.getCpuStat("throttled_usec") : -1;
+        if (!exec_ok)
+        {
+            result.status = "SE";
+            result.error_message = execFailureMessage(failure);
+            waitpid(pid, nullptr, 0);
+            if (trace_slot >= 0)
+                SyscallTracer::instance().collect(trace_slot, cgroup_id); // 只为归还槽位
+            close(stdout_pipe[0]);
+            close(stderr_pipe[0]);
+            return result;
+        }
+
+        // 监督循环：按固定节拍读取输出并检查墙钟时间和CPU进度
+        // 子进程关闭输出后仍通过pidfd等待它退出，不会阻塞在wait4上
+        int pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        long long wall_limit_ms = ((limits.time_limit + 999) / 1000 + 1) * 1000LL;
+        constexpr int TICK_MS = 50;         ///< 监督节拍
+        constexpr double IDLE_RATIO = 0.05; ///< CPU进度低于墙钟进度的该比例视为空等
+
+        // 从缓冲区池签出捕获缓冲区，超过输出限制的部分只计数不保存
+        // stderr只用于错误信息，只保留开头STDERR_KEEP字节，其余照常读出丢弃
+        constexpr size_t STDERR_KEEP = 64UL << 10;
+        CaptureBuffer stdout_capture(static_cast<size_t>(limits.output_limit) + 1);
+        CaptureBuffer stderr_capture(min(static_cast<size_t>(limits.output_limit) + 1, STDERR_KEEP));
+        bool stdout_done = false, stderr_done = false, exited = false;
+        bool idle_killed = false, wall_killed = false, supervision_failed = false;
+
+        // CPU进度优先取cgroup的cpu.stat，不可用时退回进程CPU时钟
+        auto cpu_usage_us = [&cgroup, pid]()
+        {
+            long long usage = cgroup.getCpuUsageUs();
+            if (usage < 0)
+            {
+                long long process_ns = processCpuTimeNs(pid);
+                usage = process_ns < 0 ? -1 : process_ns / 1000;
+            }
+            return usage;
+        };
+        auto last_tick = start_time;
+        auto idle_since = start_time;
+        long long last_cpu_us = cpu_usage_us();
+        long long loaded_khz_min = -1, loaded_khz_max = -1;
+
+        while (!stdout_done || !stderr_done || !exited)
+        {
+            struct pollfd fds[4];
+            nfds_t count = 0;
+            int stdout_index = -1, stderr_index = -1, perf_index = -1, pid_index = -1;
+            if (!stdout_done)
+            {
+                stdout_index = static_cast<int>(count);
+                fds[count++] = {stdout_pipe[0], POLLIN, 0};
+            }
+            if (!stderr_done)
+            {
+                stderr_index = static_cast<int>(count);
+                fds[count++] = {stderr_pipe[0], POLLIN, 0};
+            }
+            int perf_fd = profiler != nullptr ? profiler->fd() : -1;
+            if (perf_fd != -1)
+            {
+                perf_index = static_cast<int>(count);
+                fds[count++] = {perf_fd, POLLIN, 0};
+            }
+            if (!exited && pid_fd != -1)
+            {
+                pid_index = static_cast<int>(count);
+                fds[count++] = {pid_fd, POLLIN, 0};
+            }
+
+            int poll_result = poll(fds, count, TICK_MS);
+            if (poll_result < 0 && errno != EINTR)
+            {
+                // 无法继续监督：先杀死子进程，之后的waitid/wait4不会无限期阻塞
+                if (!exited)
+                {
+                    kill(pid, SIGKILL);
+                    supervision_failed = true;
+                }
+                break;
+            }
+            if (poll_result == 0 && exited)
+                break; // 子进程已退出但管道仍未关闭，不再等待
+
+            if (poll_result > 0)
+            {
+                if (stdout_index >= 0 && fds[stdout_index].revents != 0 && stdout_capture.readFrom(stdout_pipe[0]) <= 0)
+                    stdout_done = true;
+                if (stderr_index >= 0 && fds[stderr_index].revents != 0 && stderr_capture.readFrom(stderr_pipe[0]) <= 0)
+                    stderr_done = true;
+                if (perf_index >= 0 && fds[perf_index].revents != 0)
+                    profiler->drain();
+                if (pid_index >= 0 && fds[pid_index].revents != 0)
+                    exited = true;
+            }
+            if (pid_fd == -1 && !exited)
+            {
+                // 不支持pidfd的内核：每个节拍非阻塞地检查一次
+                siginfo_t info = {};
+                exited = waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid;
+            }
+            if (exited || idle_killed || wall_killed)
+                continue;
+
+            auto now = high_resolution_clock::now();
+            long long tick_ms = duration_cast<milliseconds>(now - last_tick).count();
+            if (tick_ms < TICK_MS)
+                continue;
+
+            // 墙钟时间上限
+            if (duration_cast<milliseconds>(now - start_time).count() >= wall_limit_ms)
+            {
+                kill(pid, SIGKILL);
+                wall_killed = true;
+                continue;
+            }
+
+            // CPU进度远低于墙钟进度(睡眠、死锁、等待永远不会到来的输入)时累计空等时间
+            long long cpu_us = cpu_usage_us();
+            if (cpu_us >= 0 && last_cpu_us >= 0 && static_cast<double>(cpu_us - last_cpu_us) >= IDLE_RATIO * tick_ms * 1000)
+                idle_since = now;
+            // 程序在本节拍中至少占用了一半CPU时才采样频率，此时读数反映负载下的频率
+            if (limits.cpufreq_guard > 0 && cpu_us >= 0 && last_cpu_us >= 0 && (cpu_us - last_cpu_us) * 2 >= tick_ms * 1000)
+            {
+                long long khz = CpuFreqGuard::currentKhz(cgroup.getLeasedCpu());
+                if (khz > 0)
+                {
+                    loaded_khz_min = loaded_khz_min < 0 ? khz : min(loaded_khz_min, khz);
+                    loaded_khz_max = max(loaded_khz_max, khz);
+                }
+            }
+            last_cpu_us = cpu_us;
+            last_tick = now;
+            if (limits.idle_limit > 0 && cpu_us >= 0 && duration_cast<milliseconds>(now - idle_since).count() >= limits.idle_limit)
+            {
+                kill(pid, SIGKILL);
+                idle_killed = true;
+            }
+        }
+
+        close(stdout_pipe[0]);
+        close(stderr_pipe[0]);
+        if (pid_fd != -1)
+            close(pid_fd);
+
+        // 回收前读取调度统计：等到子进程变为僵尸但不回收，/proc/<pid>仍然存在
+        // 结束时刻在看到退出时立即记录，之后的统计读取和系统调用采集不计入time_used
+        siginfo_t exit_info = {};
+        waitid(P_PID, pid, &exit_info, WEXITED | WNOWAIT);
+        auto end_time = high_resolution_clock::now();
+        long long wait_end_ns = processRunqueueWaitNs(pid);
+        long long throttled_end_us = cgroup.getCpuStat("throttled_usec");
+        if (trace_slot >= 0)
+        {
+            result.syscalls = SyscallTracer::instance().collect(trace_slot, cgroup_id);
+            result.syscalls_traced = true;
+        }
+
+        // 回收子进程
+        int status;
+        struct rusage usage;
+        if (wait4(pid, &status, 0, &usage) == -1)
+        {
+            result.error_message = "Failed to wait for child process";
+            return result;
+        }
+
+        long long elapsed_us = duration_cast<microseconds>(end_time - start_time).count();
+        result.llc_misses = traffic.misses();
+        if (result.llc_misses >= 0 && elapsed_us > 0)
+        {
+            // 每次未命中按一条64字节缓存行计，字节/微秒即MB/s
+            result.miss_bandwidth_mbps = result.llc_misses * 64 / elapsed_us;
+            if (elapsed_us >= 10000 && result.miss_bandwidth_mbps >= limits.memory_heavy_mbps)
+                MemoryTraffic::markHeavy(executable);
+        }
+        recordInterference(result, limits, wait_start_ns, wait_end_ns, usage.ru_nivcsw,
+                           throttled_start_us, throttled_end_us);
+        result.time_used = duration_cast<milliseconds>(end_time - start_time).count();
+        if (cpu_start_ns >= 0)
+        {
+            long long cpu_end_ns = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000LL +
+                                   (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000LL;
+            result.cpu_time_used = max(0LL, cpu_end_ns - cpu_start_ns) / 1000000;
+        }
+
+        if (profiler != nullptr)
+        {
+            profiler->drain();
+        }
+
+        // 记录运行期间核心的频率范围和降频情况
+        if (limits.cpufreq_guard > 0)
+        {
+            CpuFreqState freq_after = CpuFreqGuard::read(cgroup.getLeasedCpu());
+            result.cpufreq_checked = true;
+            result.cpu_governor = arena.store(freq_before.governor);
+            result.cpu_boost = freq_after.boost;
+            result.cpu_freq_min_khz = loaded_khz_min;
+            result.cpu_freq_max_khz = loaded_khz_max;
+            result.cpu_throttled = CpuFreqGuard::isCapped(freq_after, limits.cpufreq_min_percent) ||
+                                   CpuFreqGuard::isSlow(loaded_khz_min, freq_before, limits.cpufreq_min_percent) ||
+                                   (freq_before.throttle_count >= 0 && freq_after.throttle_count > freq_before.throttle_count);
+        }
+
+        // 子进程已回收：读出峰值内存后立即清空并删除cgroup、归还核心(cleanup先杀死
+        // 残留的后代进程)，之后的判定、输出复制和结果编码不再占用独占核心
+        long long memory_peak;
+        if (pooled)
+        {
+            char peak_text[64];
+            ssize_t n = pread(prepared->peak_fd, peak_text, sizeof(peak_text), 0);
+            memory_peak = n > 0 ? parseLeadingNumber(string_view(peak_text, static_cast<size_t>(n))) : -1;
+            // 池化cgroup在归还核心前同样要清空，残留进程不能留在下一次运行的核心上
+            if (!cgroup.killAll())
+                cerr << "Cgroup " << cgroup.getName() << " still populated after cgroup.kill" << endl;
+            cgroup.releaseCpu();
+        }
+        else
+        {
+            memory_peak = cgroup.getMemoryPeak();
+            cgroup.cleanup();
+        }
+
+        // 按主机速度系数折算到参考机器，开启normalize_time时用折算值判定
+        result.time_used_raw = result.time_used;
+        if (limits.speed_reference > 0)
+        {
+            result.host_speed_factor = limits.host_speed_factor;
+            result.time_used_normalized = llround(static_cast<double>(result.time_used) / limits.host_speed_factor);
+            if (limits.normalize_time == 1)
+            {
+                result.time_used = result.time_used_normalized;
+            }
+        }
+
+        result.mem_used = (memory_peak > 0) ? memory_peak : usage.ru_maxrss * 1024; // ru_maxrss 是 KB，需转bit
+
+        result.stdout_content = arena.store(stdout_capture.view());
+        result.output_len = static_cast<int>(min<size_t>(stdout_capture.totalBytes(), INT_MAX));
+        string_view stderr_output = stderr_capture.view();
+
+        // 判断退出状态
+        if (WIFEXITED(status))
+        {
+            result.exit_code = WEXITSTATUS(status);
+            if (result.exit_code == 0)
+            {
+                // 检查是否超时
+                if (result.time_used > limits.time_limit)
+                {
+                    result.status = "TLE";
+                }
+                // 检查内存限制
+                else if (result.mem_used > limits.memory_limit)
+                {
+                    result.status = "MLE";
+                }
+                // 检查输出限制
+                else if (result.output_len > limits.output_limit)
+                {
+                    result.status = "OLE";
+                }
+                else
+                {
+                    result.status = "OK";
+                }
+            }
+            else
+            {
+                result.status = "RE";
+                result.error_message = arena.concat({"Program exited with non-zero code: ", arena.number(result.exit_code)});
+                if (!stderr_output.empty())
+                {
+                    result.error_message = arena.concat({result.error_message, "\\nStderr: ", stderr_output});
+                }
+            }
+        }
+        else if (WIFSIGNALED(status))
+        {
+            int signal_num = WTERMSIG(status);
+            result.exit_code = 128 + signal_num;
+
+            switch (signal_num)
+            {
+            case SIGXCPU:
+                result.status = "TLE";
+                result.error_message = "Time limit exceeded (SIGXCPU)";
+                break;
+            case SIGKILL:
+                // 可能是内存限制、时间限制或被监督循环杀死
+                if (supervision_failed)
+                {
+                    result.status = "SE";
+                    result.error_message = "Supervision poll failed, program killed";
+                }
+                else if (idle_killed)
+                {
+                    result.status = "ILE";
+                    result.error_message = arena.concat({"Idleness limit exceeded (no CPU progress for ",
+                                                         arena.number(limits.idle_limit), "ms)"});
+                }
+                else if (wall_killed)
+                {
+                    result.status = "TLE";
+                    result.error_message = "Wall time limit exceeded";
+                }
+                else if (result.mem_used > limits.memory_limit)
+                {
+                    result.status = "MLE";
+                    result.error_message = "Memory limit exceeded (cgroup)";
+                }
+                else
+                {
+                    result.status = "TLE";
+                    result.error_message = "Time limit exceeded (SIGKILL)";
+                }
+                break;
+            case SIGSEGV:
+                result.status = "RE";
+                result.error_message = "Segmentation fault";
+                break;
+            case SIGFPE:
+                result.status = "RE";
+                result.error_message = "Floating point exception";
+                break;
+            case SIGABRT:
+                // 检查是否是内存限制导致的
+                if (result.mem_used > limits.memory_limit)
+                {
+                    result.status = "MLE";
+                    result.error_message = "Memory limit exceeded (allocation failed)";
+                }
+                else
+                {
+                    result.status = "RE";
+                    result.error_message = "Program aborted";
+                }
+                break;
+            default:
+                result.status = "RE";
+                result.error_message = arena.concat({"Program terminated by signal ", arena.number(signal_num)});
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief 按空白分隔的记号比较两份输出
+ * @param output 选手输出
+ * @param answer 标准输出
+ * @return bool 记号序列完全相同返回true
+ *
+ * 忽略行末空格、空行和文件末尾换行的差异，与常见OJ的默认比较方式一致
+ */
+bool compareTokens(string_view output, string_view answer)
+{
+    auto is_space = [](char c)
+    { return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f'; };
+
+    size_t i = 0, j = 0;
+    while (true)
+    {
+        while (i < output.size() && is_space(output[i]))
+            i++;
+        while (j < answer.size() && is_space(answer[j]))
+            j++;
+        if (i == output.size() || j == answer.size())
+            return i == output.size() && j == answer.size();
+
+        size_t output_end = i, answer_end = j;
+        while (output_end < output.size() && !is_space(output[output_end]))
+            output_end++;
+        while (answer_end < answer.size() && !is_space(answer[answer_end]))
+            answer_end++;
+        if (output.substr(i, output_end - i) != answer.substr(j, answer_end - j))
+            return false;
+        i = output_end;
+        j = answer_end;
+    }
+}
+
+/**
+ * @brief 在已配置好的cgroup中运行一次程序，标准输入输出使用给定的描述符
+ * @param cgroup 已创建并设置好内存/CPU限制的cgroup，可跨多次运行复用
+ * @param executable 可执行文件路径
+ * @param arguments 传给程序的参数(不含argv[0])，最多8个
+ * @param input_fd 标准输入，为-1时使用/dev/null
+ * @param output_fd 标准输出
+ * @param limits 资源限制
+ * @param error_fd 标准错误，为-1时使用/dev/null
+ * @return JudgeResult 只填写status、time_used、mem_used、exit_code；exec之前失败时为SE
+ *
+ * 供对拍等需要高频运行的场景使用：不创建cgroup、不建管道，
+ * 子进程自行加入cgroup，父进程通过pidfd等待，超过时限后直接杀死
+ * 回收后杀死程序留在cgroup中的后代进程，cgroup复用时不会带入下一次运行
+ *
+ * @note 热路径上不使用任务arena，可在循环中无限次调用
+ */
+JudgeResult runInSandbox(const CgroupManager &cgroup, const char *executable, span<const char *const> arguments,
+                         int input_fd, int output_fd, const Limits &limits, int error_fd = -1)
+{
+    JudgeResult result;
+    result.status = "SE";
+    result.exit_code = -1;
+
+    char procs_path[PATH_MAX];
+    cgroup.procsPath(procs_path);
+
+    const char *argv[10] = {executable};
+    for (size_t i = 0; i < arguments.size() && i < 8; i++)
+        argv[i + 1] = arguments[i];
+
+    // exec状态管道：exec成功时自动关闭，计时从此刻开始
+    int exec_pipe[2];
+    if (pipe2(exec_pipe, O_CLOEXEC) == -1)
+    {
+        return result;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(exec_pipe[0]);
+        close(exec_pipe[1]);
+        return result;
+    }
+
+    if (pid == 0)
+    {
+        close(exec_pipe[0]);
+        int procs_fd = open(procs_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (procs_fd == -1 || write(procs_fd, "0", 1) != 1)
+        {
+            reportExecFailure(exec_pipe[1], EXEC_STAGE_CGROUP);
+        }
+        close(procs_fd);
+
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(input_fd != -1 ? input_fd : null_fd, STDIN_FILENO);
+        dup2(output_fd, STDOUT_FILENO);
+        dup2(error_fd != -1 ? error_fd : null_fd, STDERR_FILENO);
+
+        struct rlimit rl;
+        rl.rlim_cur = (limits.time_limit + 999) / 1000;
+        rl.rlim_max = rl.rlim_cur + 1;
+        setrlimit(RLIMIT_CPU, &rl);
+        rl.rlim_cur = rl.rlim_max = limits.stack_limit;
+        setrlimit(RLIMIT_STACK, &rl);
+        rl.rlim_cur = rl.rlim_max = limits.output_limit;
+        setrlimit(RLIMIT_FSIZE, &rl);
+
+        execv(executable, const_cast<char *const *>(argv));
+        reportExecFailure(exec_pipe[1], EXEC_STAGE_EXEC);
+    }
+
+    close(exec_pipe[1]);
+    ExecFailure failure;
+    bool exec_ok = waitForExec(exec_pipe[0], failure);
+    close(exec_pipe[0]);
+    auto start_time = high_resolution_clock::now();
+    if (!exec_ok)
+    {
+        waitpid(pid, nullptr, 0);
+        return result;
+    }
+
+    // 通过pidfd等待，墙钟时间超过时限(留100ms余量)后杀死
+    // 被信号打断时按剩余时间继续等待；poll出错或不支持pidfd时同样杀死，不会阻塞在wait4上
+    bool killed = false;
+    int pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    auto deadline = start_time + milliseconds(limits.time_limit + 100);
+    while (true)
+    {
+        long long remaining_ms = duration_cast<milliseconds>(deadline - high_resolution_clock::now()).count();
+        int poll_result = 0;
+        if (remaining_ms > 0 && pid_fd != -1)
+        {
+            struct pollfd waiter = {pid_fd, POLLIN, 0};
+            poll_result = poll(&waiter, 1, static_cast<int>(remaining_ms));
+            if (poll_result < 0 && errno == EINTR)
+                continue;
+        }
+        else if (remaining_ms > 0)
+        {
+            // 不支持pidfd的内核：每10ms非阻塞地检查一次
+            siginfo_t info = {};
+            if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid)
+                break;
+            usleep(static_cast<useconds_t>(min(remaining_ms, 10LL) * 1000));
+            continue;
+        }
+        if (poll_result > 0)
+            break;
+        kill(pid, SIGKILL);
+        killed = true;
+        break;
+    }
+    if (pid_fd != -1)
+        close(pid_fd);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) == -1)
+    {
+        return result;
+    }
+
+    result.time_used = duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count();
+    result.mem_used = usage.ru_maxrss * 1024;
+    if (!cgroup.killAll())
+    {
+        result.status = "SE";
+        return result;
+    }
+
+    if (WIFEXITED(status))
+    {
+        result.exit_code = WEXITSTATUS(status);
+        if (result.exit_code != 0)
+            result.status = "RE";
+        else if (result.time_used > limits.time_limit)
+            result.status = "TLE";
+        else
+            result.status = "OK";
+    }
+    else
+    {
+        int signal_num = WTERMSIG(status);
+        result.exit_code = 128 + signal_num;
+        if (killed || signal_num == SIGXCPU)
+            result.status = "TLE";
+        else if (signal_num == SIGXFSZ)
+            result.status = "OLE";
+        else if (signal_num == SIGKILL)
+            result.status = "MLE";
+        else
+            result.status = "RE";
+    }
+    return result;
+}
+
+/**
+ * @brief 读取memfd的全部内容到缓冲区
+ * @return string_view 指向buffer的视图
+ */
+string_view readWholeFd(int fd, vector<char> &buffer)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return {};
+    buffer.resize(static_cast<size_t>(st.st_size));
+    size_t done = 0;
+    while (done < buffer.size())
+    {
+        ssize_t n = pread(fd, buffer.data() + done, buffer.size() - done, static_cast<off_t>(done));
+        if (n <= 0)
+            break;
+        done += static_cast<size_t>(n);
+    }
+    return string_view(buffer.data(), done);
+}
+
+/**
+ * @brief 清空memfd并把读写位置移回开头
+ */
+void rewindFd(int fd, bool truncate)
+{
+    if (truncate && ftruncate(fd, 0) != 0)
+        return;
+    lseek(fd, 0, SEEK_SET);
+}
+
+/**
+ * @class MappedFile
+ * @brief 只读映射整个文件
+ *
+ * 测试输入和标准答案按需映射，checker直接读取页缓存，不复制到堆上
+ */
+class MappedFile
+{
+private:
+    void *data = nullptr; ///< 映射起始地址
+    size_t size = 0;      ///< 文件长度
+    bool ok = false;      ///< 是否成功打开
+
+public:
+    explicit MappedFile(const char *path)
+    {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+        {
+            size = static_cast<size_t>(st.st_size);
+            data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+            ok = data != MAP_FAILED;
+            if (!ok)
+                data = nullptr;
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data != nullptr)
+            munmap(data, size);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * @brief 文件是否成功映射(空文件也算成功)
+     */
+    bool valid() const { return ok; }
+
+    /**
+     * @brief 获取文件内容视图
+     */
+    string_view view() const { return string_view(static_cast<const char *>(data), data != nullptr ? size : 0); }
+};
+
+/**
+ * @class WarmBinary
+ * @brief 在计时开始前把可执行文件及其依赖的共享库读入页缓存
+ *
+ * 刚编译出的可执行文件和冷启动时的libstdc++等共享库第一次运行时要从磁盘读入，
+ * 这部分开销会落在第一个测试点的time_used里；预读后各测试点在相同的热缓存下运行
+ *
+ * @details 预读方式：
+ *          - 沿PT_INTERP和DT_NEEDED递归解析依赖，按DT_RUNPATH/DT_RPATH和系统库目录查找
+ *          - 每个文件以MAP_POPULATE只读映射，映射保持到对象析构，期间页面不会被当作未使用页优先回收
+ *          - mode为2时另外mlock，内存紧张时也不会被换出(需要root或足够的RLIMIT_MEMLOCK)
+ *
+ * @note 只解析64位ELF；找不到的库直接跳过，由动态链接器在运行时报错
+ */
+class WarmBinary
+{
+private:
+    vector<pair<void *, size_t>> mappings; ///< 保持中的映射
+    vector<string> files;                  ///< 已处理的路径
+    vector<pair<dev_t, ino_t>> inodes;     ///< 已预读的文件(同一文件可能经不同路径引用)
+    size_t total_bytes = 0;                ///< 预读的总字节数
+
+    /**
+     * @brief 把虚拟地址换算为文件偏移
+     * @return size_t 不在任何PT_LOAD段中时返回SIZE_MAX
+     */
+    static size_t fileOffset(const Elf64_Phdr *phdrs, int count, uint64_t address)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (phdrs[i].p_type == PT_LOAD && address >= phdrs[i].p_vaddr && address < phdrs[i].p_vaddr + phdrs[i].p_filesz)
+                return static_cast<size_t>(address - phdrs[i].p_vaddr + phdrs[i].p_offset);
+        }
+        return SIZE_MAX;
+    }
+
+    /**
+     * @brief 在给定目录中查找共享库
+     * @return string 找到的路径，找不到时为空
+     */
+    static string findLibrary(string_view name, string_view runpath, string_view origin)
+    {
+        static constexpr string_view SYSTEM_DIRS[] = {
+            "/lib/x86_64-linux-gnu", "/usr/lib/x86_64-linux-gnu", "/lib/aarch64-linux-gnu", "/usr/lib/aarch64-linux-gnu",
+            "/lib64", "/usr/lib64", "/lib", "/usr/lib", "/usr/local/lib"};
+
+        auto try_dir = [&](string_view dir) -> string
+        {
+            string path(dir);
+            if (path.starts_with("$ORIGIN"))
+                path.replace(0, 7, origin);
+            path.append("/").append(name);
+            return access(path.c_str(), R_OK) == 0 ? path : string();
+        };
+
+        while (!runpath.empty())
+        {
+            size_t colon = runpath.find(':');
+            string found = try_dir(runpath.substr(0, colon));
+            if (!found.empty())
+                return found;
+            runpath = colon == string_view::npos ? string_view() : runpath.substr(colon + 1);
+        }
+        for (string_view dir : SYSTEM_DIRS)
+        {
+            string found = try_dir(dir);
+            if (!found.empty())
+                return found;
+        }
+        return string();
+    }
+
+    /**
+     * @brief 从映射好的ELF中收集依赖文件
+     */
+    static void collectDependencies(const char *image, size_t size, const string &path, vector<string> &pending)
+    {
+        const Elf64_Ehdr *ehdr = reinterpret_cast<const Elf64_Ehdr *>(image);
+        if (size < sizeof(Elf64_Ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+            ehdr->e_phentsize != sizeof(Elf64_Phdr) || ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf64_Phdr) > size)
+            return;
+
+        const Elf64_Phdr *phdrs = reinterpret_cast<const Elf64_Phdr *>(image + ehdr->e_phoff);
+        const Elf64_Phdr *dynamic = nullptr;
+        for (int i = 0; i < ehdr->e_phnum; i++)
+        {
+            if (phdrs[i].p_type == PT_INTERP && phdrs[i].p_offset + phdrs[i].p_filesz <= size)
+                pending.emplace_back(string_view(image + phdrs[i].p_offset, strnlen(image + phdrs[i].p_offset, phdrs[i].p_filesz)));
+            else if (phdrs[i].p_type == PT_DYNAMIC && phdrs[i].p_offset + phdrs[i].p_filesz <= size)
+                dynamic = &phdrs[i];
+        }
+        if (dynamic == nullptr)
+            return;
+
+        const Elf64_Dyn *entries = reinterpret_cast<const Elf64_Dyn *>(image + dynamic->p_offset);
+        size_t entry_count = dynamic->p_filesz / sizeof(Elf64_Dyn);
+        size_t strtab = SIZE_MAX;
+        uint64_t runpath_index = UINT64_MAX;
+        vector<uint64_t> needed;
+        for (size_t i = 0; i < entry_count && entries[i].d_tag != DT_NULL; i++)
+        {
+            if (entries[i].d_tag == DT_STRTAB)
+                strtab = fileOffset(phdrs, ehdr->e_phnum, entries[i].d_un.d_ptr);
+            else if (entries[i].d_tag == DT_NEEDED)
+                needed.push_back(entries[i].d_un.d_val);
+            else if (entries[i].d_tag == DT_RUNPATH || (entries[i].d_tag == DT_RPATH && runpath_index == UINT64_MAX))
+                runpath_index = entries[i].d_un.d_val;
+        }
+        if (strtab >= size)
+            return;
+
+        auto string_at = [&](uint64_t index)
+        {
+            if (strtab + index >= size)
+                return string_view();
+            const char *text = image + strtab + index;
+            return string_view(text, strnlen(text, size - strtab - index));
+        };
+
+        string_view runpath = runpath_index == UINT64_MAX ? string_view() : string_at(runpath_index);
+        size_t slash = path.rfind('/');
+        string origin = slash == string::npos ? string(".") : path.substr(0, slash);
+        for (uint64_t index : needed)
+        {
+            string_view name = string_at(index);
+            if (name.empty())
+                continue;
+            if (name.find('/') != string_view::npos)
+                pending.emplace_back(name);
+            else if (string found = findLibrary(name, runpath, origin); !found.empty())
+                pending.push_back(std::move(found));
+        }
+    }
+
+public:
+    /**
+     * @brief 预读可执行文件及其依赖
+     * @param executable 可执行文件路径
+     * @param mode 1读入页缓存，2另外mlock，0不做任何事
+     */
+    WarmBinary(const string &executable, int mode)
+    {
+        if (mode <= 0)
+            return;
+
+        vector<string> pending = {executable};
+        while (!pending.empty() && files.size() < 64)
+        {
+            string path = std::move(pending.back());
+            pending.pop_back();
+            if (find(files.begin(), files.end(), path) != files.end())
+                continue;
+            files.push_back(path);
+
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                continue;
+            struct stat st;
+            void *image = MAP_FAILED;
+            if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+                find(inodes.begin(), inodes.end(), make_pair(st.st_dev, st.st_ino)) == inodes.end())
+            {
+                inodes.emplace_back(st.st_dev, st.st_ino);
+                image = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            }
+            close(fd);
+            if (image == MAP_FAILED)
+                continue;
+
+            size_t size = static_cast<size_t>(st.st_size);
+            if (mode == 2)
+                mlock(image, size);
+            mappings.emplace_back(image, size);
+            total_bytes += size;
+            collectDependencies(static_cast<const char *>(image), size, path, pending);
+        }
+    }
+
+    ~WarmBinary()
+    {
+        for (auto [address, size] : mappings)
+            munmap(address, size);
+    }
+
+    WarmBinary(const WarmBinary &) = delete;
+    WarmBinary &operator=(const WarmBinary &) = delete;
+
+    size_t fileCount() const { return mappings.size(); }
+    size_t bytes() const { return total_bytes; }
+};
+
+/**
+ * @brief 加载checker插件
+ * @param path 共享库路径
+ * @param error 失败原因
+ * @return judge_checker_check_fn 检查函数，失败返回nullptr
+ *
+ * 已加载的插件按路径缓存在进程内，同一插件只dlopen一次，从不卸载
+ */
+judge_checker_check_fn loadCheckerPlugin(const string &path, string_view &error)
+{
+    static mutex plugins_mutex;
+    static unordered_map<string, judge_checker_check_fn> plugins;
+
+    lock_guard<mutex> lock(plugins_mutex);
+    auto it = plugins.find(path);
+    if (it != plugins.end())
+        return it->second;
+
+    // dlopen按路径查找时需要带目录，否则会去系统库目录中搜索
+    string load_path = path.find('/') == string::npos ? "./" + path : path;
+    void *handle = dlopen(load_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+    {
+        error = JobArena::current().store(dlerror());
+        return nullptr;
+    }
+
+    auto abi_version = reinterpret_cast<judge_checker_abi_version_fn>(dlsym(handle, "judge_checker_abi_version"));
+    auto check = reinterpret_cast<judge_checker_check_fn>(dlsym(handle, "judge_checker_check"));
+    if (abi_version == nullptr || check == nullptr || abi_version() != JUDGE_CHECKER_ABI_VERSION)
+    {
+        error = "Checker plugin does not export a compatible judge_checker ABI";
+        dlclose(handle);
+        return nullptr;
+    }
+
+    plugins[path] = check;
+    return check;
+}
+
+/**
+ * @brief 在fork出的辅助进程中调用checker插件
+ * @param plugin 共享库路径
+ * @param input_file 测试输入
+ * @param answer_file 标准答案
+ * @param limits 资源限制(使用checker_time_limit)
+ * @param result 评测结果，写入status和checker_message
+ *
+ * @details 看门狗：
+ *          - 插件在评测进程中加载一次，每次检查fork一个辅助进程调用检查函数，
+ *            不需要exec和动态链接，输入/答案映射和选手输出(任务arena)随fork继承，不复制
+ *          - 判定和信息写入与辅助进程共享的匿名映射
+ *          - 父进程通过pidfd最多等待checker_time_limit毫秒，超时即SIGKILL，
+ *            超时的检查不会在评测进程中留下继续占用CPU的线程
+ *          - 辅助进程被信号终止(插件崩溃)时判为SE，不影响评测进程
+ *          - 插件仍没有沙箱隔离，只能是受信任的代码
+ */
+void checkWithPlugin(const string &plugin, const string &input_file, const string &answer_file,
+                     const Limits &limits, JudgeResult &result)
+{
+    JobArena &arena = JobArena::current();
+    string_view error;
+    judge_checker_check_fn check = loadCheckerPlugin(plugin, error);
+    if (check == nullptr)
+    {
+        result.status = "SE";
+        result.checker_message = arena.concat({"Failed to load checker plugin: ", error});
+        return;
+    }
+
+    MappedFile input(input_file.c_str());
+    MappedFile answer(answer_file.c_str());
+    if (!input.valid() || !answer.valid())
+    {
+        result.status = "SE";
+        result.checker_message = "Failed to map input or answer file";
+        return;
+    }
+
+    struct PluginReply
+    {
+        int verdict;
+        char message[1024];
+    };
+    void *shared = mmap(nullptr, sizeof(PluginReply), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        result.status = "SE";
+        result.checker_message = "Failed to map checker plugin reply";
+        return;
+    }
+    PluginReply *reply = static_cast<PluginReply *>(shared);
+    reply->verdict = -1;
+    reply->message[0] = '\0';
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        munmap(shared, sizeof(PluginReply));
+        result.status = "SE";
+        result.checker_message = "Failed to fork checker plugin helper";
+        return;
+    }
+    if (pid == 0)
+    {
+        // 辅助进程：只调用检查函数，不执行atexit清理(父进程有多个线程)
+        string_view output = result.stdout_content;
+        int verdict = check(input.view().data(), input.view().size(), output.data(), output.size(),
+                            answer.view().data(), answer.view().size(), reply->message, sizeof(reply->message));
+        reply->message[sizeof(reply->message) - 1] = '\0';
+        reply->verdict = verdict;
+        _exit(0);
+    }
+
+    // 被信号打断时按剩余时间继续等待；poll出错或不支持pidfd时按10ms节拍检查
+    bool timed_out = false;
+    int pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    auto deadline = high_resolution_clock::now() + milliseconds(limits.checker_time_limit);
+    while (true)
+    {
+        long long remaining_ms = duration_cast<milliseconds>(deadline - high_resolution_clock::now()).count();
+        if (remaining_ms > 0 && pid_fd != -1)
+        {
+            struct pollfd waiter = {pid_fd, POLLIN, 0};
+            int poll_result = poll(&waiter, 1, static_cast<int>(remaining_ms));
+            if (poll_result > 0)
+                break;
+            if (poll_result < 0 && errno == EINTR)
+                continue;
+            if (poll_result < 0)
+            {
+                close(pid_fd);
+                pid_fd = -1;
+                continue;
+            }
+        }
+        else if (remaining_ms > 0)
+        {
+            siginfo_t info = {};
+            if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid)
+                break;
+            usleep(static_cast<useconds_t>(min(remaining_ms, 10LL) * 1000));
+            continue;
+        }
+        kill(pid, SIGKILL);
+        timed_out = true;
+        break;
+    }
+    if (pid_fd != -1)
+        close(pid_fd);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    int verdict = reply->verdict;
+    result.checker_message = arena.store(reply->message);
+    munmap(shared, sizeof(PluginReply));
+
+    if (timed_out)
+    {
+        result.status = "SE";
+        result.checker_message = "Checker plugin timed out";
+        return;
+    }
+    if (WIFSIGNALED(status))
+    {
+        result.status = "SE";
+        result.checker_message = arena.concat({"Checker plugin crashed with signal ", arena.number(WTERMSIG(status))});
+        return;
+    }
+
+    switch (verdict)
+    {
+    case JUDGE_CHECKER_AC:
+        break;
+    case JUDGE_CHECKER_WA:
+        result.status = "WA";
+        break;
+    case JUDGE_CHECKER_PE:
+        result.status = "PE";
+        break;
+    default:
+        result.status = "SE";
+        result.checker_message = arena.concat({"Checker plugin failed: ", result.checker_message});
+        break;
+    }
+}
+
+/**
+ * @brief 在cgroup中运行不受信任的checker可执行文件
+ * @param checker checker可执行文件路径
+ * @param input_file 测试输入
+ * @param answer_file 标准答案
+ * @param limits 资源限制(使用checker_time_limit)
+ * @param result 评测结果，写入status和checker_message
+ *
+ * 参数顺序与testlib一致：checker <input> <output> <answer>
+ * 选手输出写入memfd，以/proc/<pid>/fd/<n>的路径交给checker，stdout/stderr作为反馈信息
+ * cgroup从CgroupPool签出，多个测试点之间复用
+ *
+ * @details 退出码按testlib约定解释：
+ *          - 0 AC，1 WA，2 PE，3 FAIL(checker自身出错，判为SE)
+ *          - 4 dirt(输出末尾有多余内容)和8 unexpected EOF 判为PE
+ *          - 7 points：从反馈信息开头的"points X"读取得分X(必须在[0, 1]内，与score同为比例)，判为PC
+ *          - 16+n partially：得分为n%，判为PC
+ */
+void checkInSandbox(const string &checker, const string &input_file, const string &answer_file,
+                    const Limits &limits, JudgeResult &result)
+{
+    JobArena &arena = JobArena::current();
+
+    Limits checker_limits = limits;
+    checker_limits.time_limit = limits.checker_time_limit;
+    checker_limits.output_limit = 1 << 20;
+
+    CgroupPool::Lease cgroup = CgroupPool::instance().acquire(checker_limits);
+    int output_fd = memfd_create("checker_output", MFD_CLOEXEC);
+    int message_fd = memfd_create("checker_message", MFD_CLOEXEC);
+    string_view output = result.stdout_content;
+    bool ready = cgroup && output_fd != -1 && message_fd != -1 &&
+                 write(output_fd, output.data(), output.size()) == static_cast<ssize_t>(output.size());
+
+    JudgeResult checked;
+    checked.status = "SE";
+    checked.exit_code = -1;
+    if (ready)
+    {
+        string_view output_path = arena.concat({"/proc/", arena.number(getpid()), "/fd/", arena.number(output_fd)});
+        const char *arguments[3] = {input_file.c_str(), output_path.data(), answer_file.c_str()};
+        checked = runInSandbox(*cgroup, checker.c_str(), arguments, -1, message_fd, checker_limits, message_fd);
+
+        vector<char> buffer;
+        string_view message = readWholeFd(message_fd, buffer);
+        while (!message.empty() && (message.back() == '\n' || message.back() == ' '))
+            message.remove_suffix(1);
+        result.checker_message = arena.store(message.substr(0, 1024));
+    }
+
+    for (int fd : {output_fd, message_fd})
+    {
+        if (fd != -1)
+            close(fd);
+    }
+
+    if (!ready || checked.status == "SE")
+    {
+        result.status = "SE";
+        result.checker_message = "Failed to start sandboxed checker";
+    }
+    else if (checked.status == "OK")
+    {
+        result.score = 1;
+    }
+    else if (checked.status == "RE" && checked.exit_code == 1)
+    {
+        result.status = "WA";
+    }
+    else if (checked.status == "RE" && (checked.exit_code == 2 || checked.exit_code == 4 || checked.exit_code == 8))
+    {
+        result.status = "PE";
+    }
+    else if (checked.status == "RE" && checked.exit_code == 7 && result.checker_message.substr(0, 7) == "points ")
+    {
+        char *end = nullptr;
+        double points = strtod(result.checker_message.data() + 7, &end);
+        if (end == result.checker_message.data() + 7 || !(points >= 0 && points <= 1))
+        {
+            result.status = "SE";
+            result.checker_message = arena.concat({"Checker reported points outside [0, 1]: ", result.checker_message});
+        }
+        else
+        {
+            result.status = "PC";
+            result.score = points;
+        }
+    }
+    else if (checked.status == "RE" && checked.exit_code >= 16 && checked.exit_code <= 116)
+    {
+        result.status = "PC";
+        result.score = (checked.exit_code - 16) / 100.0;
+    }
+    else
+    {
+        result.status = "SE";
+        result.checker_message = arena.concat({"Checker ", checked.status, " (exit code ", arena.number(checked.exit_code), "): ",
+                                               result.checker_message});
+    }
+}
+
+/**
+ * @brief 用标准答案检查程序输出
+ * @param input_file 测试输入
+ * @param answer_file 标准答案
+ * @param checker checker路径：为空时按记号比较；以.so结尾时作为受信任插件在进程内调用；
+ *                以.cpp结尾时按testlib checker经编译缓存编译后在cgroup中运行；
+ *                其他情况作为不受信任的可执行文件在cgroup中运行
+ * @param limits 资源限制
+ * @param result 运行结果为OK时检查答案，不通过时改为WA/PE/PC，并写入score
+ */
+void checkOutput(const string &input_file, const string &answer_file, const string &checker,
+                 const Limits &limits, JudgeResult &result)
+{
+    auto start_time = high_resolution_clock::now();
+
+    if (checker.empty())
+    {
+        result.checker = "builtin";
+        MappedFile answer(answer_file.c_str());
+        if (!answer.valid())
+        {
+            result.status = "SE";
+            result.checker_message = "Failed to map answer file";
+        }
+        else if (!compareTokens(result.stdout_content, answer.view()))
+        {
+            result.status = "WA";
+        }
+    }
+    else if (checker.size() > 3 && checker.compare(checker.size() - 3, 3, ".so") == 0)
+    {
+        result.checker = "plugin";
+        checkWithPlugin(checker, input_file, answer_file, limits, result);
+    }
+    else if (checker.size() > 4 && checker.compare(checker.size() - 4, 4, ".cpp") == 0)
+    {
+        result.checker = "testlib";
+
+        // checker由出题人提供，编译时间不计入选手的compile_timeout
+        Limits compile_limits = limits;
+        compile_limits.compile_timeout = INT_MAX;
+        string executable;
+        JudgeResult compiled = compileCached(checker, compile_limits, executable);
+        if (compiled.status != "OK")
+        {
+            result.status = "SE";
+            result.checker_message = JobArena::current().concat({"Checker compilation failed: ", compiled.error_message});
+        }
+        else
+        {
+            checkInSandbox(executable, input_file, answer_file, limits, result);
+        }
+    }
+    else
+    {
+        result.checker = "sandbox";
+        checkInSandbox(checker, input_file, answer_file, limits, result);
+    }
+
+    // 未给出部分分的结果按通过/不通过记分
+    if (result.score < 0 && result.status != "SE")
+    {
+        result.score = result.status == "OK" ? 1 : 0;
+    }
+
+    result.checker_time_us = duration_cast<microseconds>(high_resolution_clock::now() - start_time).count();
+}
+
+/**
+ * @brief 判断运行结果是否落在时间限制附近的边界区间
+ * @return bool 状态为OK/TLE且|time_used - time_limit| <= time_limit * rerun_band%时返回true
+ */
+bool isBorderlineTime(const JudgeResult &result, const Limits &limits)
+{
+    if (limits.rerun_band <= 0)
+        return false;
+    if (result.status != "OK" && result.status != "TLE")
+        return false;
+
+    long long band = static_cast<long long>(limits.time_limit) * limits.rerun_band / 100;
+    long long distance = result.time_used - limits.time_limit;
+    return distance <= band && distance >= -band;
+}
+
+/**
+ * @brief 运行程序，时间落在边界区间或计时受干扰时自动重测
+ * @return JudgeResult 按重测策略选出的那一次运行结果，samples中包含全部采样
+ *
+ * 主机噪声会让接近time_limit的程序在OK和TLE之间来回翻转
+ * 开启rerun_band后，首次运行时间落在边界区间内时最多再运行rerun_max次：
+ *          - 每次运行重新选择CPU核心(未预备时也使用新的cgroup)
+ *          - rerun_policy=0取时间最小的一次，1取时间中位数的一次
+ *          - 取最小值时一旦出现低于区间下沿的采样即可提前结束
+ *          - 非OK/TLE的采样(如偶发RE)会被记录但不参与取值
+ * 开启interference_rerun后，首次OK/TLE运行被标记为受干扰时同样重测，
+ * 只因干扰而重测时得到一次未受干扰的运行即可结束；取值优先使用未受干扰的采样
+ */
+JudgeResult runWithBorderlineRerun(const string &executable, const string &input_file, const Limits &limits,
+                                   const PreparedRun *prepared = nullptr)
+{
+    JudgeResult first = runProgram(executable, input_file, limits, nullptr, prepared);
+    bool borderline = isBorderlineTime(first, limits);
+    bool interfered = limits.interference_rerun == 1 && first.interfered &&
+                      (first.status == "OK" || first.status == "TLE");
+    if ((!borderline && !interfered) || limits.rerun_max <= 0)
+        return first;
+
+    vector<JudgeResult> runs;
+    runs.reserve(limits.rerun_max + 1);
+    runs.push_back(first);
+
+    long long lower_edge = limits.time_limit - static_cast<long long>(limits.time_limit) * limits.rerun_band / 100;
+    for (int i = 0; i < limits.rerun_max; i++)
+    {
+        runs.push_back(runProgram(executable, input_file, limits, nullptr, prepared));
+
+        const JudgeResult &last = runs.back();
+        if (last.interfered)
+            continue;
+        if (!borderline)
+            break;
+        if (limits.rerun_policy == 0 && last.status == "OK" && last.time_used < lower_edge)
+            break;
+    }
+
+    // 只在时间类结果(OK/TLE)中按策略取值，有未受干扰的采样时只用这些采样
+    vector<size_t> candidates;
+    bool any_clean = false;
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if (runs[i].status == "OK" || runs[i].status == "TLE")
+            any_clean = any_clean || !runs[i].interfered;
+    }
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if ((runs[i].status == "OK" || runs[i].status == "TLE") && !(any_clean && runs[i].interfered))
+            candidates.push_back(i);
+    }
+    sort(candidates.begin(), candidates.end(), [&](size_t a, size_t b)
+         { return runs[a].time_used < runs[b].time_used; });
+
+    size_t chosen = limits.rerun_policy == 0 ? candidates.front() : candidates[(candidates.size() - 1) / 2];
+
+    // 全部采样存入任务arena，随结果一起返回
+    JobArena &arena = JobArena::current();
+    RunSample *samples = static_cast<RunSample *>(arena.allocate(sizeof(RunSample) * runs.size(), alignof(RunSample)));
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        samples[i] = RunSample{runs[i].time_used, runs[i].status, runs[i].allocated_cpu, runs[i].interfered};
+    }
+
+    JudgeResult result = runs[chosen];
+    result.samples = span<const RunSample>(samples, runs.size());
+    return result;
+}
+
+/**
+ * @struct HostSpeed
+ * @brief 主机基准测试结果
+ *
+ * 四个固定工作量的内核分别覆盖整数运算、访存延迟、分支预测和顺序带宽
+ * 得分为四项耗时(微秒)的几何平均，越小表示主机越快
+ */
+struct HostSpeed
+{
+    long long integer_us = 0;   ///< 整数运算内核耗时
+    long long latency_us = 0;   ///< 随机指针追逐内核耗时
+    long long branchy_us = 0;   ///< 不可预测分支内核耗时
+    long long streaming_us = 0; ///< 顺序读写内核耗时
+    long long score_us = 0;     ///< 几何平均得分
+    long long measured_at = 0;  ///< 测量时间(Unix秒)
+};
+
+volatile unsigned long long g_benchmark_sink; ///< 接收基准内核的结果，防止计算被优化掉
+
+/**
+ * @brief 执行一个基准内核并返回最好一次的耗时
+ * @param kernel 内核函数，返回值用于防止编译器消除计算
+ * @return long long 三次运行中最短的耗时(微秒)
+ */
+template <typename Kernel>
+long long timeKernel(const Kernel &kernel)
+{
+    long long best = LLONG_MAX;
+    for (int round = 0; round < 3; round++)
+    {
+        auto start = steady_clock::now();
+        g_benchmark_sink = kernel();
+        best = min<long long>(best, duration_cast<microseconds>(steady_clock::now() - start).count());
+    }
+    return max(best, 1LL);
+}
+
+/**
+ * @brief 运行基准测试组
+ * @return HostSpeed 各内核耗时及几何平均得分，没有空闲核心时score_us为0(未测量)
+ *
+ * 测试期间当前线程绑定在租用的独占核心上，避免与正在运行的评测互相干扰
+ * 只尝试非阻塞地租用核心，所有核心都被占用时放弃本次测量，不让评测任务等待核心
+ */
+HostSpeed runSpeedBattery()
+{
+    HostSpeed speed;
+
+    // 在独占核心上测量
+    CpuLease lease;
+    if (!lease.tryAcquire(0))
+        return speed;
+    cpu_set_t original_mask;
+    CPU_ZERO(&original_mask);
+    sched_getaffinity(0, sizeof(original_mask), &original_mask);
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(lease.cpu(), &cpu_set);
+    sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+
+    // 整数运算：xorshift与乘法混合
+    speed.integer_us = timeKernel([]
+                                  {
+        unsigned long long x = 88172645463325252ULL, acc = 0;
+        for (int i = 0; i < 20000000; i++)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            acc += x * 0x9E3779B97F4A7C15ULL;
+        }
+        return acc; });
+
+    // 访存延迟：在16MB的随机单环上做指针追逐
+    {
+        const size_t count = 4UL << 20;
+        vector<uint32_t> next(count);
+        for (size_t i = 0; i < count; i++)
+            next[i] = static_cast<uint32_t>(i);
+        mt19937 gen(12345);
+        for (size_t i = count - 1; i > 0; i--) // Sattolo算法生成单个环
+        {
+            size_t j = uniform_int_distribution<size_t>(0, i - 1)(gen);
+            swap(next[i], next[j]);
+        }
+        speed.latency_us = timeKernel([&]
+                                      {
+            uint32_t pos = 0;
+            for (int i = 0; i < 1000000; i++)
+                pos = next[pos];
+            return static_cast<unsigned long long>(pos); });
+    }
+
+    // 分支预测：按随机数据走不同分支
+    {
+        vector<uint8_t> data(4UL << 20);
+        mt19937 gen(54321);
+        for (uint8_t &v : data)
+            v = static_cast<uint8_t>(gen());
+        speed.branchy_us = timeKernel([&]
+                                      {
+            unsigned long long a = 1, b = 0;
+            for (int pass = 0; pass < 4; pass++)
+                for (uint8_t v : data)
+                {
+                    if (v & 0x80)
+                        a = a * 3 + v;
+                    else
+                        b += (b >> 3) ^ v;
+                }
+            return a ^ b; });
+    }
+
+    // 顺序带宽：32MB数组上的triad
+    {
+        const size_t count = 4UL << 20;
+        vector<double> a(count), b(count, 1.5), c(count, 2.5);
+        speed.streaming_us = timeKernel([&]
+                                        {
+            for (int pass = 0; pass < 4; pass++)
+                for (size_t i = 0; i < count; i++)
+                    a[i] = b[i] + 0.5 * c[i];
+            return static_cast<unsigned long long>(a[count / 2]); });
+    }
+
+    sched_setaffinity(0, sizeof(original_mask), &original_mask);
+
+    double log_sum = log(static_cast<double>(speed.integer_us)) + log(static_cast<double>(speed.latency_us)) +
+                     log(static_cast<double>(speed.branchy_us)) + log(static_cast<double>(speed.streaming_us));
+    speed.score_us = llround(exp(log_sum / 4));
+    speed.measured_at = duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+    return speed;
+}
+
+/**
+ * @brief 获取主机速度系数
+ * @param limits 资源限制(使用speed_reference和speed_refresh)
+ * @return double 本机得分/参考机得分，大于1表示本机比参考机慢
+ *
+ * 基准测试结果缓存在LEASE_DIR/host_speed.json中，由所有评测进程共享
+ * 缓存超过speed_refresh秒后重新测量，实现启动时测量和周期性刷新
+ *
+ * @details 刷新规则：
+ *          - 刷新前对LEASE_DIR/host_speed.lock加非阻塞排他锁，同一时刻只有一个评测进程测量
+ *          - 锁被占用(其他进程正在刷新)时继续使用过期的结果；
+ *            从未测量过时才等待对方完成，再读取它写入的结果
+ *          - 取得锁后重新读取缓存，别的进程刚刷新过就不再测量
+ *          - 没有空闲核心时放弃测量，沿用过期结果；从未测量过时系数取1(不换算)
+ */
+double hostSpeedFactor(const Limits &limits)
+{
+    if (limits.speed_reference <= 0)
+        return 1.0;
+
+    JobArena &arena = JobArena::current();
+    string_view cache_path = arena.concat({CpuLease::LEASE_DIR, "/host_speed.json"});
+    string_view lock_path = arena.concat({CpuLease::LEASE_DIR, "/host_speed.lock"});
+    long long now = duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+
+    // 读取缓存
+    char buffer[512];
+    long long score = -1, measured_at = -1;
+    auto read_cache = [&]()
+    {
+        string_view cached = readSmallFile(cache_path.data(), buffer, sizeof(buffer));
+        score = parseJsonNumber(cached, "score_us");
+        measured_at = parseJsonNumber(cached, "measured_at");
+    };
+    auto stale = [&]()
+    { return score <= 0 || measured_at < 0 || now - measured_at >= limits.speed_refresh; };
+    read_cache();
+
+    if (stale())
+    {
+        mkdir(CpuLease::LEASE_DIR, 0755);
+        int lock_fd = open(lock_path.data(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (lock_fd != -1 && flock(lock_fd, LOCK_EX | LOCK_NB) != 0)
+        {
+            // 其他进程正在刷新：有旧结果就先用旧结果，否则等它测完
+            if (score <= 0 && flock(lock_fd, LOCK_EX) == 0)
+                read_cache();
+            close(lock_fd);
+            return score > 0 ? static_cast<double>(score) / limits.speed_reference : 1.0;
+        }
+        read_cache();
+        if (!stale())
+        {
+            if (lock_fd != -1)
+                close(lock_fd); // 读取缓存后、取得锁之前已被其他进程刷新
+            return static_cast<double>(score) / limits.speed_reference;
+        }
+
+        HostSpeed speed = runSpeedBattery();
+        if (speed.score_us <= 0)
+        {
+            if (lock_fd != -1)
+                close(lock_fd);
+            return score > 0 ? static_cast<double>(score) / limits.speed_reference : 1.0;
+        }
+        score = speed.score_us;
+
+        // 先写临时文件再rename，避免并发评测读到半个文件
+        string_view content = arena.concat({"{\"score_us\": ", arena.number(speed.score_us),
+                                            ", \"integer_us\": ", arena.number(speed.integer_us),
+                                            ", \"latency_us\": ", arena.number(speed.latency_us),
+                                            ", \"branchy_us\": ", arena.number(speed.branchy_us),
+                                            ", \"streaming_us\": ", arena.number(speed.streaming_us),
+                                            ", \"measured_at\": ", arena.number(speed.measured_at), "}"});
+        string_view temp_path = arena.concat({cache_path, ".", arena.number(getpid())});
+        if (writeSmallFile(temp_path.data(), content))
+            rename(temp_path.data(), cache_path.data());
+        if (lock_fd != -1)
+            close(lock_fd); // 结果已写入后才释放刷新锁
+    }
+
+    return static_cast<double>(score) / limits.speed_reference;
+}
+
+/**
+ * @brief 用工作线程并行执行一组任务
+ * @param task_count 任务数量
+ * @param worker_count 工作线程数量(含调用线程)
+ * @param task 任务函数，参数为任务下标
+ *
+ * 工作线程共享调用者的任务arena，按下标顺序领取任务
+ * 每次运行在CgroupManager中租用独占核心，因此工作线程数通常取可用核心数
+ */
+template <typename Task>
+void runParallel(size_t task_count, size_t worker_count, const Task &task)
+{
+    JobArena &arena = JobArena::current();
+    atomic<size_t> next_task{0};
+
+    auto worker = [&]()
+    {
+        JobArena::Scope scope(arena);
+        for (size_t i = next_task++; i < task_count; i = next_task++)
+        {
+            task(i);
+        }
+    };
+
+    worker_count = max<size_t>(1, min(worker_count, task_count));
+    vector<thread> threads;
+    threads.reserve(worker_count - 1);
+    for (size_t i = 1; i < worker_count; i++)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+}
+
+/**
+ * @class HousekeepingPool
+ * @brief 不占用独占核心的后处理线程池
+ *
+ * 运行测试点的工作线程在程序退出、核心归还后把答案检查等后处理交给该线程池，
+ * 立即领取下一个测试点；输出量大的题目中核心不再空等比较完成
+ *
+ * @details 线程共享创建者的任务arena；drain()等待已提交的任务全部完成，
+ *          析构时先drain再停止线程
+ */
+class HousekeepingPool
+{
+public:
+    /**
+     * @param thread_count 后处理线程数
+     */
+    explicit HousekeepingPool(size_t thread_count) : arena(JobArena::current())
+    {
+        for (size_t i = 0; i < max<size_t>(1, thread_count); i++)
+        {
+            threads.emplace_back([this]()
+                                 {
+                JobArena::Scope scope(arena);
+                work(); });
+        }
+    }
+
+    ~HousekeepingPool()
+    {
+        drain();
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_ready.notify_all();
+        for (thread &t : threads)
+            t.join();
+    }
+
+    HousekeepingPool(const HousekeepingPool &) = delete;
+    HousekeepingPool &operator=(const HousekeepingPool &) = delete;
+
+    /**
+     * @brief 提交一个后处理任务
+     */
+    void submit(function<void()> job)
+    {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            jobs.push_back(std::move(job));
+            pending++;
+        }
+        queue_ready.notify_one();
+    }
+
+    /**
+     * @brief 等待已提交的任务全部完成
+     */
+    void drain()
+    {
+        unique_lock<mutex> lock(queue_mutex);
+        all_done.wait(lock, [this]()
+                      { return pending == 0; });
+    }
+
+private:
+    JobArena &arena;                  ///< 创建者的任务arena
+    mutex queue_mutex;                ///< 保护jobs、pending和stopping
+    condition_variable queue_ready;   ///< 有新任务或需要停止
+    condition_variable all_done;      ///< pending降为0
+    deque<function<void()>> jobs;     ///< 待执行的任务
+    size_t pending = 0;               ///< 已提交未完成的任务数
+    bool stopping = false;            ///< 析构中
+    vector<thread> threads;           ///< 后处理线程
+
+    void work()
+    {
+        unique_lock<mutex> lock(queue_mutex);
+        while (true)
+        {
+            queue_ready.wait(lock, [this]()
+                             { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+
+            function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+            if (--pending == 0)
+                all_done.notify_all();
+        }
+    }
+};
+
+/**
+ * @class StagedCase
+ * @brief 为即将运行的测试点提前准备的资源
+ *
+ * 在上一个测试点运行期间准备好，测试点之间不再有打开文件、读入答案和配置cgroup的开销
+ *
+ * @details 准备内容：
+ *          - 输入复制到memfd并加封印(F_SEAL_WRITE/SHRINK/GROW)，子进程直接继承；
+ *            同一memfd供边界重测复用，封印保证选手程序无法经标准输入改写自己重测时的输入
+ *          - 对标准答案发出POSIX_FADV_WILLNEED预读，只负责把它读入页缓存；
+ *            检查(可能在测试点的资源释放后由后台线程执行)仍按路径打开答案，届时不再读盘
+ *          - 从CgroupPool签出已设置内存限制的cgroup(运行时才租用核心)，并打开memory.peak；
+ *            内核不支持按描述符重置memory.peak时不使用池化cgroup，运行时照常新建
+ */
+class StagedCase
+{
+private:
+    PreparedRun prepared;         ///< 传给runProgram的资源
+    CgroupPool::Lease cgroup;     ///< 签出的池化cgroup
+
+public:
+    /**
+     * @param input_file 测试输入
+     * @param answer_file 标准答案，为空或不存在时不预读
+     * @param limits 资源限制
+     */
+    StagedCase(const string &input_file, const string &answer_file, const Limits &limits)
+        : cgroup(CgroupPool::instance().acquire(limits, false))
+    {
+        int source = open(input_file.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (source != -1 && fstat(source, &st) == 0)
+        {
+            prepared.input_fd = memfd_create("staged_input", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+            off_t copied = 0;
+            while (prepared.input_fd != -1 && copied < st.st_size)
+            {
+                ssize_t n = sendfile(prepared.input_fd, source, &copied, static_cast<size_t>(st.st_size - copied));
+                if (n <= 0)
+                {
+                    close(prepared.input_fd);
+                    prepared.input_fd = -1;
+                }
+            }
+            // 封印失败时不使用预备的输入，子进程按路径只读打开
+            if (prepared.input_fd != -1 &&
+                fcntl(prepared.input_fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)
+            {
+                close(prepared.input_fd);
+                prepared.input_fd = -1;
+            }
+        }
+        if (source != -1)
+            close(source);
+
+        int answer = answer_file.empty() ? -1 : open(answer_file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (answer != -1)
+        {
+            posix_fadvise(answer, 0, 0, POSIX_FADV_WILLNEED);
+            close(answer);
+        }
+
+        if (cgroup)
+        {
+            prepared.peak_fd = cgroup->openMemoryPeak();
+            if (prepared.peak_fd != -1)
+                prepared.cgroup = &*cgroup;
+        }
+    }
+
+    ~StagedCase()
+    {
+        if (prepared.input_fd != -1)
+            close(prepared.input_fd);
+        if (prepared.peak_fd != -1)
+            close(prepared.peak_fd);
+    }
+
+    StagedCase(const StagedCase &) = delete;
+    StagedCase &operator=(const StagedCase &) = delete;
+
+    const PreparedRun *run() const { return &prepared; }
+};
+
+/**
+ * @brief 带预备的并行执行：每个工作线程运行当前任务时在后台准备自己的下一个任务
+ * @param task_count 任务数量
+ * @param worker_count 工作线程数量(含调用线程)
+ * @param stage 准备函数，参数为任务下标，返回unique_ptr(可为空)
+ * @param task 任务函数，参数为任务下标和准备好的资源
+ *
+ * 与runParallel相同的领取方式，只是每个工作线程提前领取下一个任务
+ */
+template <typename Stage, typename Task>
+void runPipelined(size_t task_count, size_t worker_count, const Stage &stage, const Task &task)
+{
+    using Staged = decltype(stage(size_t{0}));
+    JobArena &arena = JobArena::current();
+    atomic<size_t> next_task{0};
+
+    auto worker = [&]()
+    {
+        JobArena::Scope scope(arena);
+        size_t current = next_task++;
+        Staged staged = current < task_count ? stage(current) : Staged();
+        while (current < task_count)
+        {
+            size_t upcoming = next_task++;
+            future<Staged> ahead;
+            if (upcoming < task_count)
+            {
+                ahead = async(launch::async, [&arena, &stage, upcoming]()
+                              {
+                    JobArena::Scope inner(arena);
+                    return stage(upcoming); });
+            }
+            task(current, staged);
+            current = upcoming;
+            staged = ahead.valid() ? ahead.get() : Staged();
+        }
+    };
+
+    worker_count = max<size_t>(1, min(worker_count, task_count));
+    vector<thread> threads;
+    threads.reserve(worker_count - 1);
+    for (size_t i = 1; i < worker_count; i++)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+}
+
+/**
+ * @brief 把系统调用统计编码为紧凑的JSON对象
+ *
+ * 直方图以调用号为键、按次数降序排列，只包含非零项
+ */
+void appendSyscallProfile(pmr::string &out, const SyscallProfile &profile)
+{
+    JobArena &arena = JobArena::current();
+    out.append("{\"total\": ").append(arena.number(profile.total));
+    out.append(", \"offcpu_blocked_us\": ").append(arena.number(profile.blocked_us));
+    out.append(", \"offcpu_blocked\": ").append(arena.number(profile.blocked_count));
+    out.append(", \"offcpu_runnable_us\": ").append(arena.number(profile.runnable_us));
+    out.append(", \"offcpu_runnable\": ").append(arena.number(profile.runnable_count));
+    out += ", \"histogram\": {";
+    for (size_t i = 0; i < profile.histogram.size(); i++)
+    {
+        out += i == 0 ? "\"" : ", \"";
+        out.append(arena.number(profile.histogram[i].nr)).append("\": ").append(arena.number(profile.histogram[i].count));
+    }
+    out += "}}";
+}
+
+/**
+ * @brief 把评测结果编码为JSON
+ * @return string_view JSON文本(位于任务arena)
+ *
+ * 直接在任务arena中按预估长度一次性预留空间后拼接，避免stringstream的分配
+ */
+string_view resultToJson(const JudgeResult &result)
+{
+    JobArena &arena = JobArena::current();
+    pmr::string out(&arena);
+    out.reserve(256 + result.error_message.size() * 2 + result.stdout_content.size() * 2 + result.samples.size() * 64);
+
+    out += "{\n";
+    out.append("  \"status\": \"").append(result.status).append("\",\n");
+    out.append("  \"time_used\": ").append(arena.number(result.time_used)).append(",\n");
+    out.append("  \"mem_used\": ").append(arena.number(result.mem_used)).append(",\n");
+    out.append("  \"exit_code\": ").append(arena.number(result.exit_code)).append(",\n");
+    out += "  \"error_message\": \"";
+
+    // 转义错误消息中的特殊字符
+    appendJsonEscaped(out, result.error_message);
+
+    out += "\",\n";
+    out += "  \"stdout\": \"";
+
+    // 转义标准输出中的特殊字符
+    appendJsonEscaped(out, result.stdout_content);
+
+    out += "\",\n";
+    out.append("  \"output_len\": ").append(arena.number(result.output_len)).append(",\n");
+    out.append("  \"allocated_cpu\": \"").append(result.allocated_cpu).append("\"");
+
+    // 运行核心的调频状态
+    if (result.cpufreq_checked)
+    {
+        out.append(",\n  \"cpu_governor\": \"").append(result.cpu_governor).append("\"");
+        out.append(",\n  \"cpu_boost\": ").append(arena.number(result.cpu_boost));
+        out.append(",\n  \"cpu_freq_min_khz\": ").append(arena.number(result.cpu_freq_min_khz));
+        out.append(",\n  \"cpu_freq_max_khz\": ").append(arena.number(result.cpu_freq_max_khz));
+        out.append(",\n  \"cpu_throttled\": ").append(result.cpu_throttled ? "true" : "false");
+    }
+
+    // 主机速度归一化：同时给出原始时间和折算时间
+    if (result.host_speed_factor > 0)
+    {
+        out.append(",\n  \"host_speed_factor\": ").append(arena.decimal(result.host_speed_factor, 3));
+        out.append(",\n  \"time_used_raw\": ").append(arena.number(result.time_used_raw));
+        out.append(",\n  \"time_used_normalized\": ").append(arena.number(result.time_used_normalized));
+    }
+
+    // 从exec成功起计的CPU时间
+    if (result.cpu_time_used >= 0)
+    {
+        out.append(",\n  \"cpu_time_used\": ").append(arena.number(result.cpu_time_used));
+    }
+
+    // 干扰指标，受干扰时附带超过阈值的指标名
+    if (result.interference_checked)
+    {
+        out.append(",\n  \"interference\": {\"interfered\": ").append(result.interfered ? "true" : "false");
+        if (result.interfered)
+            out.append(", \"reason\": \"").append(result.interference_reason).append("\"");
+        out.append(", \"runqueue_wait_us\": ").append(arena.number(result.runqueue_wait_us));
+        out.append(", \"nivcsw\": ").append(arena.number(result.involuntary_switches));
+        out.append(", \"throttled_usec\": ").append(arena.number(result.throttled_usec)).append("}");
+    }
+
+    // eBPF系统调用统计
+    if (result.syscalls_traced)
+    {
+        out += ",\n  \"syscalls\": ";
+        appendSyscallProfile(out, result.syscalls);
+    }
+    else if (!result.syscall_trace_error.empty())
+    {
+        out += ",\n  \"syscalls\": {\"error\": \"";
+        appendJsonEscaped(out, result.syscall_trace_error);
+        out += "\"}";
+    }
+
+    // 访存争用：租用方式、LLC域和估算的访存带宽
+    if (result.contention_checked)
+    {
+        out.append(",\n  \"contention\": {\"memory_heavy\": ").append(result.memory_heavy ? "true" : "false");
+        out.append(", \"llc_domain\": ").append(arena.number(result.llc_domain));
+        out.append(", \"heavy_neighbor\": ").append(result.heavy_neighbor ? "true" : "false");
+        out.append(", \"llc_misses\": ").append(arena.number(result.llc_misses));
+        out.append(", \"miss_bandwidth_mbps\": ").append(arena.number(result.miss_bandwidth_mbps)).append("}");
+    }
+
+    // 答案检查
+    if (result.checker_time_us >= 0)
+    {
+        out.append(",\n  \"checker\": \"").append(result.checker).append("\"");
+        out += ",\n  \"checker_message\": \"";
+        appendJsonEscaped(out, result.checker_message);
+        out += "\"";
+        out.append(",\n  \"checker_time_us\": ").append(arena.number(result.checker_time_us));
+        if (result.score >= 0)
+        {
+            out.append(",\n  \"score\": ").append(arena.decimal(result.score, 4));
+        }
+    }
+
+    // 各阶段耗时
+    if (result.phases.load_us >= 0)
+    {
+        out.append(",\n  \"phases\": {\"load_us\": ").append(arena.number(result.phases.load_us));
+        out.append(", \"compile_us\": ").append(arena.number(result.phases.compile_us));
+        out.append(", \"run_us\": ").append(arena.number(result.phases.run_us));
+        out.append(", \"check_us\": ").append(arena.number(result.phases.check_us)).append("}");
+    }
+
+    // 热点剖析
+    if (result.profiled)
+    {
+        out.append(",\n  \"profiled\": true");
+        out.append(",\n  \"profile\": ").append(result.profile);
+    }
+
+    // 边界时间重测的全部采样
+    if (!result.samples.empty())
+    {
+        out += ",\n  \"samples\": [";
+        for (size_t i = 0; i < result.samples.size(); i++)
+        {
+            const RunSample &sample = result.samples[i];
+            out += i == 0 ? "\n" : ",\n";
+            out.append("    {\"time_used\": ").append(arena.number(sample.time_used));
+            out.append(", \"status\": \"").append(sample.status);
+            out.append("\", \"allocated_cpu\": \"").append(sample.allocated_cpu);
+            out.append("\", \"interfered\": ").append(sample.interfered ? "true" : "false").append("}");
+        }
+        out += "\n  ]";
+    }
+
+    out += "\n}";
+
+    return string_view(out.data(), out.size());
+}
+
+JudgeResult judge_core(const string &limits_file, const string &source_file, const string &input_file,
+                       const string &answer_file = "", const string &checker = "")
+{
+    JudgeResult result;
+
+    try
+    {
+        // 各阶段计时
+        PhaseTimes phases;
+        auto phase_start = steady_clock::now();
+        auto lap = [&phase_start]()
+        {
+            auto now = steady_clock::now();
+            long long elapsed = duration_cast<microseconds>(now - phase_start).count();
+            phase_start = now;
+            return elapsed;
+        };
+
+        // 加载限制配置
+        Limits limits = loadLimits(limits_file);
+        CpuFreqGuard::checkAtStartup(limits);
+        limits.host_speed_factor = hostSpeedFactor(limits);
+        phases.load_us = lap();
+
+        // 编译程序(compile_cache开启时可执行文件保存在编译缓存中，不删除)
+        string executable = source_file + ".out";
+        bool cached = limits.compile_cache == 1;
+        result = cached ? compileCached(source_file, limits, executable) : compileProgram(source_file, executable, limits);
+        phases.compile_us = lap();
+
+        if (result.status != "OK")
+        {
+            if (limits.report_phases == 1)
+                result.phases = phases;
+            return result;
+        }
+
+        // 运行程序(时间落在边界区间时按配置自动重测)，计时前预读可执行文件和共享库
+        WarmBinary warm(executable, limits.prefetch_binary);
+        result = runWithBorderlineRerun(executable, input_file, limits);
+        phases.run_us = lap();
+
+        // 提供标准答案时检查输出
+        if (!answer_file.empty() && result.status == "OK")
+        {
+            checkOutput(input_file, answer_file, checker, limits, result);
+            phases.check_us = lap();
+        }
+
+        // 剖析模式：额外运行一次并采样，判定仍以未采样的运行为准
+        if (limits.profile == 1)
+        {
+            PerfProfiler profiler(limits.profile_freq, limits.profile_top);
+            runProgram(executable, input_file, limits, &profiler);
+            result.profiled = true;
+            result.profile = profiler.report();
+        }
+
+        // 清理可执行文件
+        if (!cached)
+            unlink(executable.c_str());
+
+        if (limits.report_phases == 1)
+            result.phases = phases;
+    }
+    catch (const exception &e)
+    {
+        result.status = "SE";
+        result.error_message = JobArena::current().concat({"System error: ", e.what()});
+        result.time_used = 0;
+        result.mem_used = 0;
+        result.exit_code = -1;
+        result.output_len = 0;
+        result.allocated_cpu = "";
+    }
+
+    return result;
+}
+
+/**
+ * @brief 向任务轨迹文件追加一条记录
+ * @param trace_file 轨迹文件路径(JSONL)
+ * @param arrival_ms 任务到达时刻(Unix毫秒)
+ * @param limits_file 限制配置文件
+ * @param source_file 源代码文件
+ * @param input_file 输入文件
+ * @param result 评测结果
+ * @param total_ms 任务总耗时(含编译)，毫秒
+ *
+ * 每条记录一行，包含到达时间、限制、输入/源码大小和实测开销，供judge_replay回放
+ * 以O_APPEND一次write写入，多个评测进程同时记录时行不会交错
+ */
+void appendTraceRecord(const char *trace_file, long long arrival_ms, const string &limits_file,
+                       const string &source_file, const string &input_file, const JudgeResult &result, long long total_ms)
+{
+    JobArena &arena = JobArena::current();
+    Limits limits;
+    try
+    {
+        limits = loadLimits(limits_file);
+    }
+    catch (const exception &)
+    {
+        return;
+    }
+
+    struct stat input_stat, source_stat;
+    long long input_bytes = stat(input_file.c_str(), &input_stat) == 0 ? input_stat.st_size : -1;
+    long long source_bytes = stat(source_file.c_str(), &source_stat) == 0 ? source_stat.st_size : -1;
+
+    pmr::string line(&arena);
+    line.append("{\"arrival_ms\": ").append(arena.number(arrival_ms));
+    line.append(", \"time_limit\": ").append(arena.number(limits.time_limit));
+    line.append(", \"memory_limit\": ").append(arena.number(limits.memory_limit));
+    line.append(", \"output_limit\": ").append(arena.number(limits.output_limit));
+    line.append(", \"input_bytes\": ").append(arena.number(input_bytes));
+    line.append(", \"source_bytes\": ").append(arena.number(source_bytes));
+    line.append(", \"status\": \"").append(result.status);
+    line.append("\", \"time_used\": ").append(arena.number(result.time_used));
+    line.append(", \"mem_used\": ").append(arena.number(result.mem_used));
+    line.append(", \"output_len\": ").append(arena.number(result.output_len));
+    line.append(", \"total_ms\": ").append(arena.number(total_ms)).append("}\n");
+
+    int fd = open(trace_file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1 || write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+    {
+        cerr << "Failed to append trace record to " << trace_file << endl;
+    }
+    if (fd != -1)
+        close(fd);
+}
+
+/**
+ * @brief 获取主机类别标识
+ * @return string_view 由/proc/cpuinfo中的CPU型号整理得到的标识(位于任务arena)
+ *
+ * 只保留字母数字，其余字符替换为下划线，用作校准结果的目录名
+ */
+string_view hostClass()
+{
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    char line[512];
+    string_view model = "unknown";
+    while (cpuinfo != nullptr && fgets(line, sizeof(line), cpuinfo) != nullptr)
+    {
+        if (strncmp(line, "model name", 10) == 0)
+        {
+            const char *colon = strchr(line, ':');
+            if (colon != nullptr)
+            {
+                model = string_view(colon + 1);
+                break;
+            }
+        }
+    }
+    if (cpuinfo != nullptr)
+        fclose(cpuinfo);
+
+    pmr::string id(&JobArena::current());
+    for (char c : model)
+    {
+        if (isalnum(static_cast<unsigned char>(c)))
+            id += c;
+        else if (!id.empty() && id.back() != '_')
+            id += '_';
+    }
+    while (!id.empty() && id.back() == '_')
+        id.pop_back();
+    return JobArena::current().store(id.empty() ? string_view("unknown") : string_view(id));
+}
+
+/**
+ * @brief 时限校准模式入口
+ * @return int 进程退出码
+ *
+ * 用法：--calibrate <problem_id> <limits_file> <source_file>[,<source_file>...] <input_file>...
+ *
+ * @details 校准流程：
+ *          1. 编译全部标准程序
+ *          2. 每个(标准程序, 测试点)组合运行calibrate_runs次，通过runParallel
+ *             在租用的独占核心上并行执行
+ *          3. 统计每个测试点的运行时间分布(min/median/max/mean/stddev)
+ *          4. 建议时限 = 最慢一次运行 × calibrate_factor%，向上取整到10ms
+ *          5. 结果输出到stdout并保存到calibration/<problem_id>/<host_class>.json
+ *
+ * @note 标准程序以calibrate_time_limit而不是题目时限运行，避免慢的标准程序被截断后
+ *       得到偏小的建议时限；超过该时限的运行计入failed_runs
+ * @note problem_id用作目录名，不允许包含'/'或".."
+ */
+int calibrateMain(int argc, char *argv[])
+{
+    if (argc < 6)
+    {
+        cerr << "Usage: " << argv[0] << " --calibrate <problem_id> <limits_file> <source_file>[,<source_file>...] <input_file>..." << endl;
+        return 1;
+    }
+
+    JobArena &arena = JobArena::current();
+    string problem_id = argv[2];
+    if (problem_id.empty() || problem_id.find('/') != string::npos || problem_id.find("..") != string::npos)
+    {
+        cerr << "Invalid problem_id (must not be empty or contain '/' or \"..\"): " << problem_id << endl;
+        return 1;
+    }
+    Limits limits = loadLimits(argv[3]);
+    CpuFreqGuard::checkAtStartup(limits);
+    vector<string> input_files(argv + 5, argv + argc);
+
+    // 拆分并编译全部标准程序
+    vector<string> sources;
+    string source_list = argv[4];
+    for (size_t begin = 0; begin <= source_list.size();)
+    {
+        size_t end = source_list.find(',', begin);
+        if (end == string::npos)
+            end = source_list.size();
+        if (end > begin)
+            sources.push_back(source_list.substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    vector<string> executables;
+    for (const string &source : sources)
+    {
+        string executable = source + ".out";
+        JudgeResult compiled = compileProgram(source, executable, limits);
+        if (compiled.status != "OK")
+        {
+            for (const string &built : executables)
+                unlink(built.c_str());
+            cout << resultToJson(compiled) << endl;
+            return 1;
+        }
+        executables.push_back(executable);
+    }
+
+    vector<unique_ptr<WarmBinary>> warm;
+    for (const string &executable : executables)
+        warm.push_back(make_unique<WarmBinary>(executable, limits.prefetch_binary));
+
+    // 校准测的是标准程序本身的耗时，不能被题目时限截断
+    Limits run_limits = limits;
+    run_limits.time_limit = max(limits.time_limit, limits.calibrate_time_limit);
+    run_limits.normalize_time = 0;
+
+    // 展开为(标准程序, 测试点, 第几次)的任务列表并行执行
+    size_t runs = static_cast<size_t>(limits.calibrate_runs);
+    size_t task_count = executables.size() * input_files.size() * runs;
+    vector<JudgeResult> results(task_count);
+    runParallel(task_count, CpuLease::allowedCpus().size(), [&](size_t task)
+                {
+                    size_t source_index = task / (input_files.size() * runs);
+                    size_t case_index = task / runs % input_files.size();
+                    results[task] = runProgram(executables[source_index], input_files[case_index], run_limits); });
+
+    for (const string &executable : executables)
+        unlink(executable.c_str());
+
+    // 统计每个测试点的时间分布
+    pmr::string out(&arena);
+    out += "{\n";
+    out += "  \"problem_id\": \"";
+    appendJsonEscaped(out, problem_id);
+    out += "\",\n  \"host_class\": \"";
+    appendJsonEscaped(out, hostClass());
+    out += "\",\n";
+    out.append("  \"runs_per_case\": ").append(arena.number(static_cast<long long>(runs))).append(",\n");
+    out += "  \"cases\": [";
+
+    long long slowest = 0;
+    long long failed_runs = 0;
+    for (size_t source_index = 0; source_index < executables.size(); source_index++)
+    {
+        for (size_t case_index = 0; case_index < input_files.size(); case_index++)
+        {
+            vector<long long> times;
+            for (size_t run = 0; run < runs; run++)
+            {
+                const JudgeResult &result = results[(source_index * input_files.size() + case_index) * runs + run];
+                if (result.status != "OK")
+                {
+                    failed_runs++;
+                    continue;
+                }
+                times.push_back(result.time_used);
+            }
+            sort(times.begin(), times.end());
+
+            double mean = 0, variance = 0;
+            for (long long t : times)
+                mean += static_cast<double>(t);
+            mean = times.empty() ? 0 : mean / static_cast<double>(times.size());
+            for (long long t : times)
+                variance += (static_cast<double>(t) - mean) * (static_cast<double>(t) - mean);
+            double stddev = times.empty() ? 0 : sqrt(variance / static_cast<double>(times.size()));
+
+            long long min_time = times.empty() ? 0 : times.front();
+            long long max_time = times.empty() ? 0 : times.back();
+            long long median_time = times.empty() ? 0 : times[(times.size() - 1) / 2];
+            slowest = max(slowest, max_time);
+
+            out += (source_index == 0 && case_index == 0) ? "\n" : ",\n";
+            out += "    {\"source\": \"";
+            appendJsonEscaped(out, sources[source_index]);
+            out += "\", \"input\": \"";
+            appendJsonEscaped(out, input_files[case_index]);
+            out.append("\", \"min\": ").append(arena.number(min_time));
+            out.append(", \"median\": ").append(arena.number(median_time));
+            out.append(", \"max\": ").append(arena.number(max_time));
+            out.append(", \"mean\": ").append(arena.number(llround(mean)));
+            out.append(", \"stddev\": ").append(arena.number(llround(stddev)));
+            out.append(", \"samples\": ").append(arena.number(static_cast<long long>(times.size()))).append("}");
+        }
+    }
+
+    long long proposed = (slowest * limits.calibrate_factor / 100 + 9) / 10 * 10;
+    out += "\n  ],\n";
+    out.append("  \"failed_runs\": ").append(arena.number(failed_runs)).append(",\n");
+    out.append("  \"slowest\": ").append(arena.number(slowest)).append(",\n");
+    out.append("  \"factor_percent\": ").append(arena.number(limits.calibrate_factor)).append(",\n");
+    out.append("  \"proposed_time_limit\": ").append(arena.number(proposed)).append("\n");
+    out += "}";
+
+    cout << out << endl;
+
+    // 按题目和主机类别保存校准结果
+    string_view result_dir = arena.concat({"calibration/", problem_id});
+    mkdir("calibration", 0755);
+    mkdir(result_dir.data(), 0755);
+    string_view result_path = arena.concat({result_dir, "/", hostClass(), ".json"});
+    int fd = open(result_path.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1 || write(fd, out.data(), out.size()) != static_cast<ssize_t>(out.size()))
+    {
+        cerr << "Failed to save calibration result to " << result_path << endl;
+    }
+    if (fd != -1)
+        close(fd);
+
+    return failed_runs == 0 ? 0 : 2;
+}
+
+/**
+ * @brief 对拍模式入口
+ * @return int 进程退出码：0未发现差异，2发现差异，1出错
+ *
+ * 用法：--stress <limits_file> <generator> <brute> <solution> [iterations] [seed]
+ *
+ * @details 对拍流程：
+ *          1. 三个程序各编译一次
+ *          2. 每个可用核心一个工作线程，各自租用核心并创建一个cgroup，整个对拍过程复用
+ *          3. 每轮：generator以种子(seed + 轮次)为唯一参数生成输入写入memfd，
+ *             brute和solution从同一memfd读入，输出写入各自的memfd
+ *          4. 用记号比较器比较两份输出；solution非OK也视为差异
+ *          5. 发现差异后全部工作线程停止，保存最小轮次的
+ *             stress_<seed>.in / .ans / .out
+ *          6. 输出迭代次数、耗时和每秒迭代数
+ *
+ * @note generator或brute本身运行失败时同样停止并保存输入，状态分别为GEN_FAIL/BRUTE_FAIL
+ */
+int stressMain(int argc, char *argv[])
+{
+    if (argc < 6)
+    {
+        cerr << "Usage: " << argv[0] << " --stress <limits_file> <generator> <brute> <solution> [iterations] [seed]" << endl;
+        return 1;
+    }
+
+    JobArena &arena = JobArena::current();
+    Limits limits = loadLimits(argv[2]);
+    CpuFreqGuard::checkAtStartup(limits);
+    long long iterations = argc > 6 ? atoll(argv[6]) : 1000000;
+    long long base_seed = argc > 7 ? atoll(argv[7]) : 1;
+
+    // 编译generator、brute、solution
+    const char *roles[3] = {"generator", "brute", "solution"};
+    vector<string> executables;
+    for (int i = 0; i < 3; i++)
+    {
+        string source = argv[3 + i];
+        string executable = source + ".out";
+        JudgeResult compiled = compileProgram(source, executable, limits);
+        if (compiled.status != "OK")
+        {
+            for (const string &built : executables)
+                unlink(built.c_str());
+            cerr << "Failed to compile " << roles[i] << endl;
+            cout << resultToJson(compiled) << endl;
+            return 1;
+        }
+        executables.push_back(executable);
+    }
+
+    atomic<long long> next_iteration{0};
+    atomic<long long> completed{0};
+    atomic<bool> stop{false};
+    mutex failure_mutex;
+    long long failed_iteration = -1;
+    string_view failure_status = "OK";
+    string_view solution_status = "";
+    string failed_input, failed_answer, failed_output;
+    string_view setup_error = "";
+
+    size_t worker_count = max<size_t>(1, CpuLease::allowedCpus().size());
+    auto start_time = high_resolution_clock::now();
+
+    runParallel(worker_count, worker_count, [&](size_t)
+                {
+        CgroupManager cgroup;
+        int input_fd = memfd_create("stress_input", MFD_CLOEXEC);
+        int answer_fd = memfd_create("stress_answer", MFD_CLOEXEC);
+        int output_fd = memfd_create("stress_output", MFD_CLOEXEC);
+        if (!cgroup.create() || !cgroup.setMemoryLimit(limits.memory_limit) || !cgroup.setProcessLimit(limits.process_limit) ||
+            !cgroup.setCpuLimit(limits) || input_fd == -1 || answer_fd == -1 || output_fd == -1)
+        {
+            lock_guard<mutex> lock(failure_mutex);
+            setup_error = "Failed to set up stress worker (cgroup/memfd)";
+            stop = true;
+        }
+
+        vector<char> answer_buffer, output_buffer, input_buffer;
+        char seed_text[24];
+        while (!stop)
+        {
+            long long iteration = next_iteration++;
+            if (iteration >= iterations)
+                break;
+
+            auto [seed_end, ec] = to_chars(seed_text, seed_text + sizeof(seed_text) - 1, base_seed + iteration);
+            (void)ec;
+            *seed_end = '\0';
+            const char *seed_argument[1] = {seed_text};
+
+            rewindFd(input_fd, true);
+            JudgeResult generated = runInSandbox(cgroup, executables[0].c_str(), seed_argument, -1, input_fd, limits);
+
+            string_view status = "OK";
+            JudgeResult solved;
+            if (generated.status != "OK")
+            {
+                status = "GEN_FAIL";
+            }
+            else
+            {
+                rewindFd(input_fd, false);
+                rewindFd(answer_fd, true);
+                JudgeResult brute = runInSandbox(cgroup, executables[1].c_str(), {}, input_fd, answer_fd, limits);
+                rewindFd(input_fd, false);
+                rewindFd(output_fd, true);
+                solved = runInSandbox(cgroup, executables[2].c_str(), {}, input_fd, output_fd, limits);
+
+                if (brute.status != "OK")
+                    status = "BRUTE_FAIL";
+                else if (solved.status != "OK" ||
+                         !compareTokens(readWholeFd(output_fd, output_buffer), readWholeFd(answer_fd, answer_buffer)))
+                    status = "MISMATCH";
+            }
+
+            if (status == "OK")
+            {
+                completed++;
+                continue;
+            }
+
+            // 多个工作线程同时发现差异时保留轮次最小的一组
+            lock_guard<mutex> lock(failure_mutex);
+            stop = true;
+            if (failed_iteration == -1 || iteration < failed_iteration)
+            {
+                failed_iteration = iteration;
+                failure_status = status;
+                solution_status = solved.status;
+                failed_input = readWholeFd(input_fd, input_buffer);
+                failed_answer = readWholeFd(answer_fd, answer_buffer);
+                failed_output = readWholeFd(output_fd, output_buffer);
+            }
+        }
+
+        for (int fd : {input_fd, answer_fd, output_fd})
+        {
+            if (fd != -1)
+                close(fd);
+        } });
+
+    long long elapsed_ms = duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count();
+
+    for (const string &executable : executables)
+        unlink(executable.c_str());
+
+    if (!setup_error.empty())
+    {
+        cerr << setup_error << endl;
+        return 1;
+    }
+
+    pmr::string out(&arena);
+    out += "{\n";
+    out.append("  \"status\": \"").append(failure_status).append("\",\n");
+    out.append("  \"iterations\": ").append(arena.number(completed.load())).append(",\n");
+    out.append("  \"workers\": ").append(arena.number(static_cast<long long>(worker_count))).append(",\n");
+    out.append("  \"elapsed_ms\": ").append(arena.number(elapsed_ms)).append(",\n");
+    double per_second = elapsed_ms > 0 ? static_cast<double>(completed.load()) * 1000.0 / static_cast<double>(elapsed_ms) : 0;
+    out.append("  \"iterations_per_second\": ").append(arena.decimal(per_second, 1));
+
+    if (failed_iteration != -1)
+    {
+        // 保存导致差异的输入和两份输出
+        long long seed = base_seed + failed_iteration;
+        string_view prefix = arena.concat({"stress_", arena.number(seed)});
+        const string *contents[3] = {&failed_input, &failed_answer, &failed_output};
+        const char *suffixes[3] = {".in", ".ans", ".out"};
+        for (int i = 0; i < 3; i++)
+        {
+            string_view path = arena.concat({prefix, suffixes[i]});
+            int fd = open(path.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd == -1 || write(fd, contents[i]->data(), contents[i]->size()) != static_cast<ssize_t>(contents[i]->size()))
+                cerr << "Failed to save " << path << endl;
+            if (fd != -1)
+                close(fd);
+        }
+
+        out.append(",\n  \"seed\": ").append(arena.number(seed));
+        out.append(",\n  \"solution_status\": \"").append(solution_status).append("\"");
+        out.append(",\n  \"input_file\": \"").append(prefix).append(".in\"");
+    }
+    out += "\n}";
+
+    cout << out << endl;
+    return failed_iteration == -1 ? 0 : 2;
+}
+
+/**
+ * @class InputStream
+ * @brief 按固定大小缓冲区流式读取输入文件
+ *
+ * 校验器逐字符检查格式，整个文件不需要一次读入内存
+ */
+class InputStream
+{
+private:
+    int fd;                 ///< 输入文件描述符
+    char buffer[64 << 10];  ///< 读缓冲区
+    size_t position = 0;    ///< 缓冲区内的读取位置
+    size_t length = 0;      ///< 缓冲区内的有效字节数
+
+public:
+    long long line = 1; ///< 当前行号
+
+    explicit InputStream(int input_fd) : fd(input_fd) {}
+
+    /**
+     * @brief 查看下一个字符
+     * @return int 字符，文件结束返回EOF
+     */
+    int peek()
+    {
+        if (position == length)
+        {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0)
+                return EOF;
+            position = 0;
+            length = static_cast<size_t>(n);
+        }
+        return static_cast<unsigned char>(buffer[position]);
+    }
+
+    /**
+     * @brief 读取下一个字符
+     */
+    int get()
+    {
+        int c = peek();
+        if (c != EOF)
+        {
+            position++;
+            if (c == '\n')
+                line++;
+        }
+        return c;
+    }
+
+    /**
+     * @brief 读取一个记号(连续的非空白可见字符)
+     * @param token 输出缓冲区，超过容量的部分只计长度不保存
+     * @return size_t 记号长度
+     */
+    size_t readToken(string &token, size_t capacity)
+    {
+        token.clear();
+        size_t token_length = 0;
+        for (int c = peek(); c != EOF && c > ' ' && c < 127; c = peek())
+        {
+            if (token.size() < capacity)
+                token += static_cast<char>(get());
+            else
+                get();
+            token_length++;
+        }
+        return token_length;
+    }
+};
+
+/**
+ * @struct SpecBound
+ * @brief 格式说明中的数值：整数常量或之前绑定的变量名
+ */
+struct SpecBound
+{
+    long long value = 1; ///< 常量值
+    string variable;     ///< 变量名，非空时取变量的值
+};
 
-    pid_t pid = fork();
-    if (pid == -1)
+/**
+ * @struct SpecItem
+ * @brief 格式说明中一行里的一个条目
+ */
+struct SpecItem
+{
+    bool is_string = false; ///< true为str(长度范围)，false为int(取值范围)
+    string name;            ///< 绑定的变量名，可为空
+    SpecBound low;          ///< 下界
+    SpecBound high;         ///< 上界
+    SpecBound count;        ///< 同一行内重复次数
+};
+
+/**
+ * @struct SpecLine
+ * @brief 格式说明中的一行，对应输入中的repeat行
+ */
+struct SpecLine
+{
+    SpecBound repeat;       ///< 输入中重复的行数
+    vector<SpecItem> items; ///< 每行的条目
+};
+
+/**
+ * @brief 解析格式说明中的一个数值
+ * @return bool 格式正确返回true
+ *
+ * 支持十进制整数、1e9这样的科学计数写法(仅整数)以及变量名
+ */
+bool parseSpecBound(string_view text, SpecBound &bound)
+{
+    if (text.empty())
+        return false;
+    if (isalpha(static_cast<unsigned char>(text[0])) || text[0] == '_')
     {
-        result.error_message = "Failed to fork process";
-        close(stdout_pipe[0]);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[0]);
-        close(stderr_pipe[1]);
-        return result;
+        bound.variable = string(text);
+        return true;
     }
 
-    if (pid == 0)
+    size_t e = text.find_first_of("eE");
+    string_view mantissa = text.substr(0, e);
+    auto [end, ec] = from_chars(mantissa.data(), mantissa.data() + mantissa.size(), bound.value);
+    if (ec != errc() || end != mantissa.data() + mantissa.size())
+        return false;
+    if (e != string_view::npos)
     {
-        // 子进程
+        int exponent = 0;
+        string_view digits = text.substr(e + 1);
+        auto [exp_end, exp_ec] = from_chars(digits.data(), digits.data() + digits.size(), exponent);
+        if (exp_ec != errc() || exp_end != digits.data() + digits.size() || exponent < 0 || exponent > 18)
+            return false;
+        for (int i = 0; i < exponent; i++)
+        {
+            if (bound.value > LLONG_MAX / 10 || bound.value < LLONG_MIN / 10)
+                return false;
+            bound.value *= 10;
+        }
+    }
+    return true;
+}
 
-        // 重定向标准输入
-        int input_fd = open(input_file.c_str(), O_RDONLY);
-        if (input_fd == -1)
+/**
+ * @brief 解析声明式格式说明
+ * @param spec 格式说明全文
+ * @param lines 输出的行列表
+ * @return string 错误信息，成功时为空
+ *
+ * @details 每个非空、非#开头的行描述输入中的一行：
+ *          - [repeat <次数>:] 条目 条目 ...
+ *          - 条目：[名字=]int(下界,上界)[*次数] 或 [名字=]str(最短,最长)[*次数]
+ *          - 数值可以是整数常量、1e5形式或之前绑定的变量名
+ *
+ * 例如：
+ *          n=int(1,1e5) m=int(0,2e5)
+ *          int(1,1e9)*n
+ *          repeat m: int(1,n) int(1,n)
+ */
+string parseSpec(string_view spec, vector<SpecLine> &lines)
+{
+    for (size_t begin = 0, number = 1; begin < spec.size(); number++)
+    {
+        size_t end = spec.find('\n', begin);
+        if (end == string_view::npos)
+            end = spec.size();
+        string_view text = spec.substr(begin, end - begin);
+        begin = end + 1;
+
+        string where = "spec line " + to_string(number) + ": ";
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == string_view::npos || text[first] == '#')
+            continue;
+        text = text.substr(first);
+
+        SpecLine line;
+        if (text.substr(0, 7) == "repeat ")
         {
-            exit(1);
+            size_t colon = text.find(':');
+            if (colon == string_view::npos || !parseSpecBound(text.substr(7, colon - 7), line.repeat))
+                return where + "bad repeat count";
+            text = text.substr(colon + 1);
         }
-        dup2(input_fd, STDIN_FILENO);
-        close(input_fd);
 
-        // 重定向标准输出和错误输出
-        dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stderr_pipe[1], STDERR_FILENO);
-        close(stdout_pipe[0]);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[0]);
-        close(stderr_pipe[1]);
+        istringstream items{string(text)};
+        string word;
+        while (items >> word)
+        {
+            SpecItem item;
+            string_view rest = word;
+            size_t equals = rest.find('=');
+            if (equals != string_view::npos)
+            {
+                item.name = string(rest.substr(0, equals));
+                rest = rest.substr(equals + 1);
+            }
+            if (rest.substr(0, 4) == "int(")
+                item.is_string = false;
+            else if (rest.substr(0, 4) == "str(")
+                item.is_string = true;
+            else
+                return where + "unknown item '" + word + "'";
 
-        // 设置资源限制
-        struct rlimit rl;
+            size_t comma = rest.find(',');
+            size_t close_paren = rest.find(')');
+            if (comma == string_view::npos || close_paren == string_view::npos || comma > close_paren ||
+                !parseSpecBound(rest.substr(4, comma - 4), item.low) ||
+                !parseSpecBound(rest.substr(comma + 1, close_paren - comma - 1), item.high))
+                return where + "bad range in '" + word + "'";
 
-        // 时间限制 (CPU时间)
-        rl.rlim_cur = (limits.time_limit + 999) / 1000; // 向上取整到秒
-        rl.rlim_max = rl.rlim_cur + 1;
-        setrlimit(RLIMIT_CPU, &rl);
+            rest = rest.substr(close_paren + 1);
+            if (!rest.empty())
+            {
+                if (rest[0] != '*' || !parseSpecBound(rest.substr(1), item.count))
+                    return where + "bad count in '" + word + "'";
+                if (!item.name.empty())
+                    return where + "cannot bind repeated item '" + word + "'";
+            }
+            line.items.push_back(item);
+        }
+        if (line.items.empty())
+            return where + "no items";
+        lines.push_back(line);
+    }
+    return "";
+}
 
-        // 栈限制
-        rl.rlim_cur = limits.stack_limit;
-        rl.rlim_max = limits.stack_limit;
-        setrlimit(RLIMIT_STACK, &rl);
+/**
+ * @brief 按格式说明流式校验输入
+ * @param lines 已解析的格式说明
+ * @param input_fd 输入文件
+ * @return string 错误信息，输入合法时为空
+ *
+ * 格式要求与testlib校验器的严格模式一致：同一行的记号之间恰好一个空格，
+ * 每行以'\n'结束，不允许行末空格和'\r'，最后一行之后必须是文件结尾
+ */
+string validateWithSpec(const vector<SpecLine> &lines, int input_fd)
+{
+    InputStream in(input_fd);
+    unordered_map<string, long long> variables;
+    string token;
 
-        // 输出限制
-        rl.rlim_cur = limits.output_limit;
-        rl.rlim_max = limits.output_limit;
-        setrlimit(RLIMIT_FSIZE, &rl);
+    auto resolve = [&](const SpecBound &bound, long long &value) -> bool
+    {
+        if (bound.variable.empty())
+        {
+            value = bound.value;
+            return true;
+        }
+        auto it = variables.find(bound.variable);
+        if (it == variables.end())
+            return false;
+        value = it->second;
+        return true;
+    };
+    auto at_line = [&]()
+    { return "line " + to_string(in.line) + ": "; };
 
-        // 进程数限制
-        rl.rlim_cur = 1;
-        rl.rlim_max = 1;
-        setrlimit(RLIMIT_NPROC, &rl);
+    for (const SpecLine &spec_line : lines)
+    {
+        long long repeat;
+        if (!resolve(spec_line.repeat, repeat))
+            return "undefined variable '" + spec_line.repeat.variable + "'";
+
+        for (long long r = 0; r < repeat; r++)
+        {
+            bool first_token = true;
+            for (const SpecItem &item : spec_line.items)
+            {
+                long long count, low, high;
+                if (!resolve(item.count, count) || !resolve(item.low, low) || !resolve(item.high, high))
+                    return "undefined variable in item bounds";
+
+                for (long long k = 0; k < count; k++)
+                {
+                    if (!first_token && in.get() != ' ')
+                        return at_line() + "expected a single space";
+                    first_token = false;
 
-        // 执行程序
-        execl(executable.c_str(), executable.c_str(), (char *)nullptr);
-        exit(1); // 如果execl失败
+                    size_t length = in.readToken(token, 32);
+                    if (length == 0)
+                        return at_line() + "expected a token";
+
+                    if (item.is_string)
+                    {
+                        if (static_cast<long long>(length) < low || static_cast<long long>(length) > high)
+                            return at_line() + "string length " + to_string(length) + " not in [" + to_string(low) + ", " + to_string(high) + "]";
+                        continue;
+                    }
+
+                    // 整数：不允许前导零、"-0"和超出long long的值
+                    long long value = 0;
+                    auto [end, ec] = from_chars(token.data(), token.data() + token.size(), value);
+                    bool digits_ok = length == token.size() && ec == errc() && end == token.data() + token.size();
+                    bool leading_zero = token.size() > 1 && (token[0] == '0' || (token[0] == '-' && token[1] == '0'));
+                    if (!digits_ok || leading_zero)
+                        return at_line() + "expected an integer, got '" + token + "'";
+                    if (value < low || value > high)
+                        return at_line() + "integer " + token + " not in [" + to_string(low) + ", " + to_string(high) + "]";
+                    if (!item.name.empty())
+                        variables[item.name] = value;
+                }
+            }
+            if (in.get() != '\n')
+                return at_line() + "expected end of line";
+        }
     }
-    else
+
+    if (in.peek() != EOF)
+        return at_line() + "expected end of file";
+    return "";
+}
+
+/**
+ * @brief 输入校验模式入口
+ * @return int 进程退出码：0全部合法，2存在不合法的输入，1出错(含校验器本身运行失败)
+ *
+ * 用法：--validate <limits_file> <validator.cpp|format.spec> <input_file>...
+ *
+ * @details 校验流程：
+ *          1. 校验器以.cpp结尾时经编译缓存编译为程序，标准输入为待校验文件，退出码0表示合法；
+ *             否则作为声明式格式说明解析(见parseSpec)，在本进程内流式校验
+ *          2. 各输入通过runParallel在可用核心上并行校验
+ *          3. 结果按(校验器内容哈希, 输入内容哈希)缓存在
+ *             .judge_cache/validate/下，内容未变的输入不再重复校验
+ *
+ * @note 只缓存确定的结论：校验器正常退出(0为合法，非0为不合法)。超时、被信号杀死、
+ *       exec失败等SE结果可能来自主机噪声，只在本次输出中报告为错误，下次重新校验
+ */
+int validateMain(int argc, char *argv[])
+{
+    if (argc < 5)
     {
-        // 父进程
+        cerr << "Usage: " << argv[0] << " --validate <limits_file> <validator.cpp|format.spec> <input_file>..." << endl;
+        return 1;
+    }
 
-        // 将子进程添加到cgroup
-        if (!cgroup.addProcess(pid))
+    JobArena &arena = JobArena::current();
+    Limits limits = loadLimits(argv[2]);
+    string validator = argv[3];
+    vector<string> input_files(argv + 4, argv + argc);
+
+    bool compiled_validator = validator.size() > 4 && validator.compare(validator.size() - 4, 4, ".cpp") == 0;
+    uint64_t validator_hash = hashFile(validator.c_str());
+    if (validator_hash == 0)
+    {
+        cerr << "Failed to read validator " << validator << endl;
+        return 1;
+    }
+
+    vector<SpecLine> spec;
+    if (!compiled_validator)
+    {
+        vector<char> spec_text;
+        int fd = open(validator.c_str(), O_RDONLY | O_CLOEXEC);
+        string_view text = fd == -1 ? string_view() : readWholeFd(fd, spec_text);
+        if (fd != -1)
+            close(fd);
+        string error = parseSpec(text, spec);
+        if (!error.empty())
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+
+    mkdir(".judge_cache", 0755);
+    mkdir(".judge_cache/validate", 0755);
+
+    // 先查缓存，只有未命中的输入需要编译校验器并运行
+    vector<string_view> cache_paths(input_files.size());
+    vector<int> valid(input_files.size(), -1);
+    vector<string_view> messages(input_files.size());
+    vector<char> cached(input_files.size(), 0);
+    vector<size_t> pending;
+    for (size_t i = 0; i < input_files.size(); i++)
+    {
+        uint64_t input_hash = hashFile(input_files[i].c_str());
+        if (input_hash == 0)
+        {
+            valid[i] = 0;
+            messages[i] = "Failed to read input";
+            continue;
+        }
+        cache_paths[i] = arena.concat({".judge_cache/validate/", hashToHex(validator_hash), "_", hashToHex(input_hash)});
+
+        // 缓存内容："1"表示合法，"0 <信息>"表示不合法
+        char entry[256];
+        string_view cached_entry = readSmallFile(cache_paths[i].data(), entry, sizeof(entry));
+        if (!cached_entry.empty())
+        {
+            valid[i] = cached_entry[0] == '1';
+            messages[i] = arena.store(cached_entry.size() > 2 ? cached_entry.substr(2) : string_view());
+            cached[i] = 1;
+        }
+        else
+        {
+            pending.push_back(i);
+        }
+    }
+
+    string executable;
+    if (compiled_validator && !pending.empty())
+    {
+        JudgeResult compiled = compileCached(validator, limits, executable);
+        if (compiled.status != "OK")
+        {
+            cout << resultToJson(compiled) << endl;
+            return 1;
+        }
+    }
+
+    // 工作线程各写各的下标，用vector<char>而不是按位打包的vector<bool>，避免相邻下标的写互相覆盖
+    vector<char> failed(input_files.size(), 0);
+    runParallel(pending.size(), CpuLease::allowedCpus().size(), [&](size_t task)
+                {
+        size_t index = pending[task];
+        string message;
+        if (compiled_validator)
+        {
+            JudgeResult result = runProgram(executable, input_files[index], limits);
+            valid[index] = result.status == "OK";
+            message = valid[index] ? "" : string(result.error_message);
+            // 只有正常退出(0或非0退出码)才是校验器的结论
+            bool clean_exit = result.status == "OK" ||
+                              (result.status == "RE" && result.error_message.starts_with("Program exited with non-zero code"));
+            if (!clean_exit)
+            {
+                failed[index] = 1;
+                message = "Validator failed (" + string(result.status) + "): " + message;
+            }
+        }
+        else
+        {
+            int fd = open(input_files[index].c_str(), O_RDONLY | O_CLOEXEC);
+            message = fd == -1 ? "Failed to read input" : validateWithSpec(spec, fd);
+            if (fd != -1)
+                close(fd);
+            valid[index] = message.empty();
+        }
+
+        // 缓存文件只保存一行，截断过长的信息
+        message = message.substr(0, 200);
+        replace(message.begin(), message.end(), '\n', ' ');
+        messages[index] = JobArena::current().store(message);
+        if (!failed[index])
+            writeSmallFile(cache_paths[index].data(), JobArena::current().concat({valid[index] ? "1" : "0", " ", message})); });
+
+    pmr::string out(&arena);
+    size_t invalid_count = 0, failed_count = 0;
+    out += "{\n  \"cases\": [";
+    for (size_t i = 0; i < input_files.size(); i++)
+    {
+        failed_count += failed[i];
+        invalid_count += valid[i] != 1 && !failed[i];
+        out += i == 0 ? "\n" : ",\n";
+        out += "    {\"input\": \"";
+        appendJsonEscaped(out, input_files[i]);
+        out.append("\", \"valid\": ").append(valid[i] == 1 ? "true" : "false");
+        out.append(", \"failed\": ").append(failed[i] ? "true" : "false");
+        out.append(", \"cached\": ").append(cached[i] ? "true" : "false");
+        out += ", \"message\": \"";
+        appendJsonEscaped(out, messages[i]);
+        out += "\"}";
+    }
+    out += "\n  ],\n";
+    out.append("  \"validated\": ").append(arena.number(static_cast<long long>(pending.size()))).append(",\n");
+    out.append("  \"invalid\": ").append(arena.number(static_cast<long long>(invalid_count))).append(",\n");
+    out.append("  \"failed\": ").append(arena.number(static_cast<long long>(failed_count))).append("\n");
+    out += "}";
+
+    cout << out << endl;
+    if (failed_count > 0)
+        return 1;
+    return invalid_count == 0 ? 0 : 2;
+}
+
+/**
+ * @struct Subtask
+ * @brief 子任务清单中的一个子任务
+ */
+struct Subtask
+{
+    string id;                   ///< 子任务编号
+    double score = 0;            ///< 满分
+    bool sum_scoring = false;    ///< false为min计分(IOI)，true为按测试点平均
+    vector<size_t> depends;      ///< 依赖的子任务下标
+    vector<size_t> dependents;   ///< 直接依赖本子任务的子任务下标
+    vector<string> inputs;       ///< 测试输入
+};
+
+/**
+ * @struct MaterializedCase
+ * @brief 测试点的实际输入和答案路径
+ */
+struct MaterializedCase
+{
+    string input;  ///< 输入文件
+    string answer; ///< 标准答案文件，可能不存在
+    string error;  ///< 生成失败的原因，为空表示成功
+    bool generated = false; ///< 本次评测中新生成(未命中缓存)
+};
+
+/**
+ * @class TestData
+ * @brief 测试数据层：普通文件直接使用，生成器配方在首次使用时生成并缓存
+ *
+ * 清单中以"名称(参数,...)@种子"或"名称@种子"书写的测试点是配方，
+ * 由同一清单中"generator <名称> <源文件>"声明的生成器生成输入，
+ * 再由"reference <源文件>"声明的标准程序生成答案
+ *
+ * @details 生成规则：
+ *          - 生成器和标准程序经compileCached编译，进程内每个只编译一次
+ *          - 生成器的参数为配方中的参数，种子作为最后一个参数
+ *          - 生成和求解都在池化cgroup中通过runInSandbox运行，
+ *            时限为generator_time_limit，输出大小不受output_limit限制
+ *          - 输入缓存在.judge_cache/tests/<配方哈希>.in，配方哈希包含生成器可执行文件的键、参数和种子；
+ *            答案缓存在.judge_cache/tests/<配方哈希>_<标准程序键>.ans
+ *          - 先写临时文件再rename；同一配方在进程内只生成一次，其他线程等待结果
+ *          - 清单中声明"validator <校验器.cpp|格式描述>"时，新生成的输入在rename进缓存之前
+ *            先经校验，不合法的输入被丢弃并判为SE；已在缓存中的输入不再重复校验
+ *          - 缓存没有容量上限，评测核心不做淘汰，由部署方按访问时间清理(见README)
+ */
+class TestData
+{
+private:
+    unordered_map<string, string> generator_sources; ///< 生成器名 → 源文件
+    string reference_source;               ///< 标准程序源文件，为空表示没有
+    string validator_source;               ///< 校验器(.cpp)或格式描述文件，为空表示不校验
+    vector<SpecLine> validator_spec;       ///< 格式描述文件解析结果
+
+    mutex compile_mutex;
+    unordered_map<string, string> executables; ///< 源文件 → 编译缓存中的可执行文件，编译失败时为空
+
+    mutex cases_mutex;
+    unordered_map<string, shared_future<MaterializedCase>> cases; ///< 配方 → 生成结果
+
+    /**
+     * @brief 编译生成器或标准程序(进程内只编译一次)
+     * @return string 可执行文件路径，编译失败返回空串
+     */
+    string executableFor(const string &source, const Limits &limits)
+    {
+        lock_guard<mutex> guard(compile_mutex);
+        auto it = executables.find(source);
+        if (it != executables.end())
+            return it->second;
+
+        Limits compile_limits = limits;
+        compile_limits.compile_timeout = max(limits.compile_timeout, 30000);
+        string executable;
+        JudgeResult compiled = compileCached(source, compile_limits, executable);
+        if (compiled.status != "OK")
+            executable.clear();
+        executables[source] = executable;
+        return executable;
+    }
+
+    /**
+     * @brief 在沙箱中运行一次程序，输出写入临时文件后rename为目标文件
+     * @param accept 可选的检查，对临时文件调用，返回非空串时丢弃输出并以其为失败原因
+     * @return string 失败原因，成功时为空
+     */
+    static string runToFile(const string &executable, span<const char *const> arguments, const string &input_file,
+                            const string &output_file, const Limits &limits,
+                            const function<string(const string &)> &accept = nullptr)
+    {
+        string temporary = output_file + ".tmp" + to_string(getpid()) + "_" + to_string(std::hash<thread::id>{}(this_thread::get_id()));
+        {
+            CgroupPool::Lease cgroup = CgroupPool::instance().acquire(limits);
+            if (!cgroup)
+                return "Failed to set up sandbox cgroup";
+
+            int input_fd = input_file.empty() ? -1 : open(input_file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (!input_file.empty() && input_fd == -1)
+                return "Failed to open " + input_file;
+            int output_fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (output_fd == -1)
+            {
+                if (input_fd != -1)
+                    close(input_fd);
+                return "Failed to create " + temporary;
+            }
+
+            JudgeResult run = runInSandbox(*cgroup, executable.c_str(), arguments, input_fd, output_fd, limits);
+            close(output_fd);
+            if (input_fd != -1)
+                close(input_fd);
+            if (run.status != "OK")
+            {
+                unlink(temporary.c_str());
+                return string(run.status) + " (exit code " + to_string(run.exit_code) + ")";
+            }
+        }
+
+        // 检查在归还池化cgroup之后进行，检查本身可能需要运行程序
+        if (accept)
+        {
+            string rejection = accept(temporary);
+            if (!rejection.empty())
+            {
+                unlink(temporary.c_str());
+                return rejection;
+            }
+        }
+        if (rename(temporary.c_str(), output_file.c_str()) != 0)
+        {
+            string failure = "Failed to rename " + temporary + " to " + output_file + ": " + strerror(errno);
+            unlink(temporary.c_str());
+            return failure;
+        }
+        return string();
+    }
+
+    /**
+     * @brief 用清单中声明的校验器检查新生成的输入
+     * @return string 不合法或校验器出错时的原因，合法时为空
+     *
+     * 与--validate相同：.cpp校验器正常退出(0或非0退出码)才是结论，其余结果视为校验器故障
+     */
+    string validateGenerated(const string &input, const Limits &limits)
+    {
+        bool compiled = validator_source.size() > 4 && validator_source.compare(validator_source.size() - 4, 4, ".cpp") == 0;
+        if (!compiled)
+        {
+            int fd = open(input.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                return "Failed to read generated input";
+            string message = validateWithSpec(validator_spec, fd);
+            close(fd);
+            return message.empty() ? string() : "Generated input rejected by validator: " + message;
+        }
+
+        string validator = executableFor(validator_source, limits);
+        if (validator.empty())
+            return "Failed to compile validator";
+        JudgeResult result = runProgram(validator, input, limits);
+        if (result.status == "OK")
+            return string();
+        if (result.status == "RE" && result.error_message.starts_with("Program exited with non-zero code"))
+            return "Generated input rejected by validator: " + string(result.error_message);
+        return "Validator failed (" + string(result.status) + "): " + string(result.error_message);
+    }
+
+    /**
+     * @brief 生成一个配方的输入和答案(已缓存的部分直接使用)
+     */
+    MaterializedCase generate(const string &recipe, const Limits &limits)
+    {
+        MaterializedCase result;
+        size_t open_paren = recipe.find('(');
+        size_t at = recipe.rfind('@');
+        string name = recipe.substr(0, min(open_paren, at));
+        string seed = recipe.substr(at + 1);
+        vector<string> arguments;
+        if (open_paren < at)
+        {
+            string list = recipe.substr(open_paren + 1, recipe.rfind(')', at) - open_paren - 1);
+            for (size_t begin = 0; begin <= list.size() && !list.empty();)
+            {
+                size_t comma = min(list.find(',', begin), list.size());
+                arguments.push_back(list.substr(begin, comma - begin));
+                begin = comma + 1;
+            }
+        }
+        arguments.push_back(seed);
+
+        Limits run_limits = limits;
+        run_limits.time_limit = limits.generator_time_limit;
+        run_limits.output_limit = INT_MAX; // 生成的数据可达数百MB
+
+        string generator = executableFor(generator_sources.at(name), limits);
+        if (generator.empty())
+        {
+            result.error = "Failed to compile generator " + name;
+            return result;
+        }
+
+        uint64_t hash = fnv1a64(generator);
+        for (const string &argument : arguments)
+            hash = fnv1a64(argument, fnv1a64(string_view("\0", 1), hash));
+        string key(hashToHex(hash));
+
+        mkdir(".judge_cache", 0755);
+        mkdir(".judge_cache/tests", 0755);
+        result.input = ".judge_cache/tests/" + key + ".in";
+        if (access(result.input.c_str(), R_OK) != 0)
+        {
+            vector<const char *> argv;
+            for (const string &argument : arguments)
+                argv.push_back(argument.c_str());
+            // 声明了校验器时，输入先经校验再进入缓存，不合法的输入不会被缓存
+            function<string(const string &)> accept;
+            if (!validator_source.empty())
+                accept = [&](const string &path)
+                { return validateGenerated(path, run_limits); };
+            string failure = runToFile(generator, argv, "", result.input, run_limits, accept);
+            if (!failure.empty())
+            {
+                result.error = "Generator " + name + " failed: " + failure;
+                return result;
+            }
+            result.generated = true;
+        }
+
+        if (reference_source.empty())
+            return result; // 没有标准程序时只判定运行状态
+
+        string reference = executableFor(reference_source, limits);
+        if (reference.empty())
+        {
+            result.error = "Failed to compile reference solution";
+            return result;
+        }
+        result.answer = ".judge_cache/tests/" + key + "_" + reference.substr(reference.rfind('/') + 1) + ".ans";
+        if (access(result.answer.c_str(), R_OK) != 0)
+        {
+            string failure = runToFile(reference, {}, result.input, result.answer, run_limits);
+            if (!failure.empty())
+                result.error = "Reference solution failed: " + failure;
+        }
+        return result;
+    }
+
+    /**
+     * @brief 生成器名和种子允许的字符：字母、数字、下划线和连字符
+     */
+    static bool isRecipeWord(string_view word)
+    {
+        return !word.empty() &&
+               all_of(word.begin(), word.end(), [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-'; });
+    }
+
+public:
+    /**
+     * @brief 判断测试点是否是生成器配方
+     *
+     * 只有完整的"名称(参数,...)@种子"或"名称@种子"才是配方，
+     * 名称和种子只含字母、数字、下划线和连字符，因此data@v2.in之类的文件名仍按普通文件处理
+     */
+    static bool isRecipe(string_view token)
+    {
+        size_t at = token.rfind('@');
+        if (at == string_view::npos || !isRecipeWord(token.substr(at + 1)))
+            return false;
+        string_view head = token.substr(0, at);
+        size_t open_paren = head.find('(');
+        if (!isRecipeWord(head.substr(0, open_paren)))
+            return false;
+        if (open_paren == string_view::npos)
+            return true;
+        string_view arguments = head.substr(open_paren + 1);
+        return !arguments.empty() && arguments.back() == ')' &&
+               arguments.substr(0, arguments.size() - 1).find_first_of("()@") == string_view::npos;
+    }
+
+    /**
+     * @brief 解析generator/reference声明行
+     * @return bool 不是声明行时返回false；声明格式错误时error非空
+     */
+    bool parseDeclaration(string_view line, string &error)
+    {
+        istringstream words{string(line)};
+        string keyword, name, source, extra;
+        words >> keyword;
+        if (keyword == "generator")
         {
-            result.error_message = "Failed to add process to cgroup";
-            kill(pid, SIGKILL);
-            waitpid(pid, nullptr, 0);
-            close(stdout_pipe[0]);
-            close(stdout_pipe[1]);
-            close(stderr_pipe[0]);
-            close(stderr_pipe[1]);
-            return result;
+            if (!(words >> name >> source) || (words >> extra))
+                error = "expected 'generator <name> <source>'";
+            else if (!isRecipeWord(name))
+                error = "generator name '" + name + "' may only contain letters, digits, '_' and '-'";
+            else if (!generator_sources.emplace(name, source).second)
+                error = "duplicate generator '" + name + "'";
+            return true;
         }
-
-        // 强制CPU绑定到分配的核心
-        string allocated_cpu_str = result.allocated_cpu;
-        if (!allocated_cpu_str.empty())
+        if (keyword == "reference")
         {
-            int allocated_cpu_id = stoi(allocated_cpu_str);
-            if (!cgroup.forceCpuBinding(pid, allocated_cpu_id))
-            {
-                // CPU绑定失败不中止评测，但记录警告
-                result.error_message += "Warning: Failed to set CPU affinity; ";
-            }
+            if (!(words >> source) || (words >> extra))
+                error = "expected 'reference <source>'";
+            else
+                reference_source = source;
+            return true;
         }
-
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
-
-        // 读取输出
-        fd_set read_fds;
-        struct timeval timeout;
-        timeout.tv_sec = (limits.time_limit + 999) / 1000 + 1;
-        timeout.tv_usec = 0;
-
-        string stdout_output, stderr_output;
-        char buffer[4096];
-        bool stdout_done = false, stderr_done = false;
-
-        while (!stdout_done || !stderr_done)
+        if (keyword == "validator")
         {
-            FD_ZERO(&read_fds);
-            int max_fd = 0;
-
-            if (!stdout_done)
+            if (!(words >> source) || (words >> extra))
             {
-                FD_SET(stdout_pipe[0], &read_fds);
-                max_fd = max(max_fd, stdout_pipe[0]);
+                error = "expected 'validator <validator.cpp|format.spec>'";
+                return true;
             }
-            if (!stderr_done)
+            validator_source = source;
+            if (source.size() > 4 && source.compare(source.size() - 4, 4, ".cpp") == 0)
+                return true;
+            vector<char> spec_text;
+            int fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
             {
-                FD_SET(stderr_pipe[0], &read_fds);
-                max_fd = max(max_fd, stderr_pipe[0]);
+                error = "cannot read validator '" + source + "'";
+                return true;
             }
+            error = parseSpec(readWholeFd(fd, spec_text), validator_spec);
+            close(fd);
+            return true;
+        }
+        return false;
+    }
 
-            int select_result = select(max_fd + 1, &read_fds, nullptr, nullptr, &timeout);
+    /**
+     * @brief 检查配方格式和生成器是否已声明
+     * @return string 错误信息，正确时为空
+     */
+    string validateRecipe(const string &recipe) const
+    {
+        size_t at = recipe.rfind('@');
+        size_t open_paren = recipe.find('(');
+        if (at == 0 || at + 1 == recipe.size())
+            return "recipe '" + recipe + "' must be <generator>[(args)]@<seed>";
+        if (open_paren < at && recipe[at - 1] != ')')
+            return "recipe '" + recipe + "' has unbalanced parentheses";
+        string name = recipe.substr(0, min(open_paren, at));
+        if (!generator_sources.contains(name))
+            return "unknown generator '" + name + "'";
+        if (count(recipe.begin(), recipe.end(), ',') + 2 > 8)
+            return "recipe '" + recipe + "' has too many arguments";
+        return string();
+    }
 
-            if (select_result <= 0)
-                break; // 超时或错误
+    /**
+     * @brief 取得测试点的实际输入和答案，配方在首次调用时生成
+     * @param token 清单中的测试点
+     * @param answer_for 普通输入文件到答案文件的映射
+     */
+    MaterializedCase materialize(const string &token, const Limits &limits, const function<string(const string &)> &answer_for)
+    {
+        if (!isRecipe(token))
+        {
+            MaterializedCase result;
+            result.input = token;
+            result.answer = answer_for(token);
+            return result;
+        }
 
-            if (!stdout_done && FD_ISSET(stdout_pipe[0], &read_fds))
+        // 第一个请求该配方的线程负责生成，其余线程等待同一结果
+        promise<MaterializedCase> producer;
+        shared_future<MaterializedCase> pending;
+        bool owner = false;
+        {
+            lock_guard<mutex> guard(cases_mutex);
+            auto it = cases.find(token);
+            if (it != cases.end())
             {
-                ssize_t bytes_read = read(stdout_pipe[0], buffer, sizeof(buffer) - 1);
-                if (bytes_read <= 0)
-                {
-                    stdout_done = true;
-                }
-                else
-                {
-                    buffer[bytes_read] = '\0';
-                    stdout_output += buffer;
-                }
+                pending = it->second;
             }
-
-            if (!stderr_done && FD_ISSET(stderr_pipe[0], &read_fds))
+            else
             {
-                ssize_t bytes_read = read(stderr_pipe[0], buffer, sizeof(buffer) - 1);
-                if (bytes_read <= 0)
-                {
-                    stderr_done = true;
-                }
-                else
-                {
-                    buffer[bytes_read] = '\0';
-                    stderr_output += buffer;
-                }
+                pending = producer.get_future().share();
+                cases.emplace(token, pending);
+                owner = true;
             }
         }
+        if (owner)
+            producer.set_value(generate(token, limits));
+        return pending.get();
+    }
+};
 
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
+/**
+ * @brief 解析子任务清单
+ * @param manifest 清单全文
+ * @param subtasks 输出的子任务列表
+ * @param testdata 记录清单中声明的生成器和标准程序
+ * @return string 错误信息，成功时为空
+ *
+ * @details 每个非空、非#开头的行描述一个子任务：
+ *          subtask <编号> <满分> [min|sum] [depends <编号>...]: <输入文件或配方>...
+ *          - min(默认)：子任务得分 = 满分 × 各测试点得分的最小值
+ *          - sum：子任务得分 = 满分 × 各测试点得分的平均值
+ *          - 编号不能重复；依赖的子任务必须在前面声明；得分比例再与依赖子任务的比例取最小值
+ *          - 标准答案为输入文件去掉.in后缀加.ans，不存在时只判定运行状态
+ *          - generator <名称> <源文件> 与 reference <源文件> 声明生成器和标准程序，
+ *            测试点可写成配方 <名称>(<参数>,...)@<种子>，见TestData
+ */
+string parseSubtaskManifest(string_view manifest, vector<Subtask> &subtasks, TestData &testdata)
+{
+    for (size_t begin = 0, number = 1; begin < manifest.size(); number++)
+    {
+        size_t end = manifest.find('\n', begin);
+        if (end == string_view::npos)
+            end = manifest.size();
+        string_view text = manifest.substr(begin, end - begin);
+        begin = end + 1;
 
-        // 等待子进程结束
-        int status;
-        struct rusage usage;
-        if (wait4(pid, &status, 0, &usage) == -1)
+        string where = "manifest line " + to_string(number) + ": ";
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == string_view::npos || text[first] == '#')
+            continue;
+
+        string declaration_error;
+        if (testdata.parseDeclaration(text.substr(first), declaration_error))
         {
-            result.error_message = "Failed to wait for child process";
-            return result;
+            if (!declaration_error.empty())
+                return where + declaration_error;
+            continue;
         }
 
-        auto end_time = high_resolution_clock::now();
-        result.time_used = duration_cast<milliseconds>(end_time - start_time).count();
-
-        // 从cgroup获取峰值内存使用量
-        long long memory_peak = cgroup.getMemoryPeak();
-
-        result.mem_used = (memory_peak > 0) ? memory_peak : usage.ru_maxrss * 1024; // ru_maxrss 是 KB，需转bit
+        size_t colon = text.find(':');
+        if (colon == string_view::npos)
+            return where + "missing ':'";
 
-        result.stdout_content = stdout_output;
-        result.output_len = stdout_output.length();
+        istringstream header{string(text.substr(first, colon - first))};
+        istringstream cases{string(text.substr(colon + 1))};
+        string keyword, word;
+        Subtask subtask;
+        if (!(header >> keyword >> subtask.id >> subtask.score) || keyword != "subtask" || subtask.score < 0)
+            return where + "expected 'subtask <id> <score>'";
+        if (any_of(subtasks.begin(), subtasks.end(), [&](const Subtask &declared)
+                   { return declared.id == subtask.id; }))
+            return where + "duplicate subtask id '" + subtask.id + "'";
 
-        // 判断退出状态
-        if (WIFEXITED(status))
+        bool in_depends = false;
+        while (header >> word)
         {
-            result.exit_code = WEXITSTATUS(status);
-            if (result.exit_code == 0)
+            if (word == "min" || word == "sum")
             {
-                // 检查是否超时
-                if (result.time_used > limits.time_limit)
-                {
-                    result.status = "TLE";
-                }
-                // 检查内存限制
-                else if (result.mem_used > limits.memory_limit)
-                {
-                    result.status = "MLE";
-                }
-                // 检查输出限制
-                else if (result.output_len > limits.output_limit)
-                {
-                    result.status = "OLE";
-                }
-                else
-                {
-                    result.status = "OK";
-                }
+                subtask.sum_scoring = word == "sum";
+                in_depends = false;
+            }
+            else if (word == "depends")
+            {
+                in_depends = true;
+            }
+            else if (in_depends)
+            {
+                auto it = find_if(subtasks.begin(), subtasks.end(), [&](const Subtask &declared)
+                                  { return declared.id == word; });
+                if (it == subtasks.end())
+                    return where + "unknown dependency '" + word + "'";
+                subtask.depends.push_back(static_cast<size_t>(it - subtasks.begin()));
             }
             else
             {
-                result.status = "RE";
-                result.error_message = "Program exited with non-zero code: " + to_string(result.exit_code);
-                if (!stderr_output.empty())
-                {
-                    result.error_message += "\\nStderr: " + stderr_output;
-                }
+                return where + "unexpected '" + word + "'";
             }
         }
-        else if (WIFSIGNALED(status))
-        {
-            int signal_num = WTERMSIG(status);
-            result.exit_code = 128 + signal_num;
 
-            switch (signal_num)
-            {
-            case SIGXCPU:
-                result.status = "TLE";
-                result.error_message = "Time limit exceeded (SIGXCPU)";
-                break;
-            case SIGKILL:
-                // 可能是内存限制或时间限制
-                if (result.mem_used > limits.memory_limit)
-                {
-                    result.status = "MLE";
-                    result.error_message = "Memory limit exceeded (cgroup)";
-                }
-                else
-                {
-                    result.status = "TLE";
-                    result.error_message = "Time limit exceeded (SIGKILL)";
-                }
-                break;
-            case SIGSEGV:
-                result.status = "RE";
-                result.error_message = "Segmentation fault";
-                break;
-            case SIGFPE:
-                result.status = "RE";
-                result.error_message = "Floating point exception";
-                break;
-            case SIGABRT:
-                // 检查是否是内存限制导致的
-                if (result.mem_used > limits.memory_limit)
-                {
-                    result.status = "MLE";
-                    result.error_message = "Memory limit exceeded (allocation failed)";
-                }
-                else
-                {
-                    result.status = "RE";
-                    result.error_message = "Program aborted";
-                }
-                break;
-            default:
-                result.status = "RE";
-                result.error_message = "Program terminated by signal " + to_string(signal_num);
-                break;
-            }
+        while (cases >> word)
+        {
+            string recipe_error = TestData::isRecipe(word) ? testdata.validateRecipe(word) : string();
+            if (!recipe_error.empty())
+                return where + recipe_error;
+            subtask.inputs.push_back(word);
         }
-    }
+        if (subtask.inputs.empty())
+            return where + "no test cases";
 
-    return result;
+        for (size_t dependency : subtask.depends)
+            subtasks[dependency].dependents.push_back(subtasks.size());
+        subtasks.push_back(subtask);
+    }
+    return subtasks.empty() ? "manifest has no subtasks" : "";
 }
 
-string resultToJson(const JudgeResult &result)
+/**
+ * @brief 子任务评测模式入口
+ * @return int 进程退出码：0评测完成，1出错
+ *
+ * 用法：--subtasks <limits_file> <source_file> <manifest> [checker]
+ *
+ * @details 评测流程：
+ *          1. 编译一次选手程序
+ *          2. 全部测试点按清单顺序排队，通过runParallel在可用核心上并行运行，
+ *             有标准答案时用checker(见checkOutput)检查
+ *          3. min计分的子任务出现得分为0的测试点后即判为失败，
+ *             该子任务和(传递)依赖它的子任务中尚未开始的测试点全部跳过
+ *          4. 输出总分、每个子任务的得分和每个测试点的结果
+ *
+ * @note SE是评测端的故障(沙箱、checker、数据生成)，不计为0分也不触发跳过：
+ *       含SE测试点的子任务及依赖它的子任务得分记为null，不计入总分，
+ *       整体状态为SE并给出judge_errors，由调用者重测
+ * @note 清单不超过MANIFEST_MAX字节，超过时报错而不是截断
+ */
+int subtaskMain(int argc, char *argv[])
 {
-    stringstream ss;
-    ss << "{" << endl;
-    ss << "  \"status\": \"" << result.status << "\"," << endl;
-    ss << "  \"time_used\": " << result.time_used << "," << endl;
-    ss << "  \"mem_used\": " << result.mem_used << "," << endl;
-    ss << "  \"exit_code\": " << result.exit_code << "," << endl;
-    ss << "  \"error_message\": \"";
+    if (argc < 5 || argc > 6)
+    {
+        cerr << "Usage: " << argv[0] << " --subtasks <limits_file> <source_file> <manifest> [checker]" << endl;
+        return 1;
+    }
 
-    // 转义错误消息中的特殊字符
-    for (char c : result.error_message)
+    JobArena &arena = JobArena::current();
+    Limits limits = loadLimits(argv[2]);
+    CpuFreqGuard::checkAtStartup(limits);
+    limits.host_speed_factor = hostSpeedFactor(limits);
+    string source_file = argv[3];
+    string checker = argc > 5 ? argv[5] : "";
+
+    constexpr off_t MANIFEST_MAX = 1 << 20; ///< 清单大小上限(字节)
+    vector<char> manifest_buffer;
+    int manifest_fd = open(argv[4], O_RDONLY | O_CLOEXEC);
+    struct stat manifest_stat;
+    if (manifest_fd == -1 || fstat(manifest_fd, &manifest_stat) != 0 || manifest_stat.st_size > MANIFEST_MAX)
     {
-        if (c == '"')
-            ss << "\\\"";
-        else if (c == '\\')
-            ss << "\\\\";
-        else if (c == '\n')
-            ss << "\\n";
-        else if (c == '\r')
-            ss << "\\r";
-        else if (c == '\t')
-            ss << "\\t";
-        else
-            ss << c;
+        cerr << (manifest_fd == -1 ? "Failed to read manifest " : "Manifest exceeds 1 MB: ") << argv[4] << endl;
+        if (manifest_fd != -1)
+            close(manifest_fd);
+        return 1;
+    }
+    string_view manifest = readWholeFd(manifest_fd, manifest_buffer);
+    close(manifest_fd);
+    vector<Subtask> subtasks;
+    TestData testdata;
+    string error = parseSubtaskManifest(manifest, subtasks, testdata);
+    if (!error.empty())
+    {
+        cerr << error << endl;
+        return 1;
     }
 
-    ss << "\"," << endl;
-    ss << "  \"stdout\": \"";
+    string executable = source_file + ".out";
+    JudgeResult compiled = compileProgram(source_file, executable, limits);
+    if (compiled.status != "OK")
+    {
+        cout << resultToJson(compiled) << endl;
+        return 0;
+    }
 
-    // 转义标准输出中的特殊字符
-    for (char c : result.stdout_content)
+    // 按清单顺序展开为测试点队列，依赖的子任务排在前面
+    vector<pair<size_t, size_t>> cases;
+    for (size_t i = 0; i < subtasks.size(); i++)
     {
-        if (c == '"')
-            ss << "\\\"";
-        else if (c == '\\')
-            ss << "\\\\";
-        else if (c == '\n')
-            ss << "\\n";
-        else if (c == '\r')
-            ss << "\\r";
-        else if (c == '\t')
-            ss << "\\t";
-        else
-            ss << c;
+        for (size_t j = 0; j < subtasks[i].inputs.size(); j++)
+            cases.push_back({i, j});
     }
 
-    ss << "\"," << endl;
-    ss << "  \"output_len\": " << result.output_len << "," << endl;
-    ss << "  \"allocated_cpu\": \"" << result.allocated_cpu << "\"" << endl;
-    ss << "}";
+    vector<JudgeResult> results(cases.size());
+    vector<MaterializedCase> materialized(cases.size());
+    vector<char> skipped(cases.size(), 0);
+    unique_ptr<atomic<bool>[]> failed(new atomic<bool>[subtasks.size()]);
+    for (size_t i = 0; i < subtasks.size(); i++)
+        failed[i] = false;
 
-    return ss.str();
-}
+    // 标记子任务失败并传递给依赖它的子任务
+    function<void(size_t)> mark_failed = [&](size_t index)
+    {
+        if (failed[index].exchange(true))
+            return;
+        for (size_t dependent : subtasks[index].dependents)
+            mark_failed(dependent);
+    };
 
-JudgeResult judge_core(const string &limits_file, const string &source_file, const string &input_file)
-{
-    JudgeResult result;
+    // 全部测试点在同样的热缓存下运行
+    WarmBinary warm(executable, limits.prefetch_binary);
 
-    try
+    // 运行结束、核心归还后，答案检查在后处理线程中进行
+    HousekeepingPool housekeeping(CpuLease::allowedCpus().size());
+
+    auto answer_for = [](const string &input_file) -> string
     {
-        // 加载限制配置
-        Limits limits = loadLimits(limits_file);
+        return (input_file.size() > 3 && input_file.compare(input_file.size() - 3, 3, ".in") == 0
+                    ? input_file.substr(0, input_file.size() - 3)
+                    : input_file) + ".ans";
+    };
+    auto should_skip = [&](size_t subtask_index)
+    {
+        bool dependency_failed = false;
+        for (size_t dependency : subtasks[subtask_index].depends)
+            dependency_failed = dependency_failed || failed[dependency];
+        return failed[subtask_index] || dependency_failed;
+    };
 
-        // 编译程序
-        string executable = source_file + ".out";
-        result = compileProgram(source_file, executable, limits);
+    // 运行测试点k时提前准备k+1：生成配方数据、输入memfd、答案映射、池化cgroup
+    auto stage = [&](size_t task) -> unique_ptr<StagedCase>
+    {
+        if (limits.lookahead != 1 || should_skip(cases[task].first))
+            return nullptr;
+        const string &token = subtasks[cases[task].first].inputs[cases[task].second];
+        MaterializedCase prepared = testdata.materialize(token, limits, answer_for);
+        if (!prepared.error.empty())
+            return nullptr;
+        return make_unique<StagedCase>(prepared.input, prepared.answer, limits);
+    };
 
-        if (result.status != "OK")
+    auto start_time = high_resolution_clock::now();
+    runPipelined(cases.size(), CpuLease::allowedCpus().size(), stage, [&](size_t task, const unique_ptr<StagedCase> &staged)
+                 {
+        auto [subtask_index, case_index] = cases[task];
+        if (should_skip(subtask_index))
         {
-            return result;
+            skipped[task] = 1;
+            return;
+        }
+
+        // 配方测试点在首次使用时生成(已预备时这里直接取得结果)
+        MaterializedCase &testcase = materialized[task];
+        testcase = testdata.materialize(subtasks[subtask_index].inputs[case_index], limits, answer_for);
+        if (!testcase.error.empty())
+        {
+            JudgeResult &result = results[task];
+            result.status = "SE";
+            result.time_used = 0;
+            result.mem_used = 0;
+            result.exit_code = -1;
+            result.output_len = 0;
+            result.error_message = arena.store(testcase.error);
+            return;
         }
 
-        // 运行程序
-        result = runProgram(executable, input_file, limits);
+        results[task] = runWithBorderlineRerun(executable, testcase.input, limits, staged ? staged->run() : nullptr);
+        housekeeping.submit([&, task, subtask_index]()
+                            {
+            const Subtask &owner = subtasks[subtask_index];
+            const MaterializedCase &case_files = materialized[task];
+            JudgeResult &result = results[task];
+            if (result.status == "OK" && !case_files.answer.empty() && access(case_files.answer.c_str(), R_OK) == 0)
+                checkOutput(case_files.input, case_files.answer, checker, limits, result);
+            if (result.status == "SE")
+                return; // 评测端故障不计分
+            if (result.score < 0)
+                result.score = result.status == "OK" ? 1 : 0;
+            if (!owner.sum_scoring && result.score <= 0)
+                mark_failed(subtask_index); }); });
+    housekeeping.drain();
+    long long elapsed_ms = duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count();
 
-        // 清理可执行文件
-        unlink(executable.c_str());
+    unlink(executable.c_str());
+
+    // 汇总：先算各子任务自身比例，再按清单顺序与依赖取最小值
+    // 含SE测试点(或依赖这样的子任务)的子任务得分未定，不计入总分
+    vector<double> ratios(subtasks.size(), 0);
+    vector<char> incomplete(subtasks.size(), 0);
+    double total_score = 0, max_score = 0;
+    long long cases_run = 0, cases_skipped = 0, inputs_generated = 0, judge_errors = 0;
+    string_view overall_status = "OK";
+    long long syscall_counts[SyscallTracer::SYSCALL_SLOTS] = {};
+    SyscallProfile syscall_sum;
+    bool syscalls_traced = false;
+
+    pmr::string out(&arena);
+    out += "{\n  \"subtasks\": [";
+    for (size_t i = 0, task = 0; i < subtasks.size(); i++)
+    {
+        const Subtask &subtask = subtasks[i];
+        double own = subtask.sum_scoring ? 0 : 1;
+        pmr::string case_list(&arena);
+        for (size_t j = 0; j < subtask.inputs.size(); j++, task++)
+        {
+            const JudgeResult &result = results[task];
+            case_list += j == 0 ? "\n" : ",\n";
+            case_list += "        {\"input\": \"";
+            appendJsonEscaped(case_list, subtask.inputs[j]);
+            case_list += "\"";
+            if (skipped[task])
+            {
+                cases_skipped++;
+                own = subtask.sum_scoring ? own : 0;
+                case_list += ", \"status\": \"SKIPPED\"}";
+                continue;
+            }
+
+            cases_run++;
+            inputs_generated += materialized[task].generated ? 1 : 0;
+            if (result.syscalls_traced)
+            {
+                syscalls_traced = true;
+                for (const SyscallCount &entry : result.syscalls.histogram)
+                    syscall_counts[entry.nr] += entry.count;
+                syscall_sum.total += result.syscalls.total;
+                syscall_sum.blocked_us += result.syscalls.blocked_us;
+                syscall_sum.blocked_count += result.syscalls.blocked_count;
+                syscall_sum.runnable_us += result.syscalls.runnable_us;
+                syscall_sum.runnable_count += result.syscalls.runnable_count;
+            }
+            if (result.status == "SE")
+            {
+                judge_errors++;
+                incomplete[i] = 1;
+            }
+            else if (subtask.sum_scoring)
+                own += result.score / static_cast<double>(subtask.inputs.size());
+            else
+                own = min(own, result.score);
+            if (overall_status == "OK" && result.status != "OK")
+                overall_status = result.status;
+
+            case_list.append(", \"status\": \"").append(result.status);
+            case_list.append("\", \"time_used\": ").append(arena.number(result.time_used));
+            case_list.append(", \"mem_used\": ").append(arena.number(result.mem_used));
+            case_list.append(", \"score\": ").append(result.status == "SE" ? string_view("null") : arena.decimal(result.score, 4));
+            if (result.status == "SE")
+            {
+                case_list += ", \"error_message\": \"";
+                appendJsonEscaped(case_list, result.error_message);
+                case_list += "\"";
+            }
+            case_list += "}";
+        }
+
+        ratios[i] = own;
+        for (size_t dependency : subtask.depends)
+        {
+            ratios[i] = min(ratios[i], ratios[dependency]);
+            incomplete[i] = incomplete[i] || incomplete[dependency];
+        }
+        if (!incomplete[i])
+            total_score += subtask.score * ratios[i];
+        max_score += subtask.score;
+
+        out += i == 0 ? "\n" : ",\n";
+        out += "    {\"id\": \"";
+        appendJsonEscaped(out, subtask.id);
+        out.append("\", \"score\": ").append(incomplete[i] ? string_view("null") : arena.decimal(subtask.score * ratios[i], 2));
+        out.append(", \"max_score\": ").append(arena.decimal(subtask.score, 2));
+        out.append(", \"scoring\": \"").append(subtask.sum_scoring ? "sum" : "min");
+        out.append("\", \"cases\": [").append(case_list).append("\n      ]}");
     }
-    catch (const exception &e)
+    out += "\n  ],\n";
+    if (judge_errors > 0)
+        overall_status = "SE";
+    out.append("  \"status\": \"").append(overall_status).append("\",\n");
+    out.append("  \"score\": ").append(arena.decimal(total_score, 2)).append(",\n");
+    out.append("  \"judge_errors\": ").append(arena.number(judge_errors)).append(",\n");
+    out.append("  \"max_score\": ").append(arena.decimal(max_score, 2)).append(",\n");
+    out.append("  \"cases_run\": ").append(arena.number(cases_run)).append(",\n");
+    out.append("  \"cases_skipped\": ").append(arena.number(cases_skipped)).append(",\n");
+    out.append("  \"inputs_generated\": ").append(arena.number(inputs_generated)).append(",\n");
+    if (syscalls_traced)
     {
-        result.status = "SE";
-        result.error_message = "System error: " + string(e.what());
-        result.time_used = 0;
-        result.mem_used = 0;
-        result.exit_code = -1;
-        result.output_len = 0;
-        result.allocated_cpu = "";
+        // 全部已运行测试点的系统调用和离核时间汇总
+        pmr::vector<SyscallCount> histogram(&arena);
+        for (int nr = 0; nr < SyscallTracer::SYSCALL_SLOTS; nr++)
+            if (syscall_counts[nr] != 0)
+                histogram.push_back(SyscallCount{nr, syscall_counts[nr]});
+        sort(histogram.begin(), histogram.end(), [](const SyscallCount &a, const SyscallCount &b)
+             { return a.count != b.count ? a.count > b.count : a.nr < b.nr; });
+        syscall_sum.histogram = span<const SyscallCount>(histogram.data(), histogram.size());
+        out += "  \"syscalls\": ";
+        appendSyscallProfile(out, syscall_sum);
+        out += ",\n";
     }
+    out.append("  \"elapsed_ms\": ").append(arena.number(elapsed_ms)).append("\n");
+    out += "}";
 
-    return result;
+    cout << out << endl;
+    return 0;
 }
 
+#ifndef JUDGE_CORE_NO_MAIN
+// 微基准等工具以#include方式复用评测核心时定义JUDGE_CORE_NO_MAIN，去掉入口函数
 int main(int argc, char *argv[])
 {
-    if (argc != 4)
+    if (argc >= 2 && string_view(argv[1]) == "--calibrate")
+    {
+        JobArena arena;
+        JobArena::Scope scope(arena);
+        return calibrateMain(argc, argv);
+    }
+
+    if (argc >= 2 && string_view(argv[1]) == "--stress")
+    {
+        JobArena arena;
+        JobArena::Scope scope(arena);
+        return stressMain(argc, argv);
+    }
+
+    if (argc >= 2 && string_view(argv[1]) == "--validate")
+    {
+        JobArena arena;
+        JobArena::Scope scope(arena);
+        return validateMain(argc, argv);
+    }
+
+    if (argc >= 2 && string_view(argv[1]) == "--subtasks")
+    {
+        JobArena arena;
+        JobArena::Scope scope(arena);
+        return subtaskMain(argc, argv);
+    }
+
+    if (argc < 4 || argc > 6)
     {
-        cerr << "Usage: " << argv[0] << " <limits_file> <source_file> <input_file>" << endl;
+        cerr << "Usage: " << argv[0] << " <limits_file> <source_file> <input_file> [answer_file [checker]]" << endl;
+        cerr << "       " << argv[0] << " --calibrate <problem_id> <limits_file> <source_file>[,<source_file>...] <input_file>..." << endl;
+        cerr << "       " << argv[0] << " --stress <limits_file> <generator> <brute> <solution> [iterations] [seed]" << endl;
+        cerr << "       " << argv[0] << " --validate <limits_file> <validator.cpp|format.spec> <input_file>..." << endl;
+        cerr << "       " << argv[0] << " --subtasks <limits_file> <source_file> <manifest> [checker]" << endl;
         return 1;
     }
 
     string limits_file = argv[1];
     string source_file = argv[2];
     string input_file = argv[3];
+    string answer_file = argc > 4 ? argv[4] : "";
+    string checker = argc > 5 ? argv[5] : "";
 
-    JudgeResult result = judge_core(limits_file, source_file, input_file);
+    // 本次评测的全部临时字符串都分配在任务arena中，评测结束后一次性释放
+    JobArena arena;
+    {
+        JobArena::Scope scope(arena);
+
+        // 设置JUDGE_TRACE时记录任务轨迹，供judge_replay回放
+        const char *trace_file = getenv("JUDGE_TRACE");
+        auto arrival = system_clock::now();
+
+        JudgeResult result = judge_core(limits_file, source_file, input_file, answer_file, checker);
+
+        cout << resultToJson(result) << endl;
+
+        if (trace_file != nullptr && *trace_file != '\0')
+        {
+            long long arrival_ms = duration_cast<milliseconds>(arrival.time_since_epoch()).count();
+            long long total_ms = duration_cast<milliseconds>(system_clock::now() - arrival).count();
+            appendTraceRecord(trace_file, arrival_ms, limits_file, source_file, input_file, result, total_ms);
+        }
+    }
+    arena.reset();
 
-    cout << resultToJson(result) << endl;
+#ifdef JUDGE_ALLOC_STATS
+    cerr << "heap allocations: " << g_heap_allocations.load() << endl;
+#endif
 
     return 0;
 }
+#endif // JUDGE_CORE_NO_MAIN
@@ -0,0 +1,440 @@
+/**
+ * @file judge_microbench.cpp
+ * @brief 评测核心热路径微基准
+ *
+ * 以#include方式编译评测核心(JUDGE_CORE_NO_MAIN)，直接调用内部函数测量：
+ *          - cgroup创建/配置/删除，以及从CgroupPool签出/归还
+ *          - cgroupfs读取(getMemoryPeak)
+ *          - fork+exec+wait一个空程序，以及经runInSandbox的同一过程
+ *          - 经runProgram运行栈访问密集的小程序，对比继承环境与确定性环境(deterministic_env+disable_aslr)下的抖动
+ *          - 计时前预读可执行文件和共享库(WarmBinary)
+ *          - resultToJson处理大输出
+ *          - parseJsonNumber/loadLimits
+ *          - 管道输出捕获吞吐(CaptureBuffer)
+ *          - 记号比较吞吐(compareTokens)
+ *
+ * @details 稳定性措施：
+ *          - 进程绑定到单个核心
+ *          - 每个用例先预热一轮，并自动确定每轮次数使一轮不短于目标时长
+ *          - 报告多轮的中位数、最小值和中位数绝对偏差(MAD)，以中位数为准对比
+ *
+ * 编译：g++ -std=c++20 -O2 -Wall -Wextra -pthread judge_microbench.cpp -o judge_microbench
+ * 用法：sudo ./judge_microbench [--filter SUBSTR] [--repeat N] [--min-ms MS] [--json FILE] [--baseline FILE]
+ */
+
+#define JUDGE_CORE_NO_MAIN
+#include "judge_core_cgroup.cpp"
+
+/**
+ * @struct BenchCase
+ * @brief 一个微基准用例
+ */
+struct BenchCase
+{
+    string name;                    ///< 用例名
+    size_t bytes_per_op = 0;        ///< 每次操作处理的字节数，非0时报告吞吐
+    function<bool()> setup;         ///< 准备工作(可为空)，返回false表示跳过该用例
+    function<void()> op;            ///< 被测操作
+    function<void()> teardown;      ///< 清理工作(可为空)
+};
+
+/**
+ * @struct BenchStats
+ * @brief 一个用例的统计结果
+ */
+struct BenchStats
+{
+    string name;
+    long long ops_per_round = 0; ///< 每轮操作次数
+    double median_ns = 0;        ///< 每次操作耗时中位数(纳秒)
+    double min_ns = 0;           ///< 每次操作耗时最小值(纳秒)
+    double mad_percent = 0;      ///< 中位数绝对偏差占中位数的百分比
+    double mb_per_s = 0;         ///< 按中位数计算的吞吐(MB/s)，无吞吐时为0
+};
+
+/**
+ * @brief 防止编译器优化掉被测结果
+ */
+template <typename T>
+void keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief 运行一个用例并统计
+ * @param bench 用例
+ * @param repeat 统计轮数
+ * @param min_round_ns 每轮最短时长(纳秒)
+ */
+BenchStats runCase(const BenchCase &bench, int repeat, long long min_round_ns)
+{
+    auto round = [&bench](long long ops)
+    {
+        auto start = steady_clock::now();
+        for (long long i = 0; i < ops; i++)
+            bench.op();
+        return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    };
+
+    // 预热并按倍增确定每轮次数
+    long long ops = 1;
+    while (true)
+    {
+        long long elapsed = round(ops);
+        if (elapsed >= min_round_ns || ops >= (1LL << 30))
+            break;
+        ops = elapsed <= 0 ? ops * 16 : max(ops * 2, min(ops * 16, ops * min_round_ns / elapsed + 1));
+    }
+
+    vector<double> per_op;
+    for (int r = 0; r < repeat; r++)
+        per_op.push_back(static_cast<double>(round(ops)) / static_cast<double>(ops));
+    sort(per_op.begin(), per_op.end());
+
+    BenchStats stats;
+    stats.name = bench.name;
+    stats.ops_per_round = ops;
+    stats.median_ns = per_op[per_op.size() / 2];
+    stats.min_ns = per_op.front();
+    vector<double> deviations;
+    for (double value : per_op)
+        deviations.push_back(fabs(value - stats.median_ns));
+    sort(deviations.begin(), deviations.end());
+    stats.mad_percent = stats.median_ns > 0 ? deviations[deviations.size() / 2] * 100.0 / stats.median_ns : 0;
+    if (bench.bytes_per_op > 0 && stats.median_ns > 0)
+        stats.mb_per_s = static_cast<double>(bench.bytes_per_op) * 1000.0 / stats.median_ns;
+    return stats;
+}
+
+/**
+ * @brief 生成n字节的随机记号文本(数字和空白)
+ */
+string makeTokenText(size_t n, unsigned seed)
+{
+    mt19937 generator(seed);
+    string text;
+    text.reserve(n);
+    while (text.size() < n)
+    {
+        text += to_string(generator() % 1000000000);
+        text += (generator() % 8 == 0) ? '\n' : ' ';
+    }
+    return text;
+}
+
+/**
+ * @brief 在基线结果中查找同名用例的中位数
+ * @return double 找不到时返回-1
+ */
+double baselineMedian(const string &baseline, const string &name)
+{
+    size_t pos = baseline.find("\"name\": \"" + name + "\"");
+    if (pos == string::npos)
+        return -1;
+    string_view key = "\"median_ns\": ";
+    pos = baseline.find(key, pos);
+    if (pos == string::npos)
+        return -1;
+    return atof(baseline.c_str() + pos + key.size());
+}
+
+int main(int argc, char *argv[])
+{
+    string filter;
+    int repeat = 15;
+    long long min_round_ms = 50;
+    string json_file;
+    string baseline_file;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string_view option = argv[i];
+        bool has_value = i + 1 < argc;
+        if (option == "--filter" && has_value)
+            filter = argv[++i];
+        else if (option == "--repeat" && has_value)
+            repeat = max(3, atoi(argv[++i]));
+        else if (option == "--min-ms" && has_value)
+            min_round_ms = max(1LL, atoll(argv[++i]));
+        else if (option == "--json" && has_value)
+            json_file = argv[++i];
+        else if (option == "--baseline" && has_value)
+            baseline_file = argv[++i];
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--filter SUBSTR] [--repeat N] [--min-ms MS] [--json FILE] [--baseline FILE]" << endl;
+            return 1;
+        }
+    }
+
+    // 绑定到允许集合中的最后一个核心，与评测任务默认从低编号核心分配错开
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+            {
+                cpu_set_t pinned;
+                CPU_ZERO(&pinned);
+                CPU_SET(cpu, &pinned);
+                sched_setaffinity(0, sizeof(pinned), &pinned);
+                break;
+            }
+        }
+    }
+
+    JobArena arena;
+    JobArena::Scope scope(arena);
+
+    Limits limits;
+    limits.time_limit = 1000;
+    limits.memory_limit = 268435456;
+    limits.output_limit = 64000000;
+    limits.compile_timeout = 30000;
+    limits.stack_limit = 8388608;
+
+    // 共享的测试数据
+    unique_ptr<CgroupManager> probe;
+    char limits_path[] = "/tmp/judge_microbench_XXXXXX";
+    int limits_fd = mkstemp(limits_path);
+    if (limits_fd == -1)
+    {
+        cerr << "Failed to create temporary limits file" << endl;
+        return 1;
+    }
+    // 与实际配置文件一致：memory_limit和stack_limit以KB为单位，只使用loadLimits认识的键
+    string limits_json = "{\n  \"time_limit\": 1000,\n  \"memory_limit\": 262144,\n  \"output_limit\": 64000000,\n"
+                         "  \"compile_timeout\": 30000,\n  \"stack_limit\": 8192,\n  \"rerun_band\": 10,\n  \"rerun_max\": 2,\n"
+                         "  \"checker_time_limit\": 5000,\n  \"report_phases\": 1\n}\n";
+    if (write(limits_fd, limits_json.data(), limits_json.size()) != static_cast<ssize_t>(limits_json.size()))
+    {
+        cerr << "Failed to write temporary limits file" << endl;
+        return 1;
+    }
+    close(limits_fd);
+
+    // 临时配置经loadLimits解析后必须与上面的limits一致，否则load_limits测的不是实际配置
+    Limits parsed = loadLimits(limits_path);
+    if (parsed.memory_limit != limits.memory_limit || parsed.stack_limit != limits.stack_limit)
+    {
+        cerr << "Temporary limits file does not match the benchmark limits" << endl;
+        unlink(limits_path);
+        return 1;
+    }
+
+    const size_t COMPARE_BYTES = 16UL << 20;
+    const size_t CAPTURE_BYTES = 16UL << 20;
+    const size_t JSON_BYTES = 4UL << 20;
+    string tokens = makeTokenText(COMPARE_BYTES, 1);
+    string tokens_copy = tokens;
+    string json_stdout = makeTokenText(JSON_BYTES, 2);
+    for (size_t i = 0; i < json_stdout.size(); i += 97)
+        json_stdout[i] = '"';
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+
+    vector<BenchCase> cases;
+
+    cases.push_back({"cgroup_create_configure_cleanup", 0, nullptr, [&]()
+                     {
+        {
+            CgroupManager cgroup;
+            if (cgroup.create())
+            {
+                cgroup.setMemoryLimit(limits.memory_limit);
+                cgroup.setCpuLimit(limits);
+            }
+            cgroup.cleanup();
+        }
+        arena.reset(); }, nullptr});
+
+    cases.push_back({"cgroup_pool_acquire_release", 0, nullptr, [&]()
+                     {
+        CgroupPool::Lease lease = CgroupPool::instance().acquire(limits);
+        keep(lease); }, nullptr});
+
+    cases.push_back({"cgroup_memory_peak_read", 0, [&]()
+                     {
+        probe = make_unique<CgroupManager>();
+        return probe->create(); }, [&]()
+                     {
+        long long peak = probe->getMemoryPeak();
+        keep(peak); }, [&]()
+                     { probe.reset(); }});
+
+    cases.push_back({"fork_exec_wait_true", 0, nullptr, []()
+                     {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            execl("/bin/true", "true", (char *)nullptr);
+            _exit(127);
+        }
+        int status;
+        waitpid(pid, &status, 0); }, nullptr});
+
+    cases.push_back({"run_in_sandbox_true", 0, [&]()
+                     {
+        probe = make_unique<CgroupManager>();
+        return probe->create() && probe->setMemoryLimit(limits.memory_limit); }, [&]()
+                     {
+        JudgeResult result = runInSandbox(*probe, "/bin/true", {}, -1, null_fd, limits);
+        keep(result); }, [&]()
+                     { probe.reset(); }});
+
+    // 栈上数组的对齐随环境变量总长和地址随机化变化，用于观察确定性环境对运行时间抖动的影响
+    string stack_workload = string("/tmp/judge_microbench_stack_") + to_string(getpid());
+    auto build_stack_workload = [&]()
+    {
+        if (access(stack_workload.c_str(), X_OK) == 0)
+            return true;
+        string source = stack_workload + ".cpp";
+        ofstream(source) << "#include <cstdio>\n"
+                            "static long walk(int depth) { volatile double a[61]; long s = 0;\n"
+                            "  for (int r = 0; r < 20; r++) for (int i = 0; i < 61; i++) { a[i] = a[(i + 7) % 61] + i; s += (long)a[i]; }\n"
+                            "  return depth == 0 ? s : s + walk(depth - 1); }\n"
+                            "int main() { long s = 0; for (int k = 0; k < 40; k++) s += walk(64); printf(\"%ld\\n\", s & 1); }\n";
+        string command = "g++ -O2 -o " + stack_workload + " " + source + " 2>/dev/null";
+        bool built = system(command.c_str()) == 0;
+        unlink(source.c_str());
+        return built;
+    };
+    Limits deterministic_limits = limits;
+    deterministic_limits.deterministic_env = 1;
+    deterministic_limits.disable_aslr = 1;
+
+    cases.push_back({"run_program_stack_workload", 0, build_stack_workload, [&]()
+                     {
+        JudgeResult result = runProgram(stack_workload, "/dev/null", limits);
+        keep(result);
+        arena.reset(); }, nullptr});
+
+    cases.push_back({"run_program_stack_workload_det", 0, build_stack_workload, [&]()
+                     {
+        JudgeResult result = runProgram(stack_workload, "/dev/null", deterministic_limits);
+        keep(result);
+        arena.reset(); }, nullptr});
+
+    cases.push_back({"warm_binary_true", 0, nullptr, []()
+                     {
+        WarmBinary warm("/bin/true", 1);
+        keep(warm.bytes()); }, nullptr});
+
+    cases.push_back({"result_to_json_4mb_stdout", JSON_BYTES, nullptr, [&]()
+                     {
+        JudgeResult result;
+        result.status = "OK";
+        result.time_used = 12;
+        result.mem_used = 1 << 20;
+        result.exit_code = 0;
+        result.output_len = static_cast<int>(json_stdout.size());
+        result.stdout_content = json_stdout;
+        string_view json = resultToJson(result);
+        keep(json);
+        arena.reset(); }, nullptr});
+
+    cases.push_back({"parse_json_number", 0, nullptr, [&]()
+                     {
+        long long value = parseJsonNumber(limits_json, "checker_time_limit");
+        keep(value); }, nullptr});
+
+    cases.push_back({"load_limits", 0, nullptr, [&]()
+                     {
+        Limits loaded = loadLimits(limits_path);
+        keep(loaded);
+        arena.reset(); }, nullptr});
+
+    cases.push_back({"capture_pipe_16mb", CAPTURE_BYTES, nullptr, [&]()
+                     {
+        int pipe_fds[2];
+        if (pipe2(pipe_fds, O_CLOEXEC) == -1)
+            return;
+        thread writer([&]()
+                      {
+            static char chunk[65536];
+            size_t written = 0;
+            while (written < CAPTURE_BYTES)
+            {
+                ssize_t n = write(pipe_fds[1], chunk, min(sizeof(chunk), CAPTURE_BYTES - written));
+                if (n <= 0)
+                    break;
+                written += n;
+            }
+            close(pipe_fds[1]); });
+        CaptureBuffer capture(static_cast<size_t>(limits.output_limit));
+        while (capture.readFrom(pipe_fds[0]) > 0)
+        {
+        }
+        writer.join();
+        close(pipe_fds[0]);
+        keep(capture.totalBytes()); }, nullptr});
+
+    cases.push_back({"compare_tokens_16mb", COMPARE_BYTES, nullptr, [&]()
+                     {
+        bool same = compareTokens(tokens, tokens_copy);
+        keep(same); }, nullptr});
+
+    string baseline;
+    if (!baseline_file.empty())
+    {
+        ifstream file(baseline_file);
+        stringstream buffer;
+        buffer << file.rdbuf();
+        baseline = buffer.str();
+        if (baseline.empty())
+            cerr << "Failed to read baseline " << baseline_file << endl;
+    }
+
+    vector<BenchStats> results;
+    printf("%-34s %12s %12s %8s %10s %10s\n", "case", "median_ns", "min_ns", "mad%", "MB/s", "vs_base");
+    for (const BenchCase &bench : cases)
+    {
+        if (!filter.empty() && bench.name.find(filter) == string::npos)
+            continue;
+        if (bench.setup && !bench.setup())
+        {
+            printf("%-34s skipped (setup failed, root and cgroup v2 required)\n", bench.name.c_str());
+            if (bench.teardown)
+                bench.teardown();
+            continue;
+        }
+
+        BenchStats stats = runCase(bench, repeat, min_round_ms * 1000000);
+        if (bench.teardown)
+            bench.teardown();
+        results.push_back(stats);
+
+        char change[32] = "-";
+        double before = baseline.empty() ? -1 : baselineMedian(baseline, stats.name);
+        if (before > 0)
+            snprintf(change, sizeof(change), "%+.1f%%", (stats.median_ns - before) * 100.0 / before);
+        printf("%-34s %12.0f %12.0f %8.2f %10.1f %10s\n", stats.name.c_str(), stats.median_ns, stats.min_ns,
+               stats.mad_percent, stats.mb_per_s, change);
+        fflush(stdout);
+    }
+
+    if (!json_file.empty())
+    {
+        ofstream file(json_file, ios::trunc);
+        file << "{\n  \"repeat\": " << repeat << ",\n  \"min_round_ms\": " << min_round_ms << ",\n  \"cases\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchStats &stats = results[i];
+            char line[512];
+            snprintf(line, sizeof(line),
+                     "%s\n    {\"name\": \"%s\", \"ops_per_round\": %lld, \"median_ns\": %.1f, \"min_ns\": %.1f, \"mad_percent\": %.2f, \"mb_per_s\": %.1f}",
+                     i == 0 ? "" : ",", stats.name.c_str(), stats.ops_per_round, stats.median_ns, stats.min_ns,
+                     stats.mad_percent, stats.mb_per_s);
+            file << line;
+        }
+        file << "\n  ]\n}\n";
+        if (!file)
+            cerr << "Failed to write " << json_file << endl;
+    }
+
+    close(null_fd);
+    unlink(limits_path);
+    unlink(stack_workload.c_str());
+    return 0;
+}
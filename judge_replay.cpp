@@ -0,0 +1,401 @@
+/**
+ * @file judge_replay.cpp
+ * @brief 评测任务轨迹回放工具
+ *
+ * 读取评测核心在JUDGE_TRACE中记录的任务轨迹(JSONL)，按记录的到达间隔
+ * (可按倍率缩放)以开环方式驱动本地评测核心，每个任务用开销特征相同的
+ * 合成程序代替原始提交：
+ *          - CPU：忙等time_used毫秒
+ *          - 内存：申请并逐页写入mem_used字节(扣除运行时基线)
+ *          - 输出：写出output_len字节
+ *          - 输入：填充到input_bytes字节
+ *          - RE/CE：合成程序以非零码退出/使用无法编译的源码
+ *
+ * 输出延迟分位数(从计划到达时刻算起，不含写输入文件的时间)、实际吞吐和判定稳定性(回放判定与记录判定一致的比例)
+ * 限制配置开启compile_cache，合成程序只编译一次(缓存在当前目录的.judge_cache/bin)
+ *
+ * 编译：g++ -std=c++20 -O2 -Wall -Wextra -pthread judge_replay.cpp -o judge_replay
+ * 用法：sudo ./judge_replay <trace.jsonl> [--scale X] [--judge PATH] [--max-inflight N] [--out FILE]
+ */
+
+#include <iostream>       // 标准输入输出流
+#include <fstream>        // 文件流操作
+#include <string>         // 字符串处理
+#include <string_view>    // 字符串视图
+#include <vector>         // 动态数组容器
+#include <chrono>         // 高精度时间测量
+#include <thread>         // 回放线程
+#include <mutex>          // 互斥锁
+#include <atomic>         // 原子计数
+#include <algorithm>      // 排序
+#include <map>            // 判定变化统计
+#include <cstring>        // 字符串操作
+#include <unistd.h>       // POSIX系统调用
+#include <sys/wait.h>     // 进程等待相关
+#include <sys/stat.h>     // 文件状态
+#include <fcntl.h>        // 文件控制
+
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * @struct TraceRecord
+ * @brief 轨迹中的一个评测任务
+ */
+struct TraceRecord
+{
+    long long arrival_ms = 0;   ///< 到达时刻(Unix毫秒)
+    long long time_limit = 0;   ///< 时间限制(毫秒)
+    long long memory_limit = 0; ///< 内存限制(字节)
+    long long output_limit = 0; ///< 输出限制(字节)
+    long long input_bytes = 0;  ///< 输入大小(字节)
+    long long time_used = 0;    ///< 记录的运行时间(毫秒)
+    long long mem_used = 0;     ///< 记录的峰值内存(字节)
+    long long output_len = 0;   ///< 记录的输出长度(字节)
+    string status;              ///< 记录的判定
+};
+
+/**
+ * @struct ReplayOutcome
+ * @brief 一个任务的回放结果
+ */
+struct ReplayOutcome
+{
+    bool started = false;    ///< 是否已启动(超过并发上限时丢弃)
+    long long latency_ms = 0; ///< 从计划到达到评测完成的延迟(毫秒)
+    string status;           ///< 回放得到的判定
+};
+
+/**
+ * @brief 从单行JSON中读取数值字段
+ * @return long long 字段值，不存在时返回-1
+ */
+long long jsonNumber(string_view line, string_view key)
+{
+    string pattern = "\"" + string(key) + "\":";
+    size_t pos = line.find(pattern);
+    if (pos == string_view::npos)
+        return -1;
+    return atoll(string(line.substr(pos + pattern.size(), 24)).c_str());
+}
+
+/**
+ * @brief 从单行JSON中读取字符串字段
+ * @return string 字段值，不存在时返回空串
+ */
+string jsonString(string_view line, string_view key)
+{
+    string pattern = "\"" + string(key) + "\": \"";
+    size_t pos = line.find(pattern);
+    if (pos == string_view::npos)
+        return "";
+    size_t begin = pos + pattern.size();
+    size_t end = line.find('"', begin);
+    return string(line.substr(begin, end == string_view::npos ? string_view::npos : end - begin));
+}
+
+/**
+ * @brief 读取轨迹文件
+ */
+vector<TraceRecord> loadTrace(const string &path)
+{
+    vector<TraceRecord> records;
+    ifstream file(path);
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty())
+            continue;
+        TraceRecord record;
+        record.arrival_ms = jsonNumber(line, "arrival_ms");
+        record.time_limit = jsonNumber(line, "time_limit");
+        record.memory_limit = jsonNumber(line, "memory_limit");
+        record.output_limit = jsonNumber(line, "output_limit");
+        record.input_bytes = jsonNumber(line, "input_bytes");
+        record.time_used = jsonNumber(line, "time_used");
+        record.mem_used = jsonNumber(line, "mem_used");
+        record.output_len = jsonNumber(line, "output_len");
+        record.status = jsonString(line, "status");
+        if (record.arrival_ms >= 0 && record.time_limit > 0)
+            records.push_back(record);
+    }
+    sort(records.begin(), records.end(), [](const TraceRecord &a, const TraceRecord &b)
+         { return a.arrival_ms < b.arrival_ms; });
+    return records;
+}
+
+/**
+ * @brief 合成程序源码：从输入首行读取开销参数后按参数消耗资源
+ */
+constexpr const char *SYNTHETIC_SOURCE = R"(#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+int main()
+{
+    long long cpu_ms, mem_bytes, out_bytes, exit_code;
+    if (scanf("%lld %lld %lld %lld", &cpu_ms, &mem_bytes, &out_bytes, &exit_code) != 4)
+        return 1;
+    char *memory = static_cast<char *>(malloc(mem_bytes > 0 ? mem_bytes : 1));
+    for (long long i = 0; i < mem_bytes; i += 4096)
+        memory[i] = 1;
+    auto start = std::chrono::steady_clock::now();
+    volatile unsigned long long spin = 0;
+    while (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < cpu_ms)
+        spin = spin + 1;
+    static char buffer[65536];
+    memset(buffer, 'x', sizeof(buffer));
+    for (long long left = out_bytes; left > 0; left -= static_cast<long long>(sizeof(buffer)))
+        fwrite(buffer, 1, left < static_cast<long long>(sizeof(buffer)) ? left : sizeof(buffer), stdout);
+    return static_cast<int>(exit_code);
+}
+)";
+
+/**
+ * @brief 运行时基线内存：合成程序不申请内存时的峰值(字节)，回放时从记录中扣除
+ */
+constexpr long long BASELINE_MEMORY = 3LL << 20;
+
+/**
+ * @brief 写入文件
+ * @return bool 成功返回true
+ */
+bool writeFile(const string &path, const string &content)
+{
+    ofstream file(path, ios::binary | ios::trunc);
+    file << content;
+    return static_cast<bool>(file);
+}
+
+/**
+ * @brief 为一个记录准备限制配置
+ *
+ * 开启编译缓存：所有任务共用同一份合成源码，只有第一个任务真正调用g++，
+ * 延迟分位数反映的是评测本身而不是重复编译
+ */
+bool prepareLimits(const string &workdir, size_t index, const TraceRecord &record)
+{
+    // 轨迹中的memory_limit是字节，限制配置中memory_limit和stack_limit以KB为单位
+    string limits = "{\n  \"time_limit\": " + to_string(record.time_limit) +
+                    ",\n  \"memory_limit\": " + to_string(record.memory_limit / 1024) +
+                    ",\n  \"output_limit\": " + to_string(record.output_limit) +
+                    ",\n  \"compile_timeout\": 30000,\n  \"stack_limit\": 8192,\n  \"compile_cache\": 1\n}\n";
+    return writeFile(workdir + "/" + to_string(index) + ".json", limits);
+}
+
+/**
+ * @brief 为一个记录写出输入文件：首行为合成程序的开销参数，其余填充到input_bytes
+ *
+ * 在任务启动前才创建、评测结束即删除，工作目录中同时存在的输入不超过并发上限
+ */
+bool prepareInput(const string &path, const TraceRecord &record)
+{
+    long long exit_code = record.status == "RE" ? 1 : 0;
+    string input = to_string(max(0LL, record.time_used)) + " " +
+                   to_string(max(0LL, record.mem_used - BASELINE_MEMORY)) + " " +
+                   to_string(max(0LL, record.output_len)) + " " + to_string(exit_code) + "\n";
+    long long padding = min(record.input_bytes, 64LL << 20) - static_cast<long long>(input.size());
+    if (padding > 0)
+        input.append(static_cast<size_t>(padding - 1), ' ').append("\n");
+    return writeFile(path, input);
+}
+
+/**
+ * @brief 运行一次评测核心并读取判定
+ * @return string 判定，启动失败返回"SE"
+ */
+string runJudge(const string &judge, const string &limits_file, const string &source_file, const string &input_file)
+{
+    int output_pipe[2];
+    if (pipe2(output_pipe, O_CLOEXEC) == -1)
+        return "SE";
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        return "SE";
+    }
+    if (pid == 0)
+    {
+        dup2(output_pipe[1], STDOUT_FILENO);
+        execl(judge.c_str(), judge.c_str(), limits_file.c_str(), source_file.c_str(), input_file.c_str(), (char *)nullptr);
+        _exit(127);
+    }
+
+    close(output_pipe[1]);
+    string output;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(output_pipe[0], buffer, sizeof(buffer))) > 0)
+        output.append(buffer, static_cast<size_t>(n));
+    close(output_pipe[0]);
+    waitpid(pid, nullptr, 0);
+
+    string status = jsonString(output, "status");
+    return status.empty() ? "SE" : status;
+}
+
+/**
+ * @brief 取已排序数组的分位数
+ */
+long long percentile(const vector<long long> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " <trace.jsonl> [--scale X] [--judge PATH] [--max-inflight N] [--out FILE]" << endl;
+        return 1;
+    }
+
+    string trace_file = argv[1];
+    double scale = 1.0;
+    string judge = "./judge_core_cgroup";
+    long long max_inflight = 64;
+    string out_file;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        string_view option = argv[i];
+        if (option == "--scale")
+            scale = atof(argv[i + 1]);
+        else if (option == "--judge")
+            judge = argv[i + 1];
+        else if (option == "--max-inflight")
+            max_inflight = atoll(argv[i + 1]);
+        else if (option == "--out")
+            out_file = argv[i + 1];
+    }
+    if (scale <= 0)
+        scale = 1.0;
+
+    vector<TraceRecord> records = loadTrace(trace_file);
+    if (records.empty())
+    {
+        cerr << "No records in " << trace_file << endl;
+        return 1;
+    }
+
+    // 合成程序源码所有任务共用；限制配置预先写好，输入在任务启动时才创建
+    char workdir_template[] = "/tmp/judge_replay_XXXXXX";
+    if (mkdtemp(workdir_template) == nullptr)
+    {
+        cerr << "Failed to create work directory" << endl;
+        return 1;
+    }
+    string workdir = workdir_template;
+    string synthetic_source = workdir + "/synthetic.cpp";
+    string broken_source = workdir + "/broken.cpp";
+    if (!writeFile(synthetic_source, SYNTHETIC_SOURCE) || !writeFile(broken_source, "int main() { return }\n"))
+    {
+        cerr << "Failed to write synthetic sources" << endl;
+        return 1;
+    }
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (!prepareLimits(workdir, i, records[i]))
+        {
+            cerr << "Failed to prepare record " << i << endl;
+            return 1;
+        }
+    }
+
+    // 开环回放：按计划时刻启动，不等待前面的任务完成
+    vector<ReplayOutcome> outcomes(records.size());
+    vector<thread> threads;
+    atomic<long long> inflight{0};
+    long long dropped = 0;
+    auto replay_start = steady_clock::now();
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        auto offset = milliseconds(static_cast<long long>(static_cast<double>(records[i].arrival_ms - records[0].arrival_ms) / scale));
+        auto scheduled = replay_start + offset;
+        this_thread::sleep_until(scheduled);
+
+        if (inflight >= max_inflight)
+        {
+            dropped++;
+            continue;
+        }
+        inflight++;
+        threads.emplace_back([&, i, scheduled]()
+                             {
+            string prefix = workdir + "/" + to_string(i);
+            const string &source = records[i].status == "CE" ? broken_source : synthetic_source;
+            // 生产环境中测试数据已在评测机上，写输入的时间不计入延迟
+            auto prepare_start = steady_clock::now();
+            if (!prepareInput(prefix + ".in", records[i]))
+                outcomes[i].status = "SE";
+            auto prepare_time = steady_clock::now() - prepare_start;
+            if (outcomes[i].status.empty())
+                outcomes[i].status = runJudge(judge, prefix + ".json", source, prefix + ".in");
+            unlink((prefix + ".in").c_str());
+            outcomes[i].latency_ms = duration_cast<milliseconds>(steady_clock::now() - scheduled - prepare_time).count();
+            outcomes[i].started = true;
+            inflight--; });
+    }
+    for (thread &t : threads)
+        t.join();
+    long long elapsed_ms = duration_cast<milliseconds>(steady_clock::now() - replay_start).count();
+
+    // 统计延迟分位数和判定稳定性
+    vector<long long> latencies;
+    long long stable = 0;
+    map<string, long long> changes;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (!outcomes[i].started)
+            continue;
+        latencies.push_back(outcomes[i].latency_ms);
+        if (outcomes[i].status == records[i].status)
+            stable++;
+        else
+            changes[records[i].status + "->" + outcomes[i].status]++;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    long long completed = static_cast<long long>(latencies.size());
+    string report = "{\n";
+    report += "  \"trace\": \"" + trace_file + "\",\n";
+    report += "  \"scale\": " + to_string(scale) + ",\n";
+    report += "  \"jobs\": " + to_string(records.size()) + ",\n";
+    report += "  \"completed\": " + to_string(completed) + ",\n";
+    report += "  \"dropped\": " + to_string(dropped) + ",\n";
+    report += "  \"elapsed_ms\": " + to_string(elapsed_ms) + ",\n";
+    report += "  \"throughput_per_second\": " + to_string(elapsed_ms > 0 ? static_cast<double>(completed) * 1000.0 / static_cast<double>(elapsed_ms) : 0.0) + ",\n";
+    report += "  \"latency_ms\": {\"p50\": " + to_string(percentile(latencies, 0.50)) +
+              ", \"p90\": " + to_string(percentile(latencies, 0.90)) +
+              ", \"p99\": " + to_string(percentile(latencies, 0.99)) +
+              ", \"max\": " + to_string(latencies.empty() ? 0 : latencies.back()) + "},\n";
+    report += "  \"verdict_stability\": " + to_string(completed > 0 ? static_cast<double>(stable) / static_cast<double>(completed) : 1.0) + ",\n";
+    report += "  \"verdict_changes\": {";
+    bool first = true;
+    for (const auto &[change, count] : changes)
+    {
+        report += (first ? "\"" : ", \"") + change + "\": " + to_string(count);
+        first = false;
+    }
+    report += "}\n}\n";
+
+    cout << report;
+    if (!out_file.empty() && !writeFile(out_file, report))
+    {
+        cerr << "Failed to write " << out_file << endl;
+    }
+
+    // 清理工作目录(输入文件已由各任务删除)
+    for (size_t i = 0; i < records.size(); i++)
+        unlink((workdir + "/" + to_string(i) + ".json").c_str());
+    unlink(synthetic_source.c_str());
+    unlink(broken_source.c_str());
+    rmdir(workdir.c_str());
+
+    return 0;
+}